@@ -5,6 +5,7 @@
 
 /**Handles bootup, shutdown, poweroff and reboot, etc, and some misc stuff.**/
 
+#define _GNU_SOURCE /*For memfd seals.*/
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,21 +16,43 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <stdint.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
 #include "epoch.h"
 
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
 /*Prototypes.*/
 static void MountVirtuals(void);
 static void PrimaryLoop(void);
+static void PrimaryLoop_CheckHalt(void);
+static void PrimaryLoop_CheckObjects(Bool RescanPIDs);
+static int PrimaryLoop_BusTimeout(void);
+static unsigned PrimaryLoop_TimerInterval(void);
 static void ApplyGlobalEnvVars(void);
+static int ReexecState_Save(pid_t ChildPID);
+static Bool ReexecState_Load(pid_t *ChildPID);
+static void ReexecState_FromMemBus(void);
+static Bool ReexecState_Receive(char *InBuf, unsigned Size);
 
 /*Globals.*/
 struct _HaltParams HaltParams = { -1 };
 unsigned char AutoMountOpts[5];
 static Bool ContinuePrimaryLoop = true;
+static sigset_t LoopSignals; /*Signals PrimaryLoop() takes through its signalfd. Unblock before exec()!*/
+int ObjectWatchDescriptor = -1; /*PrimaryLoop()'s epoll instance, so GetObjectPIDFD() can add pidfds to it.*/
+Bool LoopTimerStale = true; /*Set when an object starts or stops, a config loads or a halt is scheduled, so PrimaryLoop() rethinks its timer.*/
 struct _EnvVarList *GlobalEnvVars;
 
 /*Functions.*/
@@ -92,154 +115,388 @@ static void MountVirtuals(void)
 	}
 }
 
-static void PrimaryLoop(void)
-{ /*Loop that provides essentially everything we cycle through.*/
+static void PrimaryLoop_CheckHalt(void)
+{ /*Launches a scheduled shutdown when it's due, and warns everyone as it approaches.*/
 	unsigned CurMin = 0, CurSec = 0;
-	ObjTable *Worker = NULL;
 	struct tm TimeStruct;
 	time_t TimeCore;
-	short LoopStepper = 0, ScanStepper = 0;
 	
-	for (ContinuePrimaryLoop = true; ContinuePrimaryLoop; ++LoopStepper)
-	{	
+	if (HaltParams.HaltMode == -1) return;
 	
-		/**The line below is of critical importance. It harvests
-		 * the zombies created by all processes throughout the system.**/
-		while (waitpid(-1, NULL, WNOHANG) > 0);
-		
-		/*Do not flood the system with this big loop more than necessary.*/
-		if (LoopStepper == 5)
+	time(&TimeCore);
+	localtime_r(&TimeCore, &TimeStruct);
+	
+	CurMin = TimeStruct.tm_min;
+	CurSec = TimeStruct.tm_sec;
+	
+	/*Allow a membus job to finish before shutdown, but actually do the shutdown afterwards.*/
+	if (GetStateOfTime(HaltParams.TargetHour, HaltParams.TargetMin, HaltParams.TargetSec,
+			HaltParams.TargetMonth, HaltParams.TargetDay, HaltParams.TargetYear))
+	{ /*GetStateOfTime() returns 1 if the passed time is the present, and 2 if it's the past,
+		so we can just take whatever positive value we are given.*/		
+		LaunchShutdown(HaltParams.HaltMode);
+	}
+	else if (CurSec >= HaltParams.TargetSec && CurMin != HaltParams.TargetMin &&
+		*DateDiff(HaltParams.TargetHour, HaltParams.TargetMin, NULL, NULL, NULL) <= 20 )
+	{ /*If 20 minutes or less until shutdown, warn us every minute.*/
+		char TBuf[MAX_LINE_SIZE];
+		const char *HaltMode = NULL;
+		static unsigned LastJobID = 0;
+		static short LastMin = -1;
+
+		if (LastJobID != HaltParams.JobID || CurMin != LastMin)
+		{ /*Don't repeat ourselves while the second rolls over.*/
+			const unsigned *const TimeReport = DateDiff(HaltParams.TargetHour, HaltParams.TargetMin, NULL, NULL, NULL);
+			
+			if (HaltParams.HaltMode == OSCTL_HALT)
+			{
+				HaltMode = "halt";
+			}
+			else if (HaltParams.HaltMode == OSCTL_POWEROFF)
+			{
+				HaltMode = "poweroff";
+			}
+			else
+			{
+				HaltParams.HaltMode = OSCTL_REBOOT;
+				HaltMode = "reboot";
+			}
+			
+			snprintf(TBuf, sizeof TBuf, "System is going down for %s in %u minutes %u seconds!",
+					HaltMode, TimeReport[0], TimeReport[1]);
+			EmulWall(TBuf, false);
+			
+			LastJobID = HaltParams.JobID;
+			LastMin = CurMin;
+		}
+	}
+}
+
+static void PrimaryLoop_CheckObjects(Bool RescanPIDs)
+{ /*Handle objects intended for automatic restart, and keep our PIDs fresh.*/
+	ObjTable *Worker = NULL;
+	short InCGroup = -1;
+	
+	if (!ObjectTable) return;
+	
+	for (Worker = ObjectTable; Worker->Next != NULL; Worker = Worker->Next)
+	{ /*With a cgroup, cgroup.events is all we need to read to know.*/
+		if (Worker->Opts.AutoRestart && Worker->Started &&
+			(InCGroup = CGroup_Populated(Worker)) != 1 && (InCGroup == 0 || !ObjectPIDRunning(Worker)))
 		{
+			char TmpBuf[MAX_LINE_SIZE];
 			
-			LoopStepper = 0;
+			if (InCGroup == -1 && !Worker->Opts.HasPIDFile && AdvancedPIDFind(Worker, true))
+			{ /* Try to update the PID rather than restart, since some things change their PIDs via forking etc.*/
+				continue;
+			}
+			
+			/*Don't let us enter a restart loop.*/
+			if (Worker->StartedSince + (Worker->Opts.AutoRestart >> 1) > time(NULL))
+			{
+				snprintf(TmpBuf, sizeof TmpBuf,
+						"AUTORESTART: "CONSOLE_COLOR_RED "PROBLEM:\n"
+						"Object %s is trying to autorestart "
+						"within 5 secs of last start.\n ** " CONSOLE_ENDCOLOR
+						"Marking object stopped to safeguard against restart loop.",
+						Worker->ObjectID);
+						
+				WriteLogLine(TmpBuf, true);
+				
+				Worker->Started = false;
+				Worker->ObjectPID = 0;
+				Worker->StartedSince = 0;
+				LoopTimerStale = true;
+				CGroup_Remove(Worker); /*Empty, or we wouldn't be here.*/
+				continue;
+			}
 			
-			HandleMemBusPings(); /*Tell clients we are alive if they ask.*/
+			snprintf(TmpBuf, MAX_LINE_SIZE, "AUTORESTART: Object %s is not running. Restarting.", Worker->ObjectID);
+			WriteLogLine(TmpBuf, true);
 			
-			CheckMemBusIntegrity(); /*See if we need to manually disconnect a dead client.*/
+			if (ProcessConfigObject(Worker, true, false))
+			{
+				snprintf(TmpBuf, MAX_LINE_SIZE, "AUTORESTART: Object %s successfully restarted.", Worker->ObjectID);
+			}
+			else
+			{
+				snprintf(TmpBuf, MAX_LINE_SIZE, "AUTORESTART: " CONSOLE_COLOR_RED "Failed" CONSOLE_ENDCOLOR
+						" to restart object %s automatically.\nMarking object stopped.", Worker->ObjectID);
+				Worker->Started = false;
+				Worker->ObjectPID = 0;
+				Worker->StartedSince = 0;
+				CGroup_Release(Worker, true);
+			}
 			
-			ParseMemBus(); /*Check membus for new data.*/
+			WriteLogLine(TmpBuf, true);
+		}
+	}
+	
+	/*Rescan PIDs every minute to keep them up-to-date. One pass over /proc does all of them.
+	* New PIDs or PID files may mean new pidfds, and a different timer.*/
+	if (RescanPIDs)
+	{
+		AdvancedPIDFindAll();
+		LoopTimerStale = true;
+	}
+}
+
+static int PrimaryLoop_BusTimeout(void)
+{ /*How long we may sleep before looking at the membus again, or -1 for as long as we like.
+	* SysV shm gives us no descriptor to wait on, but clients knock on the control socket when they claim a slot.*/
+	if (MemBus_Busy())
+	{ /*Someone is talking to us, stay responsive.*/
+		return LOOP_BUSPOLL_ACTIVE;
+	}
+	
+	if (!ControlSock_Listening())
+	{ /*Nobody can wake us, so we have to go look.*/
+		return LOOP_BUSPOLL_IDLE;
+	}
+	
+	return -1;
+}
+
+static unsigned PrimaryLoop_TimerInterval(void)
+{ /*How often the timerfd needs to tick, in seconds. Zero means nothing needs it, and we sleep until something happens.*/
+	ObjTable *Worker = ObjectTable;
+	unsigned Interval = 0;
+	
+	if (HaltParams.HaltMode != -1) return 1; /*A scheduled halt counts down and warns us every minute.*/
+	
+	for (; Worker && Worker->Next; Worker = Worker->Next)
+	{
+		unsigned PID;
+		
+		if (!Worker->Started) continue;
+		
+		if (!Worker->Opts.HasPIDFile || !(PID = ReadPIDFile(Worker))) PID = Worker->ObjectPID;
+		
+		/*A pidfd in our epoll set tells us the moment it exits.*/
+		if (PID && GetObjectPIDFD(Worker, PID) != -1) continue;
+		
+		if (Worker->Opts.AutoRestart) return 1; /*Nothing will tell us it died, so we have to keep checking.*/
+		
+		if (PID && errno == ESRCH) continue; /*Already gone, and its pidfd told us so when it went.*/
+		
+		Interval = 60; /*Only the PID rescan can keep up with this one.*/
+	}
+	
+	return Interval;
+}
+
+static void PrimaryLoop(void)
+{ /*Loop that provides essentially everything we cycle through.*/
+	struct epoll_event Event, Events[8];
+	int EventDescriptor = -1, SignalDescriptor = -1, TimerDescriptor = -1;
+	int NumEvents = 0, Inc = 0;
+	unsigned ScanStepper = 0, TimerInterval = 0; /*The timerfd starts out disarmed.*/
+	
+	/*SIGCHLD is taken through a descriptor now, not a handler.*/
+	sigemptyset(&LoopSignals);
+	sigaddset(&LoopSignals, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &LoopSignals, NULL);
+	
+	if ((EventDescriptor = epoll_create1(EPOLL_CLOEXEC)) == -1 ||
+		(SignalDescriptor = signalfd(-1, &LoopSignals, SFD_NONBLOCK | SFD_CLOEXEC)) == -1 ||
+		(TimerDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+	{ /*Ancient kernel? We can still run, we just have to poll like we used to.*/
+		WriteLogLine(CONSOLE_COLOR_YELLOW "WARNING: " CONSOLE_ENDCOLOR
+					"Unable to set up epoll/signalfd/timerfd. Falling back to polling the main loop.", true);
+		
+		if (EventDescriptor != -1) close(EventDescriptor);
+		if (SignalDescriptor != -1) close(SignalDescriptor);
+		if (TimerDescriptor != -1) close(TimerDescriptor);
+		
+		EventDescriptor = SignalDescriptor = TimerDescriptor = -1;
+		sigprocmask(SIG_UNBLOCK, &LoopSignals, NULL);
+		sigemptyset(&LoopSignals);
+	}
+	else
+	{
+		memset(&Event, 0, sizeof Event);
+		Event.events = EPOLLIN;
+		
+		Event.data.fd = SignalDescriptor;
+		epoll_ctl(EventDescriptor, EPOLL_CTL_ADD, SignalDescriptor, &Event);
+		
+		Event.data.fd = TimerDescriptor;
+		epoll_ctl(EventDescriptor, EPOLL_CTL_ADD, TimerDescriptor, &Event);
+		
+		ObjectWatchDescriptor = EventDescriptor;
+		ControlSock_Watch();
+		ConfigWatch_Reset();
+		
+		if (ObjectTable)
+		{ /*Watch everything that's already running. New pidfds get added as they're opened.*/
+			ObjTable *Worker = ObjectTable;
 			
-			if (HaltParams.HaltMode != -1)
+			for (; Worker->Next; Worker = Worker->Next)
 			{
-				time(&TimeCore);
-				localtime_r(&TimeCore, &TimeStruct);
+				unsigned PID;
+				
+				if (!Worker->Started) continue;
 				
-				CurMin = TimeStruct.tm_min;
-				CurSec = TimeStruct.tm_sec;
+				if (!Worker->Opts.HasPIDFile || !(PID = ReadPIDFile(Worker))) PID = Worker->ObjectPID;
 				
-				/*Allow a membus job to finish before shutdown, but actually do the shutdown afterwards.*/
-				if (GetStateOfTime(HaltParams.TargetHour, HaltParams.TargetMin, HaltParams.TargetSec,
-						HaltParams.TargetMonth, HaltParams.TargetDay, HaltParams.TargetYear))
-				{ /*GetStateOfTime() returns 1 if the passed time is the present, and 2 if it's the past,
-					so we can just take whatever positive value we are given.*/		
-					LaunchShutdown(HaltParams.HaltMode);
+				if (Worker->PIDFD != -1 && Worker->PIDFDTarget == PID)
+				{ /*Opened before we had an epoll set.*/
+					Event.data.fd = Worker->PIDFD;
+					epoll_ctl(EventDescriptor, EPOLL_CTL_ADD, Worker->PIDFD, &Event);
 				}
-				else if (CurSec >= HaltParams.TargetSec && CurMin != HaltParams.TargetMin &&
-					*DateDiff(HaltParams.TargetHour, HaltParams.TargetMin, NULL, NULL, NULL) <= 20 )
-				{ /*If 20 minutes or less until shutdown, warn us every minute.*/
-					char TBuf[MAX_LINE_SIZE];
-					const char *HaltMode = NULL;
-					static unsigned LastJobID = 0;
-					static short LastMin = -1;
-	
-					if (LastJobID != HaltParams.JobID || CurMin != LastMin)
-					{ /*Don't repeat ourselves 80 times while the second rolls over.*/
-						const unsigned *const TimeReport = DateDiff(HaltParams.TargetHour, HaltParams.TargetMin, NULL, NULL, NULL);
-						
-						if (HaltParams.HaltMode == OSCTL_HALT)
-						{
-							HaltMode = "halt";
-						}
-						else if (HaltParams.HaltMode == OSCTL_POWEROFF)
-						{
-							HaltMode = "poweroff";
-						}
-						else
-						{
-							HaltParams.HaltMode = OSCTL_REBOOT;
-							HaltMode = "reboot";
-						}
-						
-						snprintf(TBuf, sizeof TBuf, "System is going down for %s in %u minutes %u seconds!",
-								HaltMode, TimeReport[0], TimeReport[1]);
-						EmulWall(TBuf, false);
-						
-						LastJobID = HaltParams.JobID;
-						LastMin = CurMin;
-					}
+				else
+				{
+					GetObjectPIDFD(Worker, PID);
+				}
+			}
+		}
+	}
+	
+	for (ContinuePrimaryLoop = true; ContinuePrimaryLoop;)
+	{
+		Bool TimerFired = false, ObjectExited = false;
+		
+		if (EventDescriptor == -1)
+		{ /*Fallback mode, we own the clock ourselves.*/
+			static unsigned Elapsed = 0;
+			int Timeout = PrimaryLoop_BusTimeout();
+			
+			if (Timeout == -1) Timeout = LOOP_BUSPOLL_IDLE; /*No epoll set, so the control socket can't wake us.*/
+			
+			usleep(Timeout * 1000);
+			
+			TimerInterval = 1;
+			
+			if ((Elapsed += Timeout) >= 1000)
+			{
+				Elapsed = 0;
+				TimerFired = true;
+			}
+		}
+		else
+		{
+			const int ConfigTimeout = ConfigWatch_Timeout(), BusTimeout = PrimaryLoop_BusTimeout();
+			int Timeout = BusTimeout;
+			
+			if (LoopTimerStale)
+			{ /*Only tick while something needs it, so we make no wakeups at all when there's nothing to do.*/
+				const unsigned WantInterval = PrimaryLoop_TimerInterval();
+				
+				LoopTimerStale = false;
+				
+				if (WantInterval != TimerInterval)
+				{
+					struct itimerspec TimerSpec;
+					
+					memset(&TimerSpec, 0, sizeof TimerSpec);
+					TimerSpec.it_value.tv_sec = TimerSpec.it_interval.tv_sec = WantInterval;
+					
+					if (timerfd_settime(TimerDescriptor, 0, &TimerSpec, NULL) == 0) TimerInterval = WantInterval;
+					else LoopTimerStale = true; /*Try again next pass.*/
 				}
 			}
 			
-			if (ObjectTable)
+			if (ConfigTimeout != -1 && (Timeout == -1 || ConfigTimeout < Timeout))
+			{ /*ConfigAutoReload is waiting for the edits to settle.*/
+				Timeout = ConfigTimeout;
+			}
+			
+			if (BusTimeout == LOOP_BUSPOLL_ACTIVE)
+			{ /*A client is talking to us. Sleep on the membus doorbell instead, so we answer as soon as it writes.*/
+				if ((NumEvents = epoll_wait(EventDescriptor, Events, sizeof Events / sizeof *Events, 0)) == 0)
+				{
+					MemBus_WaitDoorbell(Timeout);
+				}
+			}
+			else NumEvents = epoll_wait(EventDescriptor, Events, sizeof Events / sizeof *Events, Timeout);
+		}
+		
+		if (EventDescriptor != -1 && NumEvents > 0)
+		{
+			for (Inc = 0; Inc < NumEvents; ++Inc)
 			{
-				for (Worker = ObjectTable; Worker->Next != NULL; Worker = Worker->Next)
-				{ /*Handle objects intended for automatic restart.*/
-					if (Worker->Opts.AutoRestart && Worker->Started && !ObjectProcessRunning(Worker))
+				if (Events[Inc].data.fd == SignalDescriptor)
+				{ /*Drain it. We only care that something happened, waitpid() below does the real work.*/
+					struct signalfd_siginfo SigInfo;
+					
+					while (read(SignalDescriptor, &SigInfo, sizeof SigInfo) == sizeof SigInfo);
+				}
+				else if (Events[Inc].data.fd == TimerDescriptor)
+				{
+					uint64_t Expirations;
+					
+					if (read(TimerDescriptor, &Expirations, sizeof Expirations) == sizeof Expirations) TimerFired = true;
+				}
+				else if (ControlSock_Owns(Events[Inc].data.fd))
+				{ /*ParseMemBus() below answers it.*/
+				}
+				else if (ConfigWatch_Owns(Events[Inc].data.fd))
+				{
+					ConfigWatch_Service();
+				}
+				else
+				{ /*An object's pidfd. It stays readable forever now, so let it go.*/
+					ObjTable *Worker = ObjectTable;
+
+					for (; Worker && Worker->Next; Worker = Worker->Next)
 					{
-						char TmpBuf[MAX_LINE_SIZE];
-						
-						if (!Worker->Opts.HasPIDFile && AdvancedPIDFind(Worker, true))
-						{ /* Try to update the PID rather than restart, since some things change their PIDs via forking etc.*/
-							continue;
-						}
-						
-						/*Don't let us enter a restart loop.*/
-						if (Worker->StartedSince + (Worker->Opts.AutoRestart >> 1) > time(NULL))
-						{
-							snprintf(TmpBuf, sizeof TmpBuf,
-									"AUTORESTART: "CONSOLE_COLOR_RED "PROBLEM:\n"
-									"Object %s is trying to autorestart "
-									"within 5 secs of last start.\n ** " CONSOLE_ENDCOLOR
-									"Marking object stopped to safeguard against restart loop.",
-									Worker->ObjectID);
-									
-							WriteLogLine(TmpBuf, true);
-							
-							Worker->Started = false;
-							Worker->ObjectPID = 0;
-							Worker->StartedSince = 0;
-							continue;
-						}
-						
-						snprintf(TmpBuf, MAX_LINE_SIZE, "AUTORESTART: Object %s is not running. Restarting.", Worker->ObjectID);
-						WriteLogLine(TmpBuf, true);
-						
-						if (ProcessConfigObject(Worker, true, false))
-						{
-							snprintf(TmpBuf, MAX_LINE_SIZE, "AUTORESTART: Object %s successfully restarted.", Worker->ObjectID);
-						}
-						else
+						if (Worker->PIDFD == Events[Inc].data.fd)
 						{
-							snprintf(TmpBuf, MAX_LINE_SIZE, "AUTORESTART: " CONSOLE_COLOR_RED "Failed" CONSOLE_ENDCOLOR
-									" to restart object %s automatically.\nMarking object stopped.", Worker->ObjectID);
-							Worker->Started = false;
-							Worker->ObjectPID = 0;
-							Worker->StartedSince = 0;
+							CloseObjectPIDFD(Worker); /*Takes it out of the epoll set too.*/
+							break;
 						}
-						
-						WriteLogLine(TmpBuf, true);
 					}
-					
-					/*Rescan PIDs every minute to keep them up-to-date.*/
-					if (ScanStepper == 240 && Worker->Started && !Worker->Opts.HasPIDFile)
-					{
-						AdvancedPIDFind(Worker, true);
+
+					if (!Worker || !Worker->Next)
+					{ /*Nobody owns it anymore, but don't let it wake us forever.*/
+						epoll_ctl(EventDescriptor, EPOLL_CTL_DEL, Events[Inc].data.fd, NULL);
 					}
+
+					ObjectExited = true;
 				}
 			}
+		}
+		
+		/**The line below is of critical importance. It harvests
+		 * the zombies created by all processes throughout the system.**/
+		while (waitpid(-1, NULL, WNOHANG) > 0);
+		
+		HandleMemBusPings(); /*Tell clients we are alive if they ask.*/
+		
+		CheckMemBusIntegrity(); /*See if we need to manually disconnect a dead client.*/
+		
+		ParseMemBus(); /*Check membus for new data.*/
+		
+		ConfigWatch_Check(); /*ConfigAutoReload.*/
+		
+		if (TimerFired)
+		{ /*Once a second is plenty for these, when anything needs them at all.*/
+			PrimaryLoop_CheckHalt();
 			
-			if (ScanStepper == 240)
-			{
-				ScanStepper = 0;
-			}
+			PrimaryLoop_CheckObjects((ScanStepper += TimerInterval) >= 60);
 			
-			++ScanStepper;
+			if (ScanStepper >= 60) ScanStepper = 0;
+		}
+		else if (ObjectExited)
+		{ /*Don't wait for the timer to autorestart something. It may have forked a new PID, so rescan now too.*/
+			PrimaryLoop_CheckObjects(true);
 		}
 		
-		usleep(50000); /*0.05 secs*/
+		FlushLogBuffer(); /*Anything logged this pass goes to disk in one write.*/
 
 		/*Lots of brilliant code here, but I typed it in invisible pixels.*/
-	}		
+	}
+	
+	if (EventDescriptor != -1)
+	{
+		ObjectWatchDescriptor = -1;
+		ConfigWatch_Reset(); /*Stops it, now that there's no epoll set.*/
+		close(TimerDescriptor);
+		close(SignalDescriptor);
+		close(EventDescriptor);
+	}
+	
+	sigprocmask(SIG_UNBLOCK, &LoopSignals, NULL);
 }
 
 /*This does what it sounds like. It exits us to go to a shell in event of catastrophe.*/
@@ -256,6 +513,10 @@ void EmergencyShell(void)
 	
 	fprintf(stderr, "Launching the shell...\n");
 	
+	ShutdownLogging(); /*Don't lose what's buffered, and don't hand the shell our descriptor.*/
+	
+	sigprocmask(SIG_UNBLOCK, &LoopSignals, NULL); /*The shell needs its SIGCHLD back.*/
+	
 	execlp("sh", "sh", NULL); /*Nuke our process image and replace with a shell. No point forking.*/
 	
 	/*We're supposed to be gone! Something went wrong!*/
@@ -264,32 +525,161 @@ void EmergencyShell(void)
 	while (1) sleep(1); /*Hang forever to prevent a kernel panic.*/
 }
 
-void RecoverFromReexec(Bool ViaMemBus)
-{ /*This is called when we are reexecuted from ReexecuteEpoch() to receive data*/
+static int ReexecState_Save(pid_t ChildPID)
+{ /*Packs everything the new binary needs into one sealed memfd it inherits,
+	* so it needn't be fed object by object over the membus. Returns -1 if we can't.*/
+#if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
+	struct _ReexecState Header = { 0 };
+	ObjTable *Worker = ObjectTable;
+	unsigned char *Buffer = NULL, *Out = NULL;
+	int Descriptor = -1;
+	
+	Header.Magic = REEXEC_STATE_MAGIC;
+	Header.Version = REEXEC_STATE_VERSION;
+	Header.Size = sizeof Header;
+	Header.ChildPID = ChildPID;
+	Header.HaltParams = HaltParams;
+	Header.EnableLogging = EnableLogging;
+	snprintf(Header.CurRunlevel, sizeof Header.CurRunlevel, "%s", CurRunlevel);
+	
+	for (; Worker->Next; Worker = Worker->Next, ++Header.NumObjects)
+	{
+		Header.Size += sizeof Worker->ObjectPID + sizeof Worker->StartedSince + sizeof(Bool) + strlen(Worker->ObjectID) + 1;
+	}
+	
+	if (!(Buffer = malloc(Header.Size))) return -1;
+	
+	memcpy(Buffer, &Header, sizeof Header);
+	Out = Buffer + sizeof Header;
+	
+	for (Worker = ObjectTable; Worker->Next; Worker = Worker->Next)
+	{
+		unsigned TLength = strlen(Worker->ObjectID) + 1;
+		
+		memcpy(Out, &Worker->ObjectPID, sizeof Worker->ObjectPID);
+		Out += sizeof Worker->ObjectPID;
+		
+		memcpy(Out, &Worker->StartedSince, sizeof Worker->StartedSince);
+		Out += sizeof Worker->StartedSince;
+		
+		*Out++ = Worker->Started;
+		
+		memcpy(Out, Worker->ObjectID, TLength);
+		Out += TLength;
+	}
+	
+	if ((Descriptor = syscall(SYS_memfd_create, "epoch-rxd", MFD_ALLOW_SEALING)) == -1 ||
+		write(Descriptor, Buffer, Header.Size) != (ssize_t)Header.Size ||
+		fcntl(Descriptor, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1)
+	{
+		if (Descriptor != -1) close(Descriptor);
+		Descriptor = -1;
+	}
+	
+	free(Buffer);
+	return Descriptor;
+#else
+	return -1;
+#endif
+}
+
+static Bool ReexecState_Load(pid_t *ChildPID)
+{ /*Picks up what ReexecState_Save() left us. false means get it from the membus instead.*/
+#if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
+	const char *EnvValue = getenv(REEXEC_STATE_ENVVAR);
+	const int NeededSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+	struct _ReexecState Header;
+	struct stat FileStat;
+	const unsigned char *Map = NULL, *In = NULL, *End = NULL;
+	int Descriptor = -1;
+	unsigned Inc = 0;
+	
+	if (!EnvValue) return false;
+	
+	Descriptor = atoi(EnvValue);
+	unsetenv(REEXEC_STATE_ENVVAR); /*Keep it away from anything we launch.*/
+	
+	if (fstat(Descriptor, &FileStat) != 0 || FileStat.st_size < (off_t)sizeof Header ||
+		(fcntl(Descriptor, F_GET_SEALS) & NeededSeals) != NeededSeals ||
+		(Map = mmap(NULL, FileStat.st_size, PROT_READ, MAP_PRIVATE, Descriptor, 0)) == MAP_FAILED)
+	{
+		close(Descriptor);
+		SpitWarning("Re-exec state handoff is unreadable. Falling back to the membus.");
+		return false;
+	}
+	
+	close(Descriptor);
+	memcpy(&Header, Map, sizeof Header);
+	
+	if (Header.Magic != REEXEC_STATE_MAGIC || Header.Version != REEXEC_STATE_VERSION ||
+		Header.Size < sizeof Header || Header.Size > FileStat.st_size)
+	{
+		munmap((void*)Map, FileStat.st_size);
+		SpitWarning("Re-exec state handoff is from an incompatible version of Epoch. Falling back to the membus.");
+		return false;
+	}
+	
+	for (In = Map + sizeof Header, End = Map + Header.Size; Inc < Header.NumObjects; ++Inc)
+	{
+		const unsigned FixedSize = sizeof(unsigned) * 2 + sizeof(Bool);
+		const unsigned char *IDEnd = NULL;
+		ObjTable *CurObj = NULL;
+		
+		if (End - In <= FixedSize || !(IDEnd = memchr(In + FixedSize, '\0', End - In - FixedSize)))
+		{ /*We may have half restored the objects, but the membus sets all of it again.*/
+			munmap((void*)Map, FileStat.st_size);
+			SpitWarning("Re-exec state handoff is truncated. Falling back to the membus.");
+			return false;
+		}
+		
+		if ((CurObj = LookupObjectInTable((const char*)In + FixedSize)) != NULL)
+		{
+			memcpy(&CurObj->ObjectPID, In, sizeof CurObj->ObjectPID);
+			memcpy(&CurObj->StartedSince, In + sizeof(unsigned), sizeof CurObj->StartedSince);
+			CurObj->Started = In[sizeof(unsigned) * 2];
+		}
+		
+		In = IDEnd + 1;
+	}
+	
+	HaltParams = Header.HaltParams;
+	EnableLogging = Header.EnableLogging;
+	Header.CurRunlevel[sizeof Header.CurRunlevel - 1] = '\0';
+	snprintf(CurRunlevel, sizeof CurRunlevel, "%s", Header.CurRunlevel);
+	*ChildPID = Header.ChildPID;
+	
+	munmap((void*)Map, FileStat.st_size);
+	return true;
+#else
+	return false;
+#endif
+}
+
+static Bool ReexecState_Receive(char *InBuf, unsigned Size)
+{ /*Wait for the next message from the child, but not forever. We're PID 1, and we have a system to run.*/
+	const time_t Deadline = time(NULL) + 10;
+	
+	while (!MemBus_BinRead(InBuf, Size, false))
+	{
+		if (time(NULL) > Deadline) return false;
+		
+		MemBus_WaitMessage(false);
+	}
+	
+	return true;
+}
+
+static void ReexecState_FromMemBus(void)
+{ /*The old way, one membus message per object from the child ReexecuteEpoch() leaves behind.
+	* Used when the binary that ran before us didn't give us a memfd we can read.*/
 	pid_t ChildPID = 0;
 	ObjTable *CurObj = NULL;
 	char InBuf[MEMBUS_MSGSIZE] = { '\0' };
 	char *MCode = MEMBUS_CODE_RXD;
 	unsigned MCodeLength = strlen(MCode) + 1;
 	short HPS = 0;
-	unsigned TInc = 0;
+	int SHMDescriptor = -1;
 	unsigned long OurLong; /*We write unsigned int values as unsigned long to maintan compatibility with 1.1.1 and earlier.*/
-	MemBusKey = MEMKEY + 1;
-	
-	/*Restore any goobled up environ vars.*/
-	setenv("USER", ENVVAR_USER, true);
-	setenv("PATH", ENVVAR_PATH, true);
-	setenv("HOME", ENVVAR_HOME, true);
-	setenv("SHELL", ENVVAR_SHELL, true);
-	
-	if (!InitConfig(ConfigFile))
-	{
-		EmulWall("Epoch: "CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
-		"Cannot reload configuration for re-exec!", false);
-		EmergencyShell();
-	}
-
-	ApplyGlobalEnvVars(); /*Set global environment variables.*/
 	
 	if (!InitMemBus(false))
 	{
@@ -298,11 +688,11 @@ void RecoverFromReexec(Bool ViaMemBus)
 		EmergencyShell();
 	}
 	
-	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+	if (!ReexecState_Receive(InBuf, sizeof InBuf)) goto Timeout;
 	
 	memcpy(&ChildPID, InBuf + MCodeLength, sizeof(pid_t));
 	
-	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+	if (!ReexecState_Receive(InBuf, sizeof InBuf)) goto Timeout;
 	
 	while (!strcmp(InBuf, MCode))
 	{
@@ -321,7 +711,7 @@ void RecoverFromReexec(Bool ViaMemBus)
 			CurObj->StartedSince = OurLong;
 		}
 		
-		while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+		if (!ReexecState_Receive(InBuf, sizeof InBuf)) goto Timeout;
 	}
 	
 	MCode = MEMBUS_CODE_RXD_OPTS;
@@ -353,11 +743,11 @@ void RecoverFromReexec(Bool ViaMemBus)
 	HaltParams.JobID = OurLong;
 	
 	/*Retrieve our important options.*/
-	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+	if (!ReexecState_Receive(InBuf, sizeof InBuf)) goto Timeout;
 	EnableLogging = (Bool)*(InBuf + MCodeLength);
 
 	/*Retrieve the current runlevel.*/
-	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+	if (!ReexecState_Receive(InBuf, sizeof InBuf)) goto Timeout;
 	snprintf(CurRunlevel, sizeof CurRunlevel, "%s", InBuf + MCodeLength);
 	
 	MemBus_Write(MCode, false); /*Tell the child they can quit.*/
@@ -365,12 +755,77 @@ void RecoverFromReexec(Bool ViaMemBus)
 	/*Wait for the child to terminate.*/
 	waitpid(ChildPID, NULL, 0); /*We don't really have to, but I think we should.*/
 	
+	/*Bring down the old, custom membus.*/
+	ShutdownMemBus(false);
+	return;
+	
+Timeout:
+	/*Whatever we got is all we get. The PID rescan can find what's still running.*/
+	EmulWall("Epoch: " CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
+			"Re-exec: Child stopped sending state. Continuing with what we have.", false);
+	WriteLogLine(CONSOLE_COLOR_RED "Re-exec: Child stopped sending state. Continuing with what we have." CONSOLE_ENDCOLOR, true);
+	
+	if (ChildPID > 0)
+	{
+		kill(ChildPID, SIGKILL);
+		waitpid(ChildPID, NULL, 0);
+	}
+	
+	ShutdownMemBus(false);
+	
+	if ((SHMDescriptor = shmget(MEMKEY + 1, 0, 0660)) != -1)
+	{ /*It can't clean up after itself now.*/
+		shmctl(SHMDescriptor, IPC_RMID, NULL);
+	}
+}
+
+void RecoverFromReexec(Bool ViaMemBus)
+{ /*This is called when we are reexecuted from ReexecuteEpoch() to receive data*/
+	pid_t ChildPID = 0;
+	unsigned TInc = 0;
+	MemBusKey = MEMKEY + 1;
+	
+	/*Restore any goobled up environ vars.*/
+	setenv("USER", ENVVAR_USER, true);
+	setenv("PATH", ENVVAR_PATH, true);
+	setenv("HOME", ENVVAR_HOME, true);
+	setenv("SHELL", ENVVAR_SHELL, true);
+	
+	if (!InitConfig(ConfigFile))
+	{
+		EmulWall("Epoch: "CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
+		"Cannot reload configuration for re-exec!", false);
+		EmergencyShell();
+	}
+
+	ApplyGlobalEnvVars(); /*Set global environment variables.*/
+	LauncherProfile_Resolve(); /*The shell might not be where the last binary found it.*/
+	
+	if (ReexecState_Load(&ChildPID))
+	{ /*We have everything. The child waiting to feed older binaries over the membus can go.*/
+		int SHMDescriptor = -1;
+		
+		if (ChildPID > 0)
+		{
+			kill(ChildPID, SIGKILL);
+			waitpid(ChildPID, NULL, 0);
+		}
+		
+		if ((SHMDescriptor = shmget(MEMKEY + 1, 0, 0660)) != -1)
+		{ /*It can't clean up after itself now.*/
+			shmctl(SHMDescriptor, IPC_RMID, NULL);
+		}
+	}
+	else
+	{
+		ReexecState_FromMemBus();
+	}
+	
 	/**
 	 * EVERYTHING BEYOND HERE IS USED TO RESUME NORMAL OPERATION!
 	 * **/
 	
-	/*Bring down the old, custom membus and bring up the classic.*/
-	ShutdownMemBus(false);
+	/*Bring up the classic membus.*/
 	MemBusKey = MEMKEY;
 	
 	/*Reset environment variables.*/
@@ -412,6 +867,7 @@ void RecoverFromReexec(Bool ViaMemBus)
 void ReexecuteEpoch(void)
 { /*Used when Epoch needs to be restarted after we already booted.*/
 	pid_t PID = 0;
+	int StateDescriptor = -1;
 	FILE *TestDescriptor = fopen(EPOCH_BINARY_PATH, "rb");
 	char OutBuf[MEMBUS_MSGSIZE] = { '\0' };
 	ObjTable *Worker = ObjectTable;
@@ -445,6 +901,8 @@ void ReexecuteEpoch(void)
 		fclose(TestDescriptor);
 	}
 	
+	FlushLogBuffer(); /*Otherwise the child inherits our pending lines too.*/
+	
 	if ((PID = fork()) == -1)
 	{
 		EmulWall("Epoch: " CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
@@ -466,9 +924,19 @@ void ReexecuteEpoch(void)
 	{
 		WriteLogLine(CONSOLE_COLOR_YELLOW "Re-executing Epoch..." CONSOLE_ENDCOLOR, true);
 		
+		if ((StateDescriptor = ReexecState_Save(PID)) != -1)
+		{ /*New binaries take this and skip the child. Older ones don't look and use the child.*/
+			char DescriptorText[32];
+			
+			snprintf(DescriptorText, sizeof DescriptorText, "%d", StateDescriptor);
+			setenv(REEXEC_STATE_ENVVAR, DescriptorText, true);
+		}
+		
 		while (shmget(MEMKEY + 1, MEMBUS_SIZE, 0660) == -1) usleep(100);
 		
 		/**Execute the new binary.**/ /*We pass the custom args to tell us we are re-executing.*/
+		ShutdownLogging();
+		sigprocmask(SIG_UNBLOCK, &LoopSignals, NULL);
 		execlp(EPOCH_BINARY_PATH, "!rxd", "REEXEC", NULL);
 		
 		/*Not supposed to be here.*/
@@ -478,6 +946,12 @@ void ReexecuteEpoch(void)
 		WriteLogLine(CONSOLE_COLOR_RED "Reexecution failed." CONSOLE_ENDCOLOR, true);
 		kill(PID, SIGKILL); /*Kill the failed child.*/
 		
+		if (StateDescriptor != -1)
+		{
+			close(StateDescriptor);
+			unsetenv(REEXEC_STATE_ENVVAR);
+		}
+		
 		if (shmget(MEMKEY + 1, MEMBUS_SIZE, 0660) != -1)
 		{
 			ShutdownMemBus(true);
@@ -583,7 +1057,7 @@ void ReexecuteEpoch(void)
 	strncpy(OutBuf + MCodeLength, CurRunlevel, strlen(CurRunlevel) + 1);
 	MemBus_BinWrite(OutBuf, sizeof OutBuf, true);
 	
-	while (!MemBus_Read(OutBuf, true)) usleep(100); /*Wait for the main process to say we can quit.*/
+	while (!MemBus_Read(OutBuf, true)) MemBus_WaitMessage(true); /*Wait for the main process to say we can quit.*/
 	ShutdownMemBus(true); /*Nothing is deleted until the new process releases the lock, don't worry.*/
 	ShutdownConfig();
 	
@@ -640,6 +1114,9 @@ void PerformExec(const char *Cmd)
 	{ /*Reset signal handlers.*/
 		signal(Inc, SIG_DFL);
 	}
+	
+	ShutdownLogging();
+	sigprocmask(SIG_UNBLOCK, &LoopSignals, NULL);
 
 	execvp(Buffer[0], Buffer); /*Perform the exec.*/
 	
@@ -680,6 +1157,8 @@ void PerformPivotRoot(const char *NewRoot, const char *OldRootDir)
 	}
 
 	chdir("/"); /*Reset working directory*/
+	
+	ShutdownLogging(); /*Our log descriptor points into the old root now. Reopen on the next line.*/
 }
 
 
@@ -689,26 +1168,18 @@ void FinaliseLogStartup(Bool BlankLog)
 	{ /*Switch logging out of memory mode and write it's memory buffer to disk.*/		
 		if (EnableLogging)
 		{
-			FILE *Descriptor = fopen(LogFile, (BlankLog ? "w" : "a"));
-
 			LogInMemory = false;
 
-			if (!Descriptor)
+			if (!WriteLogBuffer(MemLogBuffer, MemLogLength, BlankLog))
 			{
 				SpitWarning("Cannot record logs to disk. Shutting down logging.");
 				EnableLogging = false;
 			}
-			else
-			{
-				fwrite(MemLogBuffer, 1, strlen(MemLogBuffer), Descriptor);
-				fflush(Descriptor);
-				fclose(Descriptor);
-			}
-			
 		}
 		
 		free(MemLogBuffer); /*Release the memory anyways.*/
 		MemLogBuffer = NULL;
+		MemLogLength = 0;
 	}
 }
 
@@ -783,6 +1254,7 @@ void LaunchBootup(void)
 	}
 	
 	ApplyGlobalEnvVars(); /*Use the global environment variables we have set.*/
+	LauncherProfile_Resolve(); /*Find a shell now, rather than on every command.*/
 
 	PrintBootBanner();
 
@@ -906,6 +1378,7 @@ void LaunchShutdown(int Signal)
 		WriteLogLine(LogMsg, true);
 	}
 	
+	ShutdownLogging(); /*Get it all on disk and let go of the file before anything gets unmounted.*/
 
 	EnableLogging = false; /*Prevent any additional log entries.*/
 	
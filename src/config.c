@@ -8,8 +8,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <time.h>
 #include <signal.h>
 #include <grp.h>
 #include <pwd.h>
@@ -24,6 +31,7 @@ ObjTable *ObjectTable;
 char ConfigFile[MAX_LINE_SIZE] = CONFIGDIR CONF_NAME;
 char *ConfigFileList[MAX_CONFIG_FILES] = { ConfigFile };
 int NumConfigFiles = 1;
+unsigned ConfigAutoReload; /*Msecs of quiet after a config file changes before we reload it ourselves. Zero is off.*/
 
 /*Used to allow for things like 'ObjectStartPriority Services', where Services == 3, for example.*/
 static struct _PriorityAliasTree
@@ -46,6 +54,161 @@ Epoch is just a linked list of linked lists anymore.*/
 	struct _RunlevelInheritance *Prev;
 } *RunlevelInheritance;
 
+/*Hash index of the object table, keyed by ObjectID, so lookups don't walk the whole list.
+ * Open addressing with linear probing. Size is always a power of two and we keep it at most half full.*/
+static struct
+{
+	ObjTable **Slots;
+	unsigned Size;
+	unsigned Count;
+	ObjTable *Tail; /*The empty node at the end of ObjectTable, so adding doesn't walk the list either.*/
+} ObjectIndex;
+
+/*Sorted start/stop orders we have already worked out, per runlevel. See GetObjectSchedule().*/
+static struct _ScheduleCache
+{
+	char RL[MAX_DESCRIPT_SIZE];
+	Bool AnyRunlevel; /*Built for ObjectRunlevel == NULL, i.e. shutdown.*/
+	Bool WantStartPriority;
+	Bool KCmdLine; /*Built during bootup, so startobj= objects are included.*/
+	ObjTable **Schedule; /*NULL terminated.*/
+	
+	struct _ScheduleCache *Next;
+} *ScheduleCache;
+
+struct _ScheduleSorter
+{ /*Only used while building a schedule.*/
+	ObjTable *Obj;
+	unsigned Priority;
+	unsigned Order;
+};
+
+/*What InitConfig() notes down for ConfigCache_Save() while it parses.*/
+static struct
+{
+	Bool Enabled; /*The ConfigCache attribute.*/
+	Bool Dirty; /*We warned about something, so this config is not cached.*/
+	unsigned Seen; /*CCACHE_* bits for the global attributes the config sets.*/
+	char DefaultRunlevel[MAX_DESCRIPT_SIZE];
+	char *Depends[CONFIG_CACHE_MAX_DEPENDS];
+	unsigned NumDepends;
+} ConfigCache;
+
+enum { CCACHE_DISABLECAD = 1, CCACHE_BLANKLOG = 2, CCACHE_ENABLELOG = 4, CCACHE_BANNER = 8,
+		CCACHE_STATUSFORMAT = 16, CCACHE_LOGFILE = 32, CCACHE_HOSTNAME = 64, CCACHE_DOMAINNAME = 128 };
+
+struct _ConfigCacheBuf
+{
+	unsigned char *Data;
+	unsigned Size;
+	unsigned Alloc;
+};
+
+struct _ConfigCacheReader
+{
+	const unsigned char *Pos;
+	const unsigned char *End;
+	Bool Bad;
+};
+
+/*The inotify watch for ConfigAutoReload. We watch the directories the config files are in, not the files,
+ * so editors that write a new file and rename it over the old one don't lose us the watch.*/
+static struct
+{
+	int Descriptor;
+	int WatchOf[MAX_CONFIG_FILES]; /*The watch for the directory of each ConfigFileList entry.*/
+	Bool Pending;
+	struct timespec Deadline;
+} ConfigWatch = { -1 };
+
+/*ConfigCache_Stamp() of the config we have loaded. ReloadConfig() skips the work if nothing differs.*/
+static struct _ConfigCacheBuf LoadedStamp;
+
+/*Objects' strings and list nodes come out of these instead of one malloc() apiece.
+ * Every object from one InitConfig() shares an arena, which goes away with the last of them.*/
+struct _ConfigArenaChunk
+{
+	struct _ConfigArenaChunk *Next;
+	size_t Used;
+	size_t Size;
+	unsigned char Data[];
+};
+
+struct _ConfigArena
+{
+	struct _ConfigArenaChunk *Chunks; /*Newest first. Only the first one is still being handed out.*/
+	unsigned Users; /*Objects pointing at us. ReloadConfig() can leave old and new objects in one table.*/
+};
+
+static struct _ConfigArena *CurArena; /*The one the config being parsed right now goes into.*/
+
+enum ConfigAttrID
+{
+	CFGATTR_BLANKLOGONBOOT = 1, CFGATTR_BOOTBANNERCOLOR, CFGATTR_BOOTBANNERTEXT, CFGATTR_BOOTWORKERS,
+	CFGATTR_CGROUPHIERARCHY, CFGATTR_CONFIGAUTORELOAD, CFGATTR_CONFIGCACHE, CFGATTR_DEFAULTRUNLEVEL, CFGATTR_DEFINEPRIORITY,
+	CFGATTR_DISABLECAD, CFGATTR_DOMAINNAME, CFGATTR_ENABLELOGGING, CFGATTR_FINISHEDSTATUSFORMAT,
+	CFGATTR_GLOBALENVVAR, CFGATTR_HOSTNAME, CFGATTR_IMPORT, CFGATTR_LOGFILE, CFGATTR_MOUNTVIRTUAL,
+	CFGATTR_OBJECTAFTER, CFGATTR_OBJECTDESCRIPTION, CFGATTR_OBJECTENABLED, CFGATTR_OBJECTENVVAR,
+	CFGATTR_OBJECTGROUP, CFGATTR_OBJECTID, CFGATTR_OBJECTOPTIONS, CFGATTR_OBJECTPIDFILE,
+	CFGATTR_OBJECTPRESTARTCOMMAND, CFGATTR_OBJECTRELOADCOMMAND, CFGATTR_OBJECTREQUIRES,
+	CFGATTR_OBJECTRUNLEVELS, CFGATTR_OBJECTSTARTCOMMAND, CFGATTR_OBJECTSTARTPRIORITY,
+	CFGATTR_OBJECTSTDERR, CFGATTR_OBJECTSTDOUT, CFGATTR_OBJECTSTOPCOMMAND, CFGATTR_OBJECTSTOPPRIORITY,
+	CFGATTR_OBJECTUSER, CFGATTR_OBJECTWORKINGDIRECTORY, CFGATTR_RUNLEVELINHERITS,
+	CFGATTR_STARTINGSTATUSFORMAT, CFGATTR_STATUSNAMES
+};
+
+/*Every attribute InitConfig() knows, sorted by name for ConfigAttr_Lookup().
+ * ObjectAttr means it belongs to the object above it, so it needs an ObjectID first.*/
+static const struct _ConfigAttr
+{
+	const char *Name;
+	enum ConfigAttrID ID;
+	Bool ObjectAttr;
+} ConfigAttrs[] =
+{
+	{ "BlankLogOnBoot", CFGATTR_BLANKLOGONBOOT, false },
+	{ "BootBannerColor", CFGATTR_BOOTBANNERCOLOR, false },
+	{ "BootBannerText", CFGATTR_BOOTBANNERTEXT, false },
+	{ "BootWorkers", CFGATTR_BOOTWORKERS, false },
+	{ "CGroupHierarchy", CFGATTR_CGROUPHIERARCHY, false },
+	{ "ConfigAutoReload", CFGATTR_CONFIGAUTORELOAD, false },
+	{ "ConfigCache", CFGATTR_CONFIGCACHE, false },
+	{ "DefaultRunlevel", CFGATTR_DEFAULTRUNLEVEL, false },
+	{ "DefinePriority", CFGATTR_DEFINEPRIORITY, false },
+	{ "DisableCAD", CFGATTR_DISABLECAD, false },
+	{ "Domainname", CFGATTR_DOMAINNAME, false },
+	{ "EnableLogging", CFGATTR_ENABLELOGGING, false },
+	{ "FinishedStatusFormat", CFGATTR_FINISHEDSTATUSFORMAT, false },
+	{ "GlobalEnvVar", CFGATTR_GLOBALENVVAR, false },
+	{ "Hostname", CFGATTR_HOSTNAME, false },
+	{ "Import", CFGATTR_IMPORT, false },
+	{ "LogFile", CFGATTR_LOGFILE, false },
+	{ "MountVirtual", CFGATTR_MOUNTVIRTUAL, false },
+	{ "ObjectAfter", CFGATTR_OBJECTAFTER, true },
+	{ "ObjectDescription", CFGATTR_OBJECTDESCRIPTION, true },
+	{ "ObjectEnabled", CFGATTR_OBJECTENABLED, true },
+	{ "ObjectEnvVar", CFGATTR_OBJECTENVVAR, true },
+	{ "ObjectGroup", CFGATTR_OBJECTGROUP, true },
+	{ "ObjectID", CFGATTR_OBJECTID, false },
+	{ "ObjectOptions", CFGATTR_OBJECTOPTIONS, true },
+	{ "ObjectPIDFile", CFGATTR_OBJECTPIDFILE, true },
+	{ "ObjectPrestartCommand", CFGATTR_OBJECTPRESTARTCOMMAND, true },
+	{ "ObjectReloadCommand", CFGATTR_OBJECTRELOADCOMMAND, true },
+	{ "ObjectRequires", CFGATTR_OBJECTREQUIRES, true },
+	{ "ObjectRunlevels", CFGATTR_OBJECTRUNLEVELS, true },
+	{ "ObjectStartCommand", CFGATTR_OBJECTSTARTCOMMAND, true },
+	{ "ObjectStartPriority", CFGATTR_OBJECTSTARTPRIORITY, true },
+	{ "ObjectStderr", CFGATTR_OBJECTSTDERR, true },
+	{ "ObjectStdout", CFGATTR_OBJECTSTDOUT, true },
+	{ "ObjectStopCommand", CFGATTR_OBJECTSTOPCOMMAND, true },
+	{ "ObjectStopPriority", CFGATTR_OBJECTSTOPPRIORITY, true },
+	{ "ObjectUser", CFGATTR_OBJECTUSER, true },
+	{ "ObjectWorkingDirectory", CFGATTR_OBJECTWORKINGDIRECTORY, true },
+	{ "RunlevelInherits", CFGATTR_RUNLEVELINHERITS, false },
+	{ "StartingStatusFormat", CFGATTR_STARTINGSTATUSFORMAT, false },
+	{ "StatusNames", CFGATTR_STATUSNAMES, false }
+};
+
 /*Holds the system hostname.*/
 char Hostname[256];
 /*Holds the system domain name.*/
@@ -55,7 +218,9 @@ char Domainname[256];
 static ObjTable *AddObjectToTable(const char *ObjectID, const char *File);
 static char *NextLine(const char *InStream);
 static ReturnCode GetLineDelim(const char *InStream, char *OutStream);
-static ReturnCode ScanConfigIntegrity(void);
+static const struct _ConfigAttr *ConfigAttr_Lookup(const char *Line);
+static short ConfigLine_SkipComment(char **Line, Bool *LongComment);
+static ReturnCode ScanConfigIntegrity(Bool RunlevelOnly);
 static void ConfigProblem(const char *File, short Type, const char *Attribute, const char *AttribVal, unsigned LineNum);
 static unsigned PriorityAlias_Lookup(const char *Alias);
 static void PriorityAlias_Add(const char *Alias, unsigned Target);
@@ -64,6 +229,41 @@ static void RLInheritance_Add(const char *Inheriter, const char *Inherited);
 static Bool RLInheritance_Check(const char *Inheriter, const char *Inherited);
 static void RLInheritance_Shutdown(void);
 static unsigned PriorityOfLookup(const char *const ObjectID, Bool IsStartingMode);
+static unsigned ObjIndex_Hash(const char *ObjectID);
+static void ObjIndex_Add(ObjTable *InObj);
+static ObjTable *ObjIndex_Lookup(const char *ObjectID);
+static void ObjIndex_Rebuild(void);
+static void ObjIndex_Shutdown(void);
+static int ObjSchedule_Compare(const void *First_, const void *Second_);
+static void ConfigCache_Depend(const char *Path);
+static void ConfigCache_Reset(void);
+static void ConfigCache_Put(struct _ConfigCacheBuf *Buf, const void *Data, unsigned Size);
+static void ConfigCache_PutString(struct _ConfigCacheBuf *Buf, const char *String);
+static void ConfigCache_PutFile(struct _ConfigCacheBuf *Buf, const char *Path);
+static Bool ConfigCache_Get(struct _ConfigCacheReader *Reader, void *Out, unsigned Size);
+static const char *ConfigCache_GetString(struct _ConfigCacheReader *Reader);
+static Bool ConfigCache_CheckFile(struct _ConfigCacheReader *Reader, const char **PathOut);
+static void ConfigCache_Save(Bool TrueLogEnable);
+static void ConfigCache_Remove(void);
+static Bool ConfigCache_Load(Bool *TrueLogEnable);
+static void ConfigCache_Stamp(struct _ConfigCacheBuf *Buf);
+static struct _ConfigArena *ConfigArena_New(void);
+static void *ConfigArena_Alloc(struct _ConfigArena *Arena, size_t Size);
+static char *ConfigArena_StrDup(struct _ConfigArena *Arena, const char *String);
+static void ConfigArena_Release(struct _ConfigArena *Arena);
+static void EnvVarList_Insert(const char *Var, struct _EnvVarList **const List, struct _ConfigArena *Arena);
+static void ObjTable_Shutdown(ObjTable *Worker);
+static char **ObjTable_SplitCommand(struct _ConfigArena *Arena, const char *Command);
+static void ObjTable_PrepareLaunch(ObjTable *Worker);
+static void ObjTable_BuildEnvOverlay(ObjTable *Worker);
+static Bool ObjTable_SameCredentials(const struct _ObjCredentials *Old, const struct _ObjCredentials *New);
+static Bool ObjTable_CredentialsCurrent(const struct _ObjCredentials *Creds, const struct passwd *UserStruct,
+										unsigned GroupID, const gid_t *Groups, int NumGroups);
+static Bool ObjTable_SameString(const char *First, const char *Second);
+static Bool ObjTable_SameConfig(const ObjTable *Old, const ObjTable *New);
+
+/*InitConfig() warns through this, so a config it had to complain about doesn't get cached.*/
+#define ConfigWarning(Msg) (ConfigCache.Dirty = true, SpitWarning(Msg))
 
 /*Used for error handling in InitConfig() by ConfigProblem(CurConfigFile, ).*/
 enum { CONFIG_EMISSINGVAL = 1, CONFIG_EBADVAL, CONFIG_ETRUNCATED, CONFIG_EAFTER,
@@ -114,6 +314,8 @@ static void ConfigProblem(const char *File, short Type, const char *Attribute, c
 	char TmpBuf[1024];
 	char LogBuffer[MAX_LINE_SIZE];
 
+	ConfigCache.Dirty = true;
+	
 	switch (Type)
 	{
 		case CONFIG_EMISSINGVAL:
@@ -158,6 +360,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 	char DelimCurr[MAX_LINE_SIZE] = { '\0' };
 	unsigned LineNum = 1;
 	const char *CurrentAttribute = NULL;
+	const struct _ConfigAttr *Attr = NULL;
 	Bool LongComment = false;
 	Bool TrueLogEnable = EnableLogging;
 	Bool PrevLogInMemory = LogInMemory;
@@ -168,6 +371,33 @@ ReturnCode InitConfig(const char *CurConfigFile)
 	{
 		EnableLogging = true; /*To temporarily turn on the logging system.*/
 		LogInMemory = true;
+		BootWorkers = 1; /*Back to serial unless the config says otherwise.*/
+		ConfigAutoReload = 0;
+		LoopTimerStale = true;
+		CurArena = NULL; /*Whatever the last config was using, this one gets its own.*/
+		snprintf(CGroupHierarchy, sizeof CGroupHierarchy, "%s", CGROUP_HIERARCHY);
+		ConfigCache_Reset();
+		
+		if (ConfigCache_Load(&TrueLogEnable))
+		{ /*Checked when it was cached, except for the runlevel, which is ours and not the config's.*/
+			if (!ScanConfigIntegrity(true))
+			{
+				ShutdownConfig();
+				return FAILURE;
+			}
+			
+			for (ObjWorker = ObjectTable; ObjWorker->Next; ObjWorker = ObjWorker->Next)
+			{
+				ObjTable_PrepareLaunch(ObjWorker);
+			}
+			
+			ConfigCache_Stamp(&LoadedStamp);
+			LogInMemory = PrevLogInMemory;
+			EnableLogging = TrueLogEnable;
+			return SUCCESS;
+		}
+		
+		ConfigCache_Reset(); /*It may have noted down the depends of a stale cache.*/
 	}
 	
 	/*Get the file size of the config file.*/
@@ -212,7 +442,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Non-ASCII characters detected in configuration file \"%s\"!\n"
 						"Epoch does not support Unicode or the like!", CurConfigFile);
-			SpitWarning(ErrBuf);
+			ConfigWarning(ErrBuf);
 			WriteLogLine(ErrBuf, true);
 			break;
 		}
@@ -247,29 +477,17 @@ ReturnCode InitConfig(const char *CurConfigFile)
 		 * It is not recognized to place a multi-line comment beginner or terminator anywhere but the beginning
 		 * of the line. As such, one may place do things like "ObjectID >!>" to create an object with ID ">!>". **/
 
-		if (!strncmp(Worker, "<!<", strlen("<!<")))
-		{ /*It's probably not good to have stray multi-line comment terminators around.*/
-			if (!LongComment)
-			{
+		switch (ConfigLine_SkipComment(&Worker, &LongComment))
+		{
+			case -1: /*It's probably not good to have stray multi-line comment terminators around.*/
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Stray multi-line comment terminator in \"%s\" line %u\n", CurConfigFile, LineNum);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 				continue;
-			}
-			LongComment = false;
-			
-			/*Allow next line to begin right ater the terminator on the same line.*/
-			Worker += strlen("<!<");
-			while (*Worker == ' ' || *Worker == '\t') ++Worker;
-		}
-		else if (LongComment)
-		{
-			continue;
-		}
-		else if (!strncmp(Worker, ">!>", strlen(">!>")))
-		{
-			LongComment = true;
-			continue;
+			case 1:
+				continue;
+			default:
+				break;
 		}
 		
 		/**Single-line comments are created by placing "#" at the beginning of the line. Placing them
@@ -283,8 +501,24 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			continue;
 		}
 		
+		if (!(Attr = ConfigAttr_Lookup(Worker)))
+		{ /*No big deal.*/
+			snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Unidentified attribute in %s on line %u.", CurConfigFile, LineNum);
+			ConfigWarning(ErrBuf);
+			WriteLogLine(ErrBuf, true);
+			continue;
+		}
+		
+		CurrentAttribute = Attr->Name;
+		
+		if (Attr->ObjectAttr && !CurObj)
+		{
+			ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
+			continue;
+		}
+		
 		/**Global configuration begins here.**/
-		if (!strncmp(Worker, (CurrentAttribute = "Import"), sizeof "Import" - 1))
+		if (Attr->ID == CFGATTR_IMPORT)
 		{
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -296,7 +530,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			{
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Cannot import config file \"%s\", config file limit of %d has been reached!\n"
 						"Attempting to continue.", DelimCurr, MAX_CONFIG_FILES);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 				continue;
 			}
@@ -323,6 +557,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			if (!InitConfig(ConfigFileList[NumConfigFiles - 1])) /*It's very important we pass this pointer and not DelimCurr.*/
 			{
+				ConfigCache.Dirty = true;
 				
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGERRORTXT
 						"Failed to load imported config file \"%s\"! File is imported on line %u in \"%s\"\n"
@@ -333,7 +568,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "GlobalEnvVar"), sizeof "GlobalEnvVar" - 1))
+		else if (Attr->ID == CFGATTR_GLOBALENVVAR)
 		{
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -345,7 +580,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			{
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Malformed global environment variable, line %u in \"%s\".\n"
 						"Cannot set this environment variable.", LineNum, CurConfigFile);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 				continue;
 			}
@@ -353,8 +588,9 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			EnvVarList_Add(DelimCurr, &GlobalEnvVars);
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "DisableCAD"), sizeof "DisableCAD" - 1))
+		else if (Attr->ID == CFGATTR_DISABLECAD)
 		{ /*Should we disable instant reboots on CTRL-ALT-DEL?*/
+			ConfigCache.Seen |= CCACHE_DISABLECAD;
 
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -378,8 +614,9 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "BlankLogOnBoot"), sizeof "BlankLogOnBoot" - 1))
+		else if (Attr->ID == CFGATTR_BLANKLOGONBOOT)
 		{ /*Should the log only hold the current boot cycle's logs?*/
+			ConfigCache.Seen |= CCACHE_BLANKLOG;
 
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -404,8 +641,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "EnableLogging"), sizeof "EnableLogging" - 1))
+		else if (Attr->ID == CFGATTR_ENABLELOGGING)
 		{
+			ConfigCache.Seen |= CCACHE_ENABLELOG;
+			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -431,7 +670,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "RunlevelInherits"), sizeof "RunlevelInherits" - 1))
+		else if (Attr->ID == CFGATTR_RUNLEVELINHERITS)
 		{
 			char Inheriter[MAX_DESCRIPT_SIZE], Inherited[MAX_DESCRIPT_SIZE];
 			const char *TWorker = DelimCurr;
@@ -469,7 +708,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "DefinePriority"), sizeof "DefinePriority" - 1))
+		else if (Attr->ID == CFGATTR_DEFINEPRIORITY)
 		{
 			char Alias[MAX_DESCRIPT_SIZE] = { '\0' };
 			unsigned Target = 0, TInc = 0;
@@ -553,7 +792,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			continue;
 		}
 		/*This will mount /dev, /proc, /sys, /dev/pts, and /dev/shm on boot time, upon request.*/
-		else if (!strncmp(Worker, (CurrentAttribute = "MountVirtual"), strlen("MountVirtual")))
+		else if (Attr->ID == CFGATTR_MOUNTVIRTUAL)
 		{
 			const char *TWorker = DelimCurr;
 			unsigned Inc = 0;
@@ -617,8 +856,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			continue;
 		}
 		/*Now we get into the actual attribute tags.*/
-		else if (!strncmp(Worker, (CurrentAttribute = "BootBannerText"), sizeof "BootBannerText" - 1))
+		else if (Attr->ID == CFGATTR_BOOTBANNERTEXT)
 		{ /*The text shown at boot up as a kind of greeter, before we start executing objects. Can be disabled, off by default.*/
+			ConfigCache.Seen |= CCACHE_BANNER;
+			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -642,8 +883,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "BootBannerColor"), sizeof "BootBannerColor" - 1))
+		else if (Attr->ID == CFGATTR_BOOTBANNERCOLOR)
 		{ /*Color for boot banner.*/
+			ConfigCache.Seen |= CCACHE_BANNER;
+			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -659,11 +902,129 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			SetBannerColor(DelimCurr); /*Function to be found elsewhere will do this for us, otherwise this loop would be even bigger.*/
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "DefaultRunlevel"), sizeof "DefaultRunlevel" - 1))
+		else if (Attr->ID == CFGATTR_CONFIGCACHE)
+		{ /*Keep a compiled copy of the config beside it, so we needn't parse it again until it changes.*/
+			if (!GetLineDelim(Worker, DelimCurr))
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!strcmp(DelimCurr, "true"))
+			{
+				ConfigCache.Enabled = true;
+			}
+			else if (!strcmp(DelimCurr, "false"))
+			{
+				ConfigCache.Enabled = false;
+			}
+			else
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
+			}
+			
+			continue;
+		}
+		else if (Attr->ID == CFGATTR_CONFIGAUTORELOAD)
+		{ /*Reload by ourselves when a config file changes, once it's been left alone this many msecs.*/
+			if (CurObj != NULL)
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EAFTER, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!GetLineDelim(Worker, DelimCurr))
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!strcmp(DelimCurr, "true"))
+			{
+				ConfigAutoReload = CONFIG_AUTORELOAD_DEFAULT;
+			}
+			else if (!strcmp(DelimCurr, "false"))
+			{
+				ConfigAutoReload = 0;
+			}
+			else if (AllNumeric(DelimCurr))
+			{
+				ConfigAutoReload = atoi(DelimCurr);
+			}
+			else
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
+			}
+			
+			continue;
+		}
+		else if (Attr->ID == CFGATTR_BOOTWORKERS)
+		{ /*How many objects sharing a priority we may start at once.*/
+			if (CurObj != NULL)
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EAFTER, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!GetLineDelim(Worker, DelimCurr))
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!AllNumeric(DelimCurr) || atoi(DelimCurr) == 0)
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
+				continue;
+			}
+			
+			if ((BootWorkers = atoi(DelimCurr)) > MAX_BOOT_WORKERS)
+			{
+				ConfigProblem(CurConfigFile, CONFIG_ELARGENUM, CurrentAttribute, DelimCurr, LineNum);
+				BootWorkers = MAX_BOOT_WORKERS;
+			}
+			
+			continue;
+		}
+		else if (Attr->ID == CFGATTR_CGROUPHIERARCHY)
+		{ /*Where objects get their cgroups, or NONE to track by PID only.*/
+			if (CurObj != NULL)
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EAFTER, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!GetLineDelim(Worker, DelimCurr))
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!strcmp(DelimCurr, "NONE"))
+			{
+				*CGroupHierarchy = '\0';
+			}
+			else if (*DelimCurr != '/')
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
+			}
+			else
+			{
+				snprintf(CGroupHierarchy, sizeof CGroupHierarchy, "%s", DelimCurr);
+			}
+			
+			continue;
+		}
+		else if (Attr->ID == CFGATTR_DEFAULTRUNLEVEL)
 		{
 			if (CurRunlevel[0] != 0)
 			{ /*If the runlevel has already been set, don't set it again.
 				* This prevents a rather nasty bug.*/
+				if (!*ConfigCache.DefaultRunlevel)
+				{ /*The cache still wants it, for when it does count.*/
+					if (CurObj != NULL || !GetLineDelim(Worker, DelimCurr)) ConfigCache.Dirty = true;
+					else strncpy(ConfigCache.DefaultRunlevel, DelimCurr, MAX_DESCRIPT_SIZE - 1);
+				}
 				continue;
 			}
 			
@@ -680,11 +1041,14 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}	
 			
 			snprintf(CurRunlevel, MAX_DESCRIPT_SIZE, "%s", DelimCurr);
+			strncpy(ConfigCache.DefaultRunlevel, DelimCurr, MAX_DESCRIPT_SIZE - 1); /*The last byte stays zero.*/
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "LogFile"), sizeof "LogFile" - 1))
+		else if (Attr->ID == CFGATTR_LOGFILE)
 		{ //Specify a log file to use.
+			ConfigCache.Seen |= CCACHE_LOGFILE;
+			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -696,8 +1060,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			strcpy(LogFile, DelimCurr);
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "Hostname"), sizeof "Hostname" - 1))
+		else if (Attr->ID == CFGATTR_HOSTNAME)
 		{
+			ConfigCache.Seen |= CCACHE_HOSTNAME;
+			
 			if (CurObj != NULL)
 			{ /*What the warning says. It'd get all weird if we allowed that.*/
 				ConfigProblem(CurConfigFile, CONFIG_EAFTER, CurrentAttribute, NULL, LineNum);
@@ -726,11 +1092,13 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				if (!(TDesc = fopen(TW, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, "Failed to set hostname from file \"%s\".\n", TW);
-					SpitWarning(ErrBuf);
+					ConfigWarning(ErrBuf);
 					WriteLogLine(ErrBuf, true);
 					continue;
 				}
 				
+				ConfigCache_Depend(TW);
+				
 				for (Inc = 0; (TChar = getc(TDesc)) != EOF && Inc < sizeof Hostname - 1; ++Inc)
 				{ /*There is a reason for this. Just trust me.*/
 					*(unsigned char*)&THostname[Inc] = (unsigned char)TChar;
@@ -760,7 +1128,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			if (strchr(Hostname, ' ') != NULL || strchr(Hostname, '\t') != NULL)
 			{
 				const char *const ErrString = "Tabs and/or spaces in hostname file. Cannot set hostname.";
-				SpitWarning(ErrString);
+				ConfigWarning(ErrString);
 				WriteLogLine(ErrString, true);
 				*Hostname = '\0'; /*Set the hostname back to nothing.*/
 				continue;
@@ -777,13 +1145,15 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "\nHostname attribute on line %u in file \"%s\" has specified\n"
 						"that a hostname inter than %u be set.\nThe specified hostname has been truncated\n"
 						"to fit in the aforementioned space.", LineNum, CurConfigFile, (unsigned)sizeof Hostname - 1);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "Domainname"), sizeof "Domainname" - 1))
+		else if (Attr->ID == CFGATTR_DOMAINNAME)
 		{
+			ConfigCache.Seen |= CCACHE_DOMAINNAME;
+			
 			if (CurObj != NULL)
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EAFTER, CurrentAttribute, NULL, LineNum);
@@ -814,11 +1184,13 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				if (!(TDesc = fopen(TWorker, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Failed to set domain name from file \"%s\".", TWorker);
-					SpitWarning(ErrBuf);
+					ConfigWarning(ErrBuf);
 					WriteLogLine(ErrBuf, true);
 					continue;
 				}
 				
+				ConfigCache_Depend(TWorker);
+				
 				for (; (TChar = getc(TDesc)) != EOF && Inc < sizeof TDomainname - 1; ++Inc)
 				{
 					*(unsigned char*)&TDomainname[Inc] = TChar;
@@ -846,7 +1218,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			if (strchr(Domainname, ' ') || strchr(Domainname, '\t'))
 			{
 				const char *const ErrString = "Tabs and/or spaces in domain name file. Cannot set domain name.";
-				SpitWarning(ErrString);
+				ConfigWarning(ErrString);
 				WriteLogLine(ErrString, true);
 				*Domainname = '\0'; /*Set the hostname back to nothing.*/
 				continue;
@@ -863,13 +1235,15 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "\nDomainname attribute on line %u in file \"%s\" has specified\n"
 						"that a domain name inter than %u be set.\nThe specified domain name has been truncated\n"
 						"to fit in the aforementioned space.", LineNum, CurConfigFile, (unsigned)sizeof Domainname - 1);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "StartingStatusFormat"), sizeof "StartingStatusFormat" - 1))
+		else if (Attr->ID == CFGATTR_STARTINGSTATUSFORMAT)
 		{ /*The first half of our status format, before we get to Done or FAIL or something.*/
+			ConfigCache.Seen |= CCACHE_STATUSFORMAT;
+			
 			if (CurObj != NULL)
 			{ /*What the warning says. It'd get all weird if we allowed that.*/
 				ConfigProblem(CurConfigFile, CONFIG_EAFTER, CurrentAttribute, NULL, LineNum);
@@ -905,10 +1279,12 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				if (stat(Filename, &FileStat) != 0 || !(Desc = fopen(Filename, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, "Unable to open file %s for attribute %s!", Filename, CurrentAttribute);
-					SpitWarning(ErrBuf);
+					ConfigWarning(ErrBuf);
 					continue;
 				}
 				
+				ConfigCache_Depend(Filename);
+				
 				/*Read it in.*/
 				if (FileStat.st_size >= sizeof StatusReportFormat.StartFormat)
 				{
@@ -930,8 +1306,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "FinishedStatusFormat"), sizeof "FinishedStatusFormat" - 1))
+		else if (Attr->ID == CFGATTR_FINISHEDSTATUSFORMAT)
 		{ /*The second half of our status report format, e.g. [ DONE ] (but the Done part is defined in the next one*/
+			ConfigCache.Seen |= CCACHE_STATUSFORMAT;
+			
 			if (CurObj != NULL)
 			{ /*What the warning says. It'd get all weird if we allowed that.*/
 				ConfigProblem(CurConfigFile, CONFIG_EAFTER, CurrentAttribute, NULL, LineNum);
@@ -967,10 +1345,12 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				if (stat(Filename, &FileStat) != 0 || !(Desc = fopen(Filename, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, "Unable to open file %s for attribute %s!", Filename, CurrentAttribute);
-					SpitWarning(ErrBuf);
+					ConfigWarning(ErrBuf);
 					continue;
 				}
 				
+				ConfigCache_Depend(Filename);
+				
 				/*Read it in.*/
 				if (FileStat.st_size >= sizeof StatusReportFormat.FinishFormat)
 				{
@@ -996,8 +1376,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "StatusNames"), sizeof "StatusNames" - 1))
+		else if (Attr->ID == CFGATTR_STATUSNAMES)
 		{ /*We specify our status names here, e.g. FAIL, Done, WARN.*/
+			ConfigCache.Seen |= CCACHE_STATUSFORMAT;
+			
 			unsigned TInc = 0, Lines = 1;
 			char *TW2 = NULL;
 			
@@ -1037,10 +1419,12 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				if (stat(Filename, &FileStat) != 0 || !(Desc = fopen(Filename, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, "Unable to open file %s for attribute %s!", Filename, CurrentAttribute);
-					SpitWarning(ErrBuf);
+					ConfigWarning(ErrBuf);
 					continue;
 				}
 				
+				ConfigCache_Depend(Filename);
+				
 				/*Allocate space for the file's contents*/
 				FileBuf = malloc(FileStat.st_size + 1);
 				
@@ -1107,7 +1491,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectID"), sizeof "ObjectID" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTID)
 		{ /*ASCII value used to identify this object internally, and also a kind of short name for it.*/
 			char *Temp = NULL;
 			
@@ -1121,7 +1505,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			{
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "ObjectIDs may not contain whitespace! Truncating up to occurence of whitespace\n"
 						"Line %u in %s.", LineNum, CurConfigFile);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 				*Temp = '\0';
 			}
@@ -1132,7 +1516,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				
 				//Now alert them.
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "ObjectID contains invalid character. Generating new ID: \"%s\".", DelimCurr);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 			}
 
@@ -1143,7 +1527,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			{
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Duplicate ObjectID %s detected in config file %s, ignoring.",
 						DelimCurr, CurConfigFile);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 				continue;
 			}
@@ -1155,38 +1539,18 @@ ReturnCode InitConfig(const char *CurConfigFile)
 
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectWorkingDirectory"), sizeof "ObjectWorkingDirectory" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTWORKINGDIRECTORY)
 		{
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (CurObj->ObjectWorkingDirectory != NULL)
-			{
-				free(CurObj->ObjectWorkingDirectory);
-			}
-			
-			CurObj->ObjectWorkingDirectory = malloc(strlen(DelimCurr) + 1);
-			
-			strncpy(CurObj->ObjectWorkingDirectory, DelimCurr, strlen(DelimCurr) + 1);	
+			CurObj->ObjectWorkingDirectory = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectEnabled"), sizeof "ObjectEnabled" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTENABLED)
 		{
-			if (!CurObj)
-			{
-
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -1208,18 +1572,12 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectOptions"), sizeof "ObjectOptions" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTOPTIONS)
 		{
 			const char *TWorker = DelimCurr;
 			unsigned Inc;
 			char CurArg[MAX_DESCRIPT_SIZE];
 			
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -1276,7 +1634,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			#else
 					snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Object \"%s\" has specified the FORK option,\n"
 							"but this is not supported on NOMMU builds. Disabling the object.", CurObj->ObjectID);
-					SpitWarning(ErrBuf);
+					ConfigWarning(ErrBuf);
 					WriteLogLine(ErrBuf, true);
 					CurObj->Enabled = false;
 			#endif /*NOMMU*/
@@ -1326,7 +1684,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 						snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Object %s has the option FORCESHELL set,\n"
 								"but Epoch was compiled without shell support.\n"
 								"Ignoring.", CurObj->ObjectID);
-						SpitWarning(ErrBuf);
+						ConfigWarning(ErrBuf);
 						WriteLogLine(ErrBuf, true);
 					#endif
 				}
@@ -1479,26 +1837,17 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectDescription"), sizeof "ObjectDescription" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTDESCRIPTION)
 		{ /*It's description.*/
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (CurObj->ObjectDescription != NULL) free(CurObj->ObjectDescription);
-			
 			DelimCurr[MAX_DESCRIPT_SIZE - 1] = '\0'; /*Chop it off to prevent overflow.*/
 
-			CurObj->ObjectDescription = malloc(strlen(DelimCurr) + 1);
-			strncpy(CurObj->ObjectDescription, DelimCurr, strlen(DelimCurr) + 1);
+			CurObj->ObjectDescription = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 			
 			if ((strlen(DelimCurr) + 1) >= MAX_DESCRIPT_SIZE)
 			{
@@ -1507,24 +1856,15 @@ ReturnCode InitConfig(const char *CurConfigFile)
 
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStartCommand"), sizeof "ObjectStartCommand" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTSTARTCOMMAND)
 		{ /*What we execute to start it.*/
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (CurObj->ObjectStartCommand) free(CurObj->ObjectStartCommand);
-
-			CurObj->ObjectStartCommand = malloc(strlen(DelimCurr) + 1);
-			strncpy(CurObj->ObjectStartCommand, DelimCurr, strlen(DelimCurr) + 1);
+			CurObj->ObjectStartCommand = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 
 			if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
 			{
@@ -1533,24 +1873,15 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectPrestartCommand"), sizeof "ObjectPrestartCommand" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTPRESTARTCOMMAND)
 		{
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (CurObj->ObjectPrestartCommand) free(CurObj->ObjectPrestartCommand);
-			
-			CurObj->ObjectPrestartCommand = malloc(strlen(DelimCurr) + 1);
-			strncpy(CurObj->ObjectPrestartCommand, DelimCurr, strlen(DelimCurr) + 1);
+			CurObj->ObjectPrestartCommand = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 			
 			if (strlen(DelimCurr) + 1 >= MAX_LINE_SIZE)
 			{
@@ -1558,14 +1889,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectReloadCommand"), sizeof "ObjectReloadCommand" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTRELOADCOMMAND)
 		{
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -1587,7 +1912,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 					snprintf(TBuf, sizeof TBuf, "Object \"%s\"'s reload command has 'SIGNAL' specified,\n"
 							"but syntax is not valid.", CurObj->ObjectID);
 					WriteLogLine(TBuf, true);
-					SpitWarning(TBuf);
+					ConfigWarning(TBuf);
 					continue;
 				}
 				
@@ -1640,17 +1965,14 @@ ReturnCode InitConfig(const char *CurConfigFile)
 					snprintf(TBuf, sizeof TBuf, CONFIGWARNTXT
 							"ObjectReloadCommand starts with SIGNAL, but the argument to SIGNAL\n"
 							"is invalid. Object \"%s\" in %s line %u", CurObj->ObjectID, CurConfigFile, LineNum);
-					SpitWarning(TBuf);
+					ConfigWarning(TBuf);
 					WriteLogLine(TBuf, true);
 					continue;
 				}
 			}
 			else
 			{
-				if (CurObj->ObjectReloadCommand) free(CurObj->ObjectReloadCommand);
-				
-				CurObj->ObjectReloadCommand = malloc(strlen(DelimCurr) + 1);
-				strncpy(CurObj->ObjectReloadCommand, DelimCurr, strlen(DelimCurr) + 1);
+				CurObj->ObjectReloadCommand = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 			}
 			
 			if (strlen(DelimCurr) + 1 >= MAX_LINE_SIZE)
@@ -1661,14 +1983,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStopCommand"), sizeof "ObjectStopCommand" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTSTOPCOMMAND)
 		{ /*If it's "PID", then we know that we need to kill the process ID only. If it's "NONE", well, self explanitory.*/
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -1691,8 +2007,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 					
 					if (*Worker != '\0')
 					{
-						CurObj->ObjectPIDFile = malloc(strlen(Worker) + 1);
-						strncpy(CurObj->ObjectPIDFile, Worker, strlen(Worker) + 1);
+						CurObj->ObjectPIDFile = ConfigArena_StrDup(CurObj->Arena, Worker);
 						
 						CurObj->Opts.HasPIDFile = true;
 					}
@@ -1710,9 +2025,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			{
 				CurObj->Opts.StopMode = STOP_COMMAND;
 				
-				if (CurObj->ObjectStopCommand) free(CurObj->ObjectStopCommand);
-				CurObj->ObjectStopCommand = malloc(strlen(DelimCurr) + 1);
-				strncpy(CurObj->ObjectStopCommand, DelimCurr, strlen(DelimCurr) + 1);
+				CurObj->ObjectStopCommand = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 			}
 			
 			if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
@@ -1722,17 +2035,11 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStartPriority"), sizeof "ObjectStartPriority" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTSTARTPRIORITY)
 		{
 			/*The order in which this item is started. If it is disabled in this runlevel, the next object in line is executed, IF
 			 * and only IF it is enabled. If not, the one after that and so on.*/
 			
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -1783,15 +2090,9 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStopPriority"), sizeof "ObjectStopPriority" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTSTOPPRIORITY)
 		{
 			/*Same as above, but used for when the object is being shut down.*/
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -1844,24 +2145,15 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectPIDFile"), sizeof "ObjectPIDFile" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTPIDFILE)
 		{ /*This really needs to be specified if Opts.StopMode is STOP_PIDFILE, or we'll reset the object to STOP_PID.*/
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (CurObj->ObjectPIDFile) free(CurObj->ObjectPIDFile);
-			
-			CurObj->ObjectPIDFile = malloc(strlen(DelimCurr) + 1);
-			strncpy(CurObj->ObjectPIDFile, DelimCurr, strlen(DelimCurr) + 1);
+			CurObj->ObjectPIDFile = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 			
 			CurObj->Opts.HasPIDFile = true;
 			
@@ -1872,16 +2164,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectUser"), sizeof "ObjectUser" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTUSER)
 		{
 			struct passwd *UserStruct = NULL;
 			
-			if (CurObj == NULL)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -1894,10 +2180,13 @@ ReturnCode InitConfig(const char *CurConfigFile)
 						"Unable to lookup requested USER \"%s\" for object \"%s\".\n"
 						"Line %u in %s", DelimCurr, CurObj->ObjectID, LineNum, CurConfigFile);
 				WriteLogLine(ErrBuf, true);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				continue;
 			}
 			
+			ConfigCache_Depend("/etc/passwd");
+			ConfigCache_Depend("/etc/group"); /*For the supplementary groups, even without ObjectGroup.*/
+			
 			CurObj->UserID = (unsigned)UserStruct->pw_uid;
 			
 			if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
@@ -1907,16 +2196,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectGroup"), sizeof "ObjectGroup" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTGROUP)
 		{
 			struct group *GroupStruct = NULL;
 			
-			if (CurObj == NULL)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -1929,10 +2212,12 @@ ReturnCode InitConfig(const char *CurConfigFile)
 						"Unable to lookup requested GROUP \"%s\" for object \"%s\".\n"
 						"Line %u in %s", DelimCurr, CurObj->ObjectID, LineNum, CurConfigFile);
 				WriteLogLine(ErrBuf, true);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				continue;
 			}
 			
+			ConfigCache_Depend("/etc/group");
+			
 			CurObj->GroupID = (unsigned)GroupStruct->gr_gid;
 			
 			if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
@@ -1941,32 +2226,21 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStdout"), sizeof "ObjectStdout" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTSTDOUT)
 		{
-			if (CurObj == NULL)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (CurObj->ObjectStdout) free(CurObj->ObjectStdout);
-			
 			if (!strcmp(DelimCurr, "LOG"))
 			{
-				CurObj->ObjectStdout = malloc(strlen(LogFile) + 1);
-
-				strncpy(CurObj->ObjectStdout, LogFile, strlen(LogFile) + 1);
+				CurObj->ObjectStdout = ConfigArena_StrDup(CurObj->Arena, LogFile);
 			}
 			else
 			{
-				CurObj->ObjectStdout = malloc(strlen(DelimCurr) + 1);
-				strncpy(CurObj->ObjectStdout, DelimCurr, strlen(DelimCurr) + 1);
+				CurObj->ObjectStdout = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 				
 				if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
 				{
@@ -1975,32 +2249,21 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStderr"), sizeof "ObjectStderr" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTSTDERR)
 		{
-			if (CurObj == NULL)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (CurObj->ObjectStderr) free(CurObj->ObjectStderr);
-			
 			if (!strcmp(DelimCurr, "LOG"))
 			{
-				CurObj->ObjectStderr = malloc(strlen(LogFile) + 1);
-
-				strncpy(CurObj->ObjectStderr, LogFile, strlen(LogFile) + 1);
+				CurObj->ObjectStderr = ConfigArena_StrDup(CurObj->Arena, LogFile);
 			}
 			else
 			{
-				CurObj->ObjectStderr = malloc(strlen(DelimCurr) + 1);
-				strncpy(CurObj->ObjectStderr, DelimCurr, strlen(DelimCurr) + 1);
+				CurObj->ObjectStderr = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
 				
 				if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
 				{
@@ -2009,14 +2272,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectEnvVar"), sizeof "ObjectEnvVar" - 1))
+		else if (Attr->ID == CFGATTR_OBJECTENVVAR)
 		{
-			if (!CurObj)
-			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
-				continue;
-			}
-			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
@@ -2027,33 +2284,48 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			{
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT"Malformed environment variable for object %s,\n"
 						"in file \"%s\" line %u. Not setting this environment variable.", CurObj->ObjectID, CurConfigFile, LineNum);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 				continue;
 			}
 			
-			EnvVarList_Add(DelimCurr, &CurObj->EnvVars);
+			EnvVarList_Insert(DelimCurr, &CurObj->EnvVars, CurObj->Arena);
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectRunlevels"), sizeof "ObjectRunlevels" - 1))
-		{ /*Runlevel.*/
-			char *TWorker;
-			char TRL[MAX_DESCRIPT_SIZE], *TRL2;
+		else if (Attr->ID == CFGATTR_OBJECTREQUIRES || Attr->ID == CFGATTR_OBJECTAFTER)
+		{ /*Objects we must be started after. Used by the boot scheduler in parse.c.*/
+			char **Target = NULL;
 			
-			if (!CurObj)
+			if (!GetLineDelim(Worker, DelimCurr))
 			{
-				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
+				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (CurObj->ObjectRunlevels != NULL)
-			{ /*We cannot have multiple runlevel attributes because it messes up config file editing.*/
-				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Object %s has more than one ObjectRunlevels line.\n"
-						"This is not advised because the config file editing code is not smart enough\n"
+			Target = Attr->ID == CFGATTR_OBJECTREQUIRES ? &CurObj->ObjectRequires : &CurObj->ObjectAfter;
+			
+			*Target = ConfigArena_StrDup(CurObj->Arena, DelimCurr);
+			
+			if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
+			{
+				ConfigProblem(CurConfigFile, CONFIG_ETRUNCATED, CurrentAttribute, DelimCurr, LineNum);
+			}
+			
+			continue;
+		}
+		else if (Attr->ID == CFGATTR_OBJECTRUNLEVELS)
+		{ /*Runlevel.*/
+			char *TWorker;
+			char TRL[MAX_DESCRIPT_SIZE], *TRL2;
+			
+			if (CurObj->ObjectRunlevels != NULL)
+			{ /*We cannot have multiple runlevel attributes because it messes up config file editing.*/
+				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Object %s has more than one ObjectRunlevels line.\n"
+						"This is not advised because the config file editing code is not smart enough\n"
 						"to handle multiple lines. You should put the additional runlevels on the same line.\n"
 						"Line %u in %s",
 						CurObj->ObjectID, LineNum, CurConfigFile);
-				SpitWarning(ErrBuf);
+				ConfigWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 			}
 			
@@ -2085,20 +2357,13 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			continue;
 
 		}
-		else
-		{ /*No big deal.*/
-			snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Unidentified attribute in %s on line %u.", CurConfigFile, LineNum);
-			SpitWarning(ErrBuf);
-			WriteLogLine(ErrBuf, true);
-			continue;
-		}
 	} while (++LineNum, (Worker = NextLine(Worker)));
 	
 	/*This is harmless, but it's bad form and could indicate human error in writing the config file.*/
 	if (LongComment)
 	{
 		snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "No comment terminator at end of config file \"%s\".", CurConfigFile);
-		SpitWarning(ErrBuf);
+		ConfigWarning(ErrBuf);
 		WriteLogLine(ErrBuf, true);
 	}
 	
@@ -2115,9 +2380,16 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 		}
 		
-		switch (ScanConfigIntegrity())
+		switch (ScanConfigIntegrity(false))
 		{
 			case SUCCESS:
+				if (ConfigCache.Enabled && !ConfigCache.Dirty)
+				{
+					ConfigCache_Save(TrueLogEnable);
+					break;
+				}
+				
+				ConfigCache_Remove(); /*Otherwise make sure there's no old one lying around.*/
 				break;
 			case FAILURE:
 				/*We failed integrity checking.*/
@@ -2129,13 +2401,22 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			{
 				const char *const WarnTxt = "Noncritical configuration problems exist. Check your logs.";
 				
+				ConfigCache_Remove();
+				
 				WriteLogLine(WarnTxt, true);
-				SpitWarning(WarnTxt);
+				ConfigWarning(WarnTxt);
 				break;
 	
 			}
 		}
 		
+		/*Now that ScanConfigIntegrity() is done changing them, work out everything launching the commands needs.*/
+		for (ObjWorker = ObjectTable; ObjWorker->Next; ObjWorker = ObjWorker->Next)
+		{
+			ObjTable_PrepareLaunch(ObjWorker);
+		}
+		
+		ConfigCache_Stamp(&LoadedStamp);
 		LogInMemory = PrevLogInMemory;
 		EnableLogging = TrueLogEnable;
 	}
@@ -2202,6 +2483,60 @@ static ReturnCode GetLineDelim(const char *InStream, char *OutStream)
 	return SUCCESS;
 }
 
+static const struct _ConfigAttr *ConfigAttr_Lookup(const char *Line)
+{ /*Binary search for the attribute name that starts Line. It ends where GetLineDelim() says it does.*/
+	unsigned Length = 0;
+	int Lower = 0, Upper = sizeof ConfigAttrs / sizeof *ConfigAttrs - 1;
+	
+	while (Line[Length] != ' ' && Line[Length] != '\t' && Line[Length] != '=' &&
+			Line[Length] != '\n' && Line[Length] != '\0') ++Length;
+	
+	while (Lower <= Upper)
+	{
+		const int Middle = (Lower + Upper) / 2;
+		int Diff = strncmp(Line, ConfigAttrs[Middle].Name, Length);
+		
+		if (Diff == 0 && ConfigAttrs[Middle].Name[Length] != '\0')
+		{ /*We're only a prefix of this one, so we sort before it.*/
+			Diff = -1;
+		}
+		
+		if (Diff == 0) return ConfigAttrs + Middle;
+		
+		if (Diff < 0) Upper = Middle - 1;
+		else Lower = Middle + 1;
+	}
+	
+	return NULL;
+}
+
+static short ConfigLine_SkipComment(char **Line, Bool *LongComment)
+{ /*Multi-line comments, for everything that reads config files. *Line is the start of a line, past any indentation.
+	* Returns 1 if the line is commented out, -1 for a stray terminator, or 0 to go on reading at *Line.*/
+	if (!strncmp(*Line, "<!<", sizeof "<!<" - 1))
+	{
+		if (!*LongComment) return -1;
+		
+		*LongComment = false;
+		
+		/*Allow next line to begin right ater the terminator on the same line.*/
+		*Line += sizeof "<!<" - 1;
+		while (**Line == ' ' || **Line == '\t') ++*Line;
+		
+		return 0;
+	}
+	
+	if (*LongComment) return 1;
+	
+	if (!strncmp(*Line, ">!>", sizeof ">!>" - 1))
+	{
+		*LongComment = true;
+		return 1;
+	}
+	
+	return 0;
+}
+
 ReturnCode MergeImportLine(const char *LineData)
 { //I'm so tired of bugs in my config writing functions that I wrote this one with nice, safe, pointer black magic. I hope it helps.
 	char NewData[MAX_LINE_SIZE];
@@ -2328,14 +2663,23 @@ ReturnCode UnmergeImportLine(const char *Filename)
 ReturnCode EditConfigValue(const char *File, const char *ObjectID, const char *Attribute, const char *Value)
 { /*Looks up the attribute for the passed ID and replaces the value for that attribute.*/
 	char *MasterStream = NULL, *HalfTwo = NULL;
-	char *NewValue = NULL, *Worker = NULL, *Stopper = NULL, *LineArm = NULL;
+	char *NewValue = NULL, *Worker = NULL, *LineArm = NULL;
 	char LineWorkerR[MAX_LINE_SIZE];
+	const struct _ConfigAttr *const Attr = ConfigAttr_Lookup(Attribute), *LineAttr = NULL;
 	FILE *Descriptor = NULL;
 	char *WhiteSpace = NULL, *LineWorker = NULL;
 	struct stat FileStat;
 	unsigned Inc = 0, Inc2 = 0, LineNum = 1;
 	unsigned NumWhiteSpaces = 0;
-	Bool PresentHalfTwo = false;
+	Bool PresentHalfTwo = false, LongComment = false;
+	
+	if (!Attr || !Attr->ObjectAttr)
+	{ /*We only know how to find attributes that live under an ObjectID.*/
+		char ErrBuf[MAX_LINE_SIZE];
+		snprintf(ErrBuf, sizeof ErrBuf, "EditConfigValue(): \"%s\" is not an object attribute.", Attribute);
+		SpitError(ErrBuf);
+		return FAILURE;
+	}
 	
 	if (stat(File, &FileStat) != 0)
 	{
@@ -2390,7 +2734,9 @@ ReturnCode EditConfigValue(const char *File, const char *ObjectID, const char *A
 		
 		LineWorker = &LineWorkerR[Inc2];
 		
-		if (strncmp(LineWorker, "ObjectID", strlen("ObjectID")) != 0)
+		if (ConfigLine_SkipComment(&LineWorker, &LongComment) != 0) continue; /*The same as the loader sees it.*/
+		
+		if (!(LineAttr = ConfigAttr_Lookup(LineWorker)) || LineAttr->ID != CFGATTR_OBJECTID)
 		{ /*Not ObjectID?*/
 			continue;
 		}
@@ -2434,20 +2780,31 @@ ReturnCode EditConfigValue(const char *File, const char *ObjectID, const char *A
 		return FAILURE;
 	}
 	
-	/*Do not accidentally jump to a different object's attribute of the same name.*/
-	if ((Stopper = strstr(Worker, "ObjectID")) != NULL)
+	/*Walk the object's own lines, stopping at the next ObjectID so we don't jump to a different object's
+	 * attribute of the same name. Whole names are compared, so comments and values that contain it don't count.*/
+	LongComment = false; /*The ObjectID line wasn't in one.*/
+	
+	while ((Worker = NextLine(Worker)) != NULL)
 	{
-		*Stopper = '\0';
+		while (*Worker == ' ' || *Worker == '\t') ++Worker;
+		
+		if (ConfigLine_SkipComment(&Worker, &LongComment) != 0) continue;
+		
+		if ((LineAttr = ConfigAttr_Lookup(Worker)) == Attr) break;
+		
+		if (LineAttr != NULL && LineAttr->ID == CFGATTR_OBJECTID)
+		{
+			Worker = NULL;
+			break;
+		}
 	}
 	
-	if (!(Worker = strstr(Worker, Attribute)) || (Worker > &LineArm[0] && *(Worker - 1) == '#'))
-	{ /*Doesn't exist for that object? We also ignore comments.*/
+	if (Worker == NULL)
+	{ /*Doesn't exist for that object?*/
 		free(MasterStream);
 		return FAILURE;
 	}
 	
-	if (Stopper) *Stopper = 'O'; /*set back, use capital O.*/
-	
 	/*Null-terminate half one.*/
 	*Worker++ = '\0';
 	
@@ -2561,7 +2918,7 @@ ReturnCode EditConfigValue(const char *File, const char *ObjectID, const char *A
 /*Adds an object to the table and, if the first run, sets up the table.*/
 static ObjTable *AddObjectToTable(const char *ObjectID, const char *File)
 {
-	ObjTable *Worker = ObjectTable, *Next, *Prev;
+	ObjTable *Worker = NULL, *Next, *Prev;
 	int Inc = 0;
 	/*See, we actually allocate two cells initially. The base and it's node.
 	 * We always keep a free one open. This is just more convenient.*/
@@ -2571,20 +2928,20 @@ static ObjTable *AddObjectToTable(const char *ObjectID, const char *File)
 		ObjectTable->Prev = NULL;
 		ObjectTable->Next = NULL;
 
-		Worker = ObjectTable;
+		ObjectIndex.Tail = ObjectTable;
 	}
 	
-	for (; Worker->Next; Worker = Worker->Next)
-	{
-		if (!strcmp(ObjectID, Worker->ObjectID))
-		{ /*Do not allow duplicate entries.*/
-			return NULL;
-		}
+	if (ObjIndex_Lookup(ObjectID))
+	{ /*Do not allow duplicate entries.*/
+		return NULL;
 	}
+	
+	Worker = ObjectIndex.Tail;
 
 	Worker->Next = malloc(sizeof(ObjTable));
 	Worker->Next->Next = NULL;
 	Worker->Next->Prev = Worker;
+	ObjectIndex.Tail = Worker->Next;
 
 	/*These are the only two variables inside that we need to save before we wipe.*/
 	Next = Worker->Next;
@@ -2595,15 +2952,20 @@ static ObjTable *AddObjectToTable(const char *ObjectID, const char *File)
 	Worker->Next = Next;
 	Worker->Prev = Prev;
 	
+	if (!CurArena) CurArena = ConfigArena_New();
+	
+	Worker->Arena = CurArena;
+	++CurArena->Users;
+	
 	/*This is the first thing that must ever be initialized, because it's how we tell objects apart.*/
-	/*This and all things like it are dynamically allocated to provide aggressive memory savings.*/
-	Worker->ObjectID = malloc(strlen(ObjectID) + 1);
-	strncpy(Worker->ObjectID, ObjectID, strlen(ObjectID) + 1);
+	/*This and all things like it are allocated from the arena to provide aggressive memory savings.*/
+	Worker->ObjectID = ConfigArena_StrDup(Worker->Arena, ObjectID);
 	
 	Worker->ConfigFile = File; /*Set the config file. The pointer actually points to an element in ConfigFileList.*/
 	
 	/*Initialize these to their default values. Used to test integrity before execution begins.*/
 	Worker->TermSignal = SIGTERM; /*This can be changed via config.*/
+	Worker->PIDFD = -1;
 	Worker->Enabled = 2; /*We can indeed store this in a bool you know.
 						There's no 1 bit datatype, and in Epoch,
 						Bool is just signed char.*/
@@ -2614,11 +2976,14 @@ static ObjTable *AddObjectToTable(const char *ObjectID, const char *File)
 		Worker->ExitStatuses[Inc].Value = 3; /*One above what we will ever see.*/
 	}
 	
+	ObjIndex_Add(Worker);
+	ObjSchedule_Invalidate();
+	
 	return Worker;
 }
 
-static ReturnCode ScanConfigIntegrity(void)
-{ /*Here we check common mistakes and problems.*/
+static ReturnCode ScanConfigIntegrity(Bool RunlevelOnly)
+{ /*Here we check common mistakes and problems. RunlevelOnly is for configs from the cache, which were checked already.*/
 #define IntegrityWarn(msg) WriteLogLine(msg, true), SpitWarning(msg)
 	ObjTable *Worker = ObjectTable, *TOffender;
 	char TmpBuf[1024];
@@ -2690,7 +3055,7 @@ static ReturnCode ScanConfigIntegrity(void)
 			
 	}
 	
-	for (; Worker->Next != NULL; Worker = Worker->Next)
+	for (; !RunlevelOnly && Worker->Next != NULL; Worker = Worker->Next)
 	{		
 		if (Worker->ObjectStartCommand == NULL && Worker->ObjectStopCommand == NULL && Worker->Opts.StopMode == STOP_COMMAND)
 		{
@@ -2796,11 +3161,7 @@ static ReturnCode ScanConfigIntegrity(void)
 			Worker->Opts.StopMode = STOP_NONE;
 			Worker->ObjectStopPriority = 0;
 			
-			if (Worker->ObjectStopCommand)
-			{
-				free(Worker->ObjectStopCommand);
-				Worker->ObjectStopCommand = NULL;
-			}
+			Worker->ObjectStopCommand = NULL; /*It's in the arena, so it goes when the rest of the object does.*/
 			
 			if (RetState) RetState = WARNING;
 		}
@@ -2813,24 +3174,55 @@ static ReturnCode ScanConfigIntegrity(void)
 			
 			Worker->Opts.HasPIDFile = false;
 			
-			if (Worker->ObjectPIDFile)
-			{
-				free(Worker->ObjectPIDFile);
-				Worker->ObjectPIDFile = NULL;
-			}
+			Worker->ObjectPIDFile = NULL;
 			
 			if (RetState) RetState = WARNING;
 		}
 		
-		/*Check for duplicate ObjectIDs.*/
-		for (TOffender = ObjectTable; TOffender->Next != NULL; TOffender = TOffender->Next)
-		{
-			if (!strcmp(Worker->ObjectID, TOffender->ObjectID) && Worker != TOffender)
+		if (Worker->ObjectRequires || Worker->ObjectAfter)
+		{ /*Make sure whatever we depend on actually exists.*/
+			const char *Lists[2] = { Worker->ObjectRequires, Worker->ObjectAfter };
+			const char *DepWorker = NULL;
+			char DepID[MAX_DESCRIPT_SIZE];
+			unsigned DInc = 0, TInc = 0;
+			
+			for (; DInc < 2; ++DInc)
 			{
-				snprintf(TmpBuf, 1024, "Two objects in configuration with ObjectID \"%s\".", Worker->ObjectID);
-				SpitError(TmpBuf);
-				RetState = FAILURE;
-			}			
+				if (!(DepWorker = Lists[DInc])) continue;
+				
+				do
+				{
+					for (TInc = 0; DepWorker[TInc] != ' ' && DepWorker[TInc] != '\t' &&
+						DepWorker[TInc] != '\0' && TInc < sizeof DepID - 1; ++TInc)
+					{
+						DepID[TInc] = DepWorker[TInc];
+					}
+					DepID[TInc] = '\0';
+					
+					if (!strcmp(DepID, Worker->ObjectID))
+					{
+						snprintf(TmpBuf, 1024, "Object \"%s\" lists itself in %s.", Worker->ObjectID,
+								DInc == 0 ? "ObjectRequires" : "ObjectAfter");
+						IntegrityWarn(TmpBuf);
+						if (RetState) RetState = WARNING;
+					}
+					else if (!LookupObjectInTable(DepID))
+					{
+						snprintf(TmpBuf, 1024, "Object \"%s\" lists nonexistent object \"%s\" in %s.",
+								Worker->ObjectID, DepID, DInc == 0 ? "ObjectRequires" : "ObjectAfter");
+						IntegrityWarn(TmpBuf);
+						if (RetState) RetState = WARNING;
+					}
+				} while ((DepWorker = WhitespaceArg(DepWorker)));
+			}
+		}
+		
+		/*Check for duplicate ObjectIDs. The index only holds one of each, so a duplicate won't find itself.*/
+		if ((TOffender = LookupObjectInTable(Worker->ObjectID)) != Worker)
+		{
+			snprintf(TmpBuf, 1024, "Two objects in configuration with ObjectID \"%s\".", Worker->ObjectID);
+			SpitError(TmpBuf);
+			RetState = FAILURE;
 		}
 	}
 			
@@ -2845,42 +3237,106 @@ static ReturnCode ScanConfigIntegrity(void)
  * access to the table.*/
 ObjTable *LookupObjectInTable(const char *ObjectID)
 {
-	ObjTable *Worker = ObjectTable;
-
 	if (!ObjectTable)
 	{
 		return NULL;
 	}
 	
-	for (; Worker->Next; Worker = Worker->Next)
+	return ObjIndex_Lookup(ObjectID);
+}
+
+static unsigned PriorityOfLookup(const char *const ObjectID, Bool IsStartingMode)
+{
+	const ObjTable *Worker = NULL;
+	
+	if (!ObjectTable || !(Worker = ObjIndex_Lookup(ObjectID))) return 0;
+	
+	return IsStartingMode ? Worker->ObjectStartPriority : Worker->ObjectStopPriority;
+}
+
+/*Functions for the object index.*/
+static unsigned ObjIndex_Hash(const char *ObjectID)
+{ /*FNV-1a. Nothing fancy needed for ObjectIDs.*/
+	unsigned Hash = 2166136261u;
+	
+	for (; *ObjectID != '\0'; ++ObjectID)
 	{
-		if (!strcmp(Worker->ObjectID, ObjectID))
+		Hash ^= (unsigned char)*ObjectID;
+		Hash *= 16777619u;
+	}
+	
+	return Hash;
+}
+
+static void ObjIndex_Add(ObjTable *InObj)
+{
+	unsigned Slot = 0;
+	
+	if ((ObjectIndex.Count + 1) * 2 > ObjectIndex.Size)
+	{ /*Grow and rehash everything we have.*/
+		ObjTable **OldSlots = ObjectIndex.Slots;
+		const unsigned OldSize = ObjectIndex.Size;
+		unsigned Inc = 0;
+		
+		ObjectIndex.Size = OldSize ? OldSize * 2 : 64;
+		ObjectIndex.Slots = calloc(ObjectIndex.Size, sizeof(ObjTable*));
+		ObjectIndex.Count = 0;
+		
+		for (; Inc < OldSize; ++Inc)
 		{
-			return Worker;
+			if (OldSlots[Inc]) ObjIndex_Add(OldSlots[Inc]);
 		}
+		
+		free(OldSlots);
 	}
+	
+	for (Slot = ObjIndex_Hash(InObj->ObjectID) & (ObjectIndex.Size - 1); ObjectIndex.Slots[Slot];
+		Slot = (Slot + 1) & (ObjectIndex.Size - 1))
+	{
+		if (!strcmp(ObjectIndex.Slots[Slot]->ObjectID, InObj->ObjectID)) return; /*Keep the first one.*/
+	}
+	
+	ObjectIndex.Slots[Slot] = InObj;
+	++ObjectIndex.Count;
+}
 
+static ObjTable *ObjIndex_Lookup(const char *ObjectID)
+{
+	unsigned Slot = 0;
+	
+	if (!ObjectIndex.Size) return NULL;
+	
+	for (Slot = ObjIndex_Hash(ObjectID) & (ObjectIndex.Size - 1); ObjectIndex.Slots[Slot];
+		Slot = (Slot + 1) & (ObjectIndex.Size - 1))
+	{
+		if (!strcmp(ObjectIndex.Slots[Slot]->ObjectID, ObjectID)) return ObjectIndex.Slots[Slot];
+	}
+	
 	return NULL;
 }
 
-static unsigned PriorityOfLookup(const char *const ObjectID, Bool IsStartingMode)
-{
+static void ObjIndex_Rebuild(void)
+{ /*Used when ObjectTable gets swapped out from under us, like when ReloadConfig() restores a backup.*/
 	ObjTable *Worker = ObjectTable;
 	
-	if (!ObjectTable) return 0;
+	ObjIndex_Shutdown();
+	
+	if (!ObjectTable) return;
 	
 	for (; Worker->Next; Worker = Worker->Next)
 	{
-		if (!strcmp(ObjectID, Worker->ObjectID))
-		{
-			return IsStartingMode ? Worker->ObjectStartPriority : Worker->ObjectStopPriority;
-		}
+		ObjIndex_Add(Worker);
 	}
 	
-	return 0;
+	ObjectIndex.Tail = Worker;
 }
 
-
+static void ObjIndex_Shutdown(void)
+{
+	if (ObjectIndex.Slots) free(ObjectIndex.Slots);
+	
+	memset(&ObjectIndex, 0, sizeof ObjectIndex);
+}
 
 /*Get the max priority number we need to scan.*/
 unsigned GetHighestPriority(Bool WantStartPriority)
@@ -2912,65 +3368,38 @@ unsigned GetHighestPriority(Bool WantStartPriority)
 }
 
 /*Functions for environment variable management.*/
-void EnvVarList_Add(const char *Var, struct _EnvVarList **const List)
-{
-	struct _EnvVarList *Worker = *List;
+static void EnvVarList_Insert(const char *Var, struct _EnvVarList **const List, struct _ConfigArena *Arena)
+{ /*Arena is NULL for the global list, which is malloc()'d, since it doesn't belong to any object.*/
+	struct _EnvVarList *Worker = *List, *New = NULL;
+	const size_t Length = strlen(Var) + 1;
 	
 	if (!*List)
 	{
-		Worker = *List = malloc(sizeof(struct _EnvVarList));
+		Worker = *List = Arena ? ConfigArena_Alloc(Arena, sizeof(struct _EnvVarList) + 1)
+								: malloc(sizeof(struct _EnvVarList) + 1);
 		Worker->Next = NULL;
 		Worker->Prev = NULL;
-		
+		*Worker->EnvVar = '\0';
 	}
 	
 	while (Worker->Next) Worker = Worker->Next;
 	
-	Worker->Next = malloc(sizeof(struct _EnvVarList));
-	Worker->Next->Next = NULL;
-	Worker->Next->Prev = Worker;
+	/*New nodes go in ahead of the empty one at the end.*/
+	New = Arena ? ConfigArena_Alloc(Arena, sizeof(struct _EnvVarList) + Length) : malloc(sizeof(struct _EnvVarList) + Length);
+	memcpy(New->EnvVar, Var, Length);
+	
+	New->Next = Worker;
+	New->Prev = Worker->Prev;
+	
+	if (Worker->Prev) Worker->Prev->Next = New;
+	else *List = New;
 	
-	/*Copy in the environment variable.*/
-	strncpy(Worker->EnvVar, Var, sizeof Worker->EnvVar - 1);
-	Worker->EnvVar[sizeof Worker->EnvVar - 1] = '\0';
+	Worker->Prev = New;
 }
 
-Bool EnvVarList_Del(const char *const Check, struct _EnvVarList **const List) /*Check if either the object or the envvar are the same pointer, delete those that match.*/
+void EnvVarList_Add(const char *Var, struct _EnvVarList **const List)
 {
-	struct _EnvVarList *Worker = NULL;
-	
-	if (!Check || !List || !*List) return false;
-	
-	Worker = *List;
-	
-	for (; Worker->Next; Worker = Worker->Next)
-	{
-		if (Worker->EnvVar == Check)
-		{
-			if (Worker == *List)
-			{
-				if (!Worker->Next->Next)
-				{
-					EnvVarList_Shutdown(List);
-				}
-				else
-				{
-					Worker->Next->Prev = NULL;
-					*List = Worker->Next;
-					free(Worker);
-				}
-			}
-			else
-			{
-				Worker->Next->Prev = Worker->Prev;
-				Worker->Prev->Next = Worker->Next;
-				free(Worker);
-			}
-			return true;
-		}
-	}
-	
-	return false;
+	EnvVarList_Insert(Var, List, NULL);
 }
 
 void EnvVarList_Shutdown(struct _EnvVarList **const List)
@@ -3024,24 +3453,37 @@ Bool ObjRL_CheckRunlevel(const char *InRL, const ObjTable *InObj, Bool CountInhe
 
 void ObjRL_AddRunlevel(const char *InRL, ObjTable *InObj)
 {
-	struct _RLTree *Worker = InObj->ObjectRunlevels;
+	struct _RLTree *Worker = InObj->ObjectRunlevels, *New = NULL;
+	size_t Length = strlen(InRL);
+	
+	if (Length >= MAX_DESCRIPT_SIZE) Length = MAX_DESCRIPT_SIZE - 1;
 	
 	if (InObj->ObjectRunlevels == NULL)
 	{
-		InObj->ObjectRunlevels = malloc(sizeof(struct _RLTree));
+		InObj->ObjectRunlevels = ConfigArena_Alloc(InObj->Arena, sizeof(struct _RLTree) + 1);
 		
 		InObj->ObjectRunlevels->Prev = NULL;
 		InObj->ObjectRunlevels->Next = NULL;
+		*InObj->ObjectRunlevels->RL = '\0';
 		Worker = InObj->ObjectRunlevels;
 	}
 	
 	while (Worker->Next != NULL) Worker = Worker->Next;
 	
-	Worker->Next = malloc(sizeof(struct _RLTree));
-	Worker->Next->Next = NULL;
-	Worker->Next->Prev = Worker;
+	/*The empty node stays at the end, so the new one goes in front of it.*/
+	New = ConfigArena_Alloc(InObj->Arena, sizeof(struct _RLTree) + Length + 1);
+	memcpy(New->RL, InRL, Length);
+	New->RL[Length] = '\0';
+	
+	New->Next = Worker;
+	New->Prev = Worker->Prev;
+	
+	if (Worker->Prev) Worker->Prev->Next = New;
+	else InObj->ObjectRunlevels = New;
 	
-	snprintf(Worker->RL, MAX_DESCRIPT_SIZE, "%s", InRL);
+	Worker->Prev = New;
+	
+	ObjSchedule_Invalidate();
 }
 
 Bool ObjRL_DelRunlevel(const char *InRL, ObjTable *InObj)
@@ -3057,6 +3499,8 @@ Bool ObjRL_DelRunlevel(const char *InRL, ObjTable *InObj)
 	{
 		if (!strcmp(InRL, Worker->RL))
 		{
+			ObjSchedule_Invalidate();
+			
 			if (Worker == InObj->ObjectRunlevels)
 			{ /*If it's the first node*/
 				
@@ -3064,7 +3508,6 @@ Bool ObjRL_DelRunlevel(const char *InRL, ObjTable *InObj)
 				{ /*Are there other runlevels enabled, or just us?*/
 					InObj->ObjectRunlevels->Next->Prev = NULL;
 					InObj->ObjectRunlevels = InObj->ObjectRunlevels->Next;
-					free(Worker);
 				}
 				else
 				{ /*Apparently just us.*/
@@ -3074,11 +3517,9 @@ Bool ObjRL_DelRunlevel(const char *InRL, ObjTable *InObj)
 				return true;
 			}
 				
-			/*Otherwise, do this.*/
+			/*Otherwise, do this. The node itself is in the arena and goes with the object.*/
 			Worker->Prev->Next = Worker->Next;
 			Worker->Next->Prev = Worker->Prev;	
-				
-			free(Worker);
 			
 			return true;
 		}
@@ -3105,15 +3546,7 @@ Bool ObjRL_ValidRunlevel(const char *InRL)
 }
 
 void ObjRL_ShutdownRunlevels(ObjTable *InObj)
-{
-	struct _RLTree *Worker = InObj->ObjectRunlevels, *NDel;
-	
-	for (; Worker != NULL; Worker = NDel)
-	{
-		NDel = Worker->Next;
-		free(Worker);
-	}
-	
+{ /*The nodes are in the object's arena, so all we do is forget them.*/
 	InObj->ObjectRunlevels = NULL;
 }
 
@@ -3203,6 +3636,7 @@ static void RLInheritance_Add(const char *Inheriter, const char *Inherited)
 	strncpy(Worker->Inheriter, Inheriter, strlen(Inheriter) + 1);
 	strncpy(Worker->Inherited, Inherited, strlen(Inherited) + 1);
 	
+	ObjSchedule_Invalidate();
 }
 
 static Bool RLInheritance_Check(const char *Inheriter, const char *Inherited)
@@ -3235,28 +3669,94 @@ static void RLInheritance_Shutdown(void)
 	RunlevelInheritance = NULL;
 }
 
-ObjTable *GetObjectByPriority(const char *ObjectRunlevel, ObjTable *LastNode, Bool WantStartPriority, unsigned ObjectPriority)
-{ /*The primary lookup function to be used when executing commands.*/
-	ObjTable *Worker = LastNode ? LastNode->Next : ObjectTable;
-	unsigned WorkerPriority = 0;
+static int ObjSchedule_Compare(const void *First_, const void *Second_)
+{ /*Sort by priority, then by position in the table, so same-priority objects keep config order.*/
+	const struct _ScheduleSorter *First = First_, *Second = Second_;
+	
+	if (First->Priority != Second->Priority) return First->Priority < Second->Priority ? -1 : 1;
+	
+	return First->Order < Second->Order ? -1 : (First->Order > Second->Order);
+}
+
+ObjTable **GetObjectSchedule(const char *ObjectRunlevel, Bool WantStartPriority)
+{ /*Returns a NULL terminated array of every object we'd run for this runlevel, in priority order.
+	* Priority zero objects are left out. The array belongs to us, and only lives until the config
+	* or runlevel membership changes, so don't keep it around.*/
+	const Bool KCmdLine = CurrentBootMode == BOOT_BOOTUP;
+	struct _ScheduleCache *Cache = ScheduleCache;
+	struct _ScheduleSorter *Sorter = NULL;
+	ObjTable *Worker = ObjectTable;
+	unsigned NumObjects = 0, Inc = 0;
 	
 	if (!ObjectTable)
 	{
-		return (void*)-1; /*Error.*/
+		return NULL; /*Error.*/
 	}
 	
-	for (; Worker->Next != NULL; Worker = Worker->Next)
+	for (; Cache; Cache = Cache->Next)
 	{
-		WorkerPriority = (WantStartPriority ? Worker->ObjectStartPriority : Worker->ObjectStopPriority);
+		if (Cache->WantStartPriority == WantStartPriority && Cache->KCmdLine == KCmdLine &&
+			(ObjectRunlevel ? !Cache->AnyRunlevel && !strcmp(Cache->RL, ObjectRunlevel) : Cache->AnyRunlevel))
+		{
+			return Cache->Schedule;
+		}
+	}
+	
+	for (; Worker->Next; Worker = Worker->Next) ++NumObjects;
+	
+	Sorter = malloc(sizeof *Sorter * (NumObjects + 1));
+	
+	for (NumObjects = 0, Worker = ObjectTable; Worker->Next; Worker = Worker->Next, ++Inc)
+	{
+		const unsigned WorkerPriority = (WantStartPriority ? Worker->ObjectStartPriority : Worker->ObjectStopPriority);
+		
+		if (WorkerPriority == 0) continue;
 		
-		if ((ObjectRunlevel == NULL || ((WantStartPriority || !Worker->Opts.HaltCmdOnly) &&
-			(ObjRL_CheckRunlevel(ObjectRunlevel, Worker, true) || (CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(Worker->ObjectID, true))) )) && WorkerPriority == ObjectPriority)
+		if (ObjectRunlevel == NULL || ((WantStartPriority || !Worker->Opts.HaltCmdOnly) &&
+			(ObjRL_CheckRunlevel(ObjectRunlevel, Worker, true) || (KCmdLine && KCmdLineObjCmd_Check(Worker->ObjectID, true)))))
 		{
-			return Worker;
+			Sorter[NumObjects].Obj = Worker;
+			Sorter[NumObjects].Priority = WorkerPriority;
+			Sorter[NumObjects].Order = Inc;
+			++NumObjects;
 		}
 	}
 	
-	return NULL;
+	qsort(Sorter, NumObjects, sizeof *Sorter, ObjSchedule_Compare);
+	
+	Cache = malloc(sizeof(struct _ScheduleCache));
+	memset(Cache, 0, sizeof(struct _ScheduleCache));
+	
+	if (ObjectRunlevel) snprintf(Cache->RL, sizeof Cache->RL, "%s", ObjectRunlevel);
+	Cache->AnyRunlevel = ObjectRunlevel == NULL;
+	Cache->WantStartPriority = WantStartPriority;
+	Cache->KCmdLine = KCmdLine;
+	Cache->Schedule = malloc(sizeof(ObjTable*) * (NumObjects + 1));
+	
+	for (Inc = 0; Inc < NumObjects; ++Inc)
+	{
+		Cache->Schedule[Inc] = Sorter[Inc].Obj;
+	}
+	Cache->Schedule[NumObjects] = NULL;
+	
+	free(Sorter);
+	
+	Cache->Next = ScheduleCache;
+	ScheduleCache = Cache;
+	
+	return Cache->Schedule;
+}
+
+void ObjSchedule_Invalidate(void)
+{ /*Call whenever priorities, runlevels or the table itself change.*/
+	struct _ScheduleCache *Temp = NULL;
+	
+	for (; ScheduleCache; ScheduleCache = Temp)
+	{
+		Temp = ScheduleCache->Next;
+		free(ScheduleCache->Schedule);
+		free(ScheduleCache);
+	}
 }
 
 void ShutdownConfig(void)
@@ -3268,32 +3768,20 @@ void ShutdownConfig(void)
 	
 	for (; Worker != NULL; Worker = Temp)
 	{
-		if (Worker->Next)
-		{
-			if (Worker->ObjectID) free(Worker->ObjectID);
-			
-			if (Worker->ObjectDescription &&
-				Worker->ObjectDescription != Worker->ObjectID) free(Worker->ObjectDescription);
-				
-			if (Worker->ObjectStartCommand) free(Worker->ObjectStartCommand);
-			if (Worker->ObjectStopCommand) free(Worker->ObjectStopCommand);
-			if (Worker->ObjectReloadCommand) free(Worker->ObjectReloadCommand);
-			if (Worker->ObjectPrestartCommand) free(Worker->ObjectPrestartCommand);
-			if (Worker->ObjectPIDFile) free(Worker->ObjectPIDFile);
-			if (Worker->ObjectWorkingDirectory) free(Worker->ObjectWorkingDirectory);
-			if (Worker->ObjectStdout) free(Worker->ObjectStdout);
-			if (Worker->ObjectStderr) free(Worker->ObjectStderr);
-			
-			ObjRL_ShutdownRunlevels(Worker);
-			EnvVarList_Shutdown(&Worker->EnvVars);
-		}
+		if (Worker->Next) ObjTable_Shutdown(Worker);
 		
 		Temp = Worker->Next;
 		free(Worker);
 	}
 	
 	RLInheritance_Shutdown();
+	ObjIndex_Shutdown();
+	ObjSchedule_Invalidate();
 	ObjectTable = NULL;
+	NumConfigFiles = 1;
+	
+	free(LoadedStamp.Data); /*Whatever we load next has its own.*/
+	memset(&LoadedStamp, 0, sizeof LoadedStamp);
 	
 	/*Release all config file names.*/
 	for (; Inc < MAX_CONFIG_FILES && ConfigFileList[Inc] != NULL; ++Inc)
@@ -3303,127 +3791,383 @@ void ShutdownConfig(void)
 	}
 }
 
-ReturnCode ReloadConfig(void)
-{ /*This function is somewhat hard to read, but it does the job well.*/
-	ObjTable *Worker = ObjectTable;
-	ObjTable *TRoot = malloc(sizeof(ObjTable)), *SWorker = TRoot, *Temp = NULL;
-	struct _RLTree *RLTemp1 = NULL, *RLTemp2 = NULL;
-	Bool GlobalOpts[3], ConfigOK = true;
-	struct _RunlevelInheritance *RLIRoot = NULL, *RLIWorker[2] = { NULL };
-	char RunlevelBackup[MAX_DESCRIPT_SIZE];
-	void *TempPtr = NULL, *TempPtr2 = NULL;
-	struct _EnvVarList *GlobalEnvWorker, *GlobalEnvRoot = NULL;
-	char *BackupConfigFileList[MAX_CONFIG_FILES] = { ConfigFile };
-	int Inc = 1;
+static void ObjTable_Shutdown(ObjTable *Worker)
+{ /*Releases everything an object owns, but not the node itself. All its strings and lists are in the arena.*/
+	CloseObjectPIDFD(Worker);
 	
-	WriteLogLine("CONFIG: Reloading configuration.\n", true);
-	WriteLogLine("CONFIG: Backing up current configuration.", true);
+	ConfigArena_Release(Worker->Arena);
 	
-	/*Backup the current runlevel.*/
-	snprintf(RunlevelBackup, MAX_DESCRIPT_SIZE, "%s", CurRunlevel);
+	Worker->Arena = NULL;
+	Worker->ObjectRunlevels = NULL;
+	Worker->EnvVars = NULL;
+}
+
+static char **ObjTable_SplitCommand(struct _ConfigArena *Arena, const char *Command)
+{ /*Splits a command on whitespace, for running without a shell. NULL if the shell has to make sense of it.*/
+	const char *Worker = Command;
+	char **RetVal = NULL;
+	unsigned NumWords = 0, Inc = 0;
+	size_t Length;
 	
-	/*Backup the config file names.*/
-	for (; Inc < MAX_CONFIG_FILES; ++Inc)
+	if (!Command) return NULL;
+	
+	while (*Worker == ' ' || *Worker == '\t') ++Worker;
+	
+	if (*Worker == '\0') return NULL;
+	
+#ifndef NOSHELL
+	/*Pipes, redirections, globs, variables, quoting, and so on.*/
+	if (strpbrk(Worker, "&^$#@!()*%{}`~+|\\<>?;:'[]\"\n") != NULL) return NULL;
+	
+	/*A leading VAR=value is an assignment, not something to exec.*/
+	for (Length = 0; Worker[Length] != ' ' && Worker[Length] != '\t' && Worker[Length] != '\0'; ++Length)
 	{
-		BackupConfigFileList[Inc] = ConfigFileList[Inc];
-		ConfigFileList[Inc] = NULL;
+		if (Worker[Length] == '=') return NULL;
 	}
+#endif
+	
+	for (Command = Worker; Worker; Worker = WhitespaceArg(Worker)) ++NumWords;
 	
-	/*Backup the global environment variables.*/
-	if (GlobalEnvVars)
+	RetVal = ConfigArena_Alloc(Arena, (NumWords + 1) * sizeof(char*));
+	
+	for (Worker = Command; Inc < NumWords; ++Inc, Worker = WhitespaceArg(Worker))
 	{
-		for (GlobalEnvWorker = GlobalEnvVars; GlobalEnvWorker->Next; GlobalEnvWorker = GlobalEnvWorker->Next)
+		for (Length = 0; Worker[Length] != ' ' && Worker[Length] != '\t' && Worker[Length] != '\0'; ++Length);
+		
+		RetVal[Inc] = ConfigArena_Alloc(Arena, Length + 1);
+		memcpy(RetVal[Inc], Worker, Length);
+		RetVal[Inc][Length] = '\0';
+	}
+	
+	RetVal[NumWords] = NULL; /*As execvp() requires.*/
+	
+	return RetVal;
+}
+
+static void ObjTable_PrepareLaunch(ObjTable *Worker)
+{ /*ForceShell is left to ExecuteConfigObject(), since only it knows if there is a shell to force.*/
+	Worker->StartArgV = ObjTable_SplitCommand(Worker->Arena, Worker->ObjectStartCommand);
+	Worker->PrestartArgV = ObjTable_SplitCommand(Worker->Arena, Worker->ObjectPrestartCommand);
+	Worker->StopArgV = ObjTable_SplitCommand(Worker->Arena, Worker->ObjectStopCommand);
+	Worker->ReloadArgV = ObjTable_SplitCommand(Worker->Arena, Worker->ObjectReloadCommand);
+	
+	Worker->Credentials = NULL;
+	
+	/*If this fails, ExecuteConfigObject() tries again, in case whatever NSS needs isn't up yet.*/
+	if (Worker->UserID != 0) ObjTable_LoadCredentials(Worker);
+	else ObjTable_BuildEnvOverlay(Worker);
+}
+
+Bool ObjTable_LoadCredentials(ObjTable *Worker)
+{ /*Looks up ObjectUser for the object's launches. getpwuid_r() is more trouble than it's worth in single-threaded Epoch.*/
+	const struct passwd *UserStruct = getpwuid(Worker->UserID);
+	struct _ObjCredentials *Creds = NULL;
+	gid_t GroupBuf[64], *Groups = GroupBuf;
+	int NumGroups = sizeof GroupBuf / sizeof *GroupBuf;
+	unsigned GroupID = 0;
+	
+	if (!UserStruct)
+	{ /*Don't keep launching as a user that isn't there anymore.*/
+		if (Worker->Credentials)
 		{
-			EnvVarList_Add(GlobalEnvWorker->EnvVar, &GlobalEnvRoot);
+			Worker->Credentials = NULL;
+			ObjTable_BuildEnvOverlay(Worker);
 		}
-		GlobalEnvVars = NULL;
+		
+		return false;
 	}
 	
-	for (; Worker->Next != NULL; Worker = Worker->Next, SWorker = SWorker->Next)
+	GroupID = Worker->GroupID ? Worker->GroupID : UserStruct->pw_gid;
+	
+	/*What initgroups() would do.*/
+	if (getgrouplist(UserStruct->pw_name, UserStruct->pw_gid, Groups, &NumGroups) == -1)
 	{
-		*SWorker = *Worker; /*Direct as-a-unit copy of the main list node to the backup list node.*/
-		SWorker->Prev = TempPtr;
-		SWorker->Next = malloc(sizeof(ObjTable));
-		SWorker->Next->Next = NULL;
-		TempPtr = SWorker;
-		
-		/*Backup the dynamically allocated strings.*/
-		SWorker->ObjectID = Worker->ObjectID;
-		Worker->ObjectID = NULL;
-		
-		SWorker->ObjectDescription = Worker->ObjectDescription;
-		Worker->ObjectDescription = NULL;
-		
-		SWorker->ObjectStartCommand = Worker->ObjectStartCommand;
-		Worker->ObjectStartCommand = NULL;
-		
-		SWorker->ObjectStopCommand = Worker->ObjectStopCommand;
-		Worker->ObjectStopCommand = NULL;
-		
-		SWorker->ObjectPrestartCommand = Worker->ObjectPrestartCommand;
-		Worker->ObjectPrestartCommand = NULL;
-		
-		SWorker->ObjectReloadCommand = Worker->ObjectReloadCommand;
-		Worker->ObjectReloadCommand = NULL;
-		
-		SWorker->ObjectPIDFile = Worker->ObjectPIDFile;
-		Worker->ObjectPIDFile = NULL;
-		
-		SWorker->ObjectWorkingDirectory = Worker->ObjectWorkingDirectory;
-		Worker->ObjectWorkingDirectory = NULL;
-		
-		SWorker->ObjectStdout = Worker->ObjectStdout;
-		Worker->ObjectStdout = NULL;
-		
-		SWorker->ObjectStderr = Worker->ObjectStderr;
-		Worker->ObjectStderr = NULL;
+		Groups = malloc(NumGroups * sizeof(gid_t));
+		getgrouplist(UserStruct->pw_name, UserStruct->pw_gid, Groups, &NumGroups);
+	}
+	endgrent();
+	
+	if (ObjTable_CredentialsCurrent(Worker->Credentials, UserStruct, GroupID, Groups, NumGroups))
+	{ /*A reload looks again every time, so don't fill the arena with copies of what we have.*/
+		if (Groups != GroupBuf) free(Groups);
+		return true;
+	}
 	
-		SWorker->EnvVars = Worker->EnvVars;
-		Worker->EnvVars = NULL;
+	Creds = ConfigArena_Alloc(Worker->Arena, sizeof(struct _ObjCredentials));
+	
+	Creds->EnvStrings[0] = ConfigArena_Alloc(Worker->Arena, strlen(UserStruct->pw_dir) + sizeof "HOME=");
+	Creds->EnvStrings[1] = ConfigArena_Alloc(Worker->Arena, strlen(UserStruct->pw_name) + sizeof "USER=");
+	Creds->EnvStrings[2] = ConfigArena_Alloc(Worker->Arena, strlen(UserStruct->pw_shell) + sizeof "SHELL=");
+	sprintf(Creds->EnvStrings[0], "HOME=%s", UserStruct->pw_dir);
+	sprintf(Creds->EnvStrings[1], "USER=%s", UserStruct->pw_name);
+	sprintf(Creds->EnvStrings[2], "SHELL=%s", UserStruct->pw_shell);
+	Creds->HomeDirectory = Creds->EnvStrings[0] + sizeof "HOME=" - 1;
+	
+	Creds->GroupID = GroupID;
+	Creds->Groups = ConfigArena_Alloc(Worker->Arena, NumGroups * sizeof(gid_t));
+	Creds->NumGroups = NumGroups;
+	memcpy(Creds->Groups, Groups, NumGroups * sizeof(gid_t));
+	
+	if (Groups != GroupBuf) free(Groups);
+	
+	Worker->Credentials = Creds;
+	ObjTable_BuildEnvOverlay(Worker);
+	
+	return true;
+}
+
+static void ObjTable_BuildEnvOverlay(ObjTable *Worker)
+{ /*The launcher applies these in order, like the putenv()s it used to do.*/
+	const struct _EnvVarList *EnvWorker = Worker->EnvVars;
+	unsigned NumVars = 0, Inc = 0;
+	
+	for (; EnvWorker && EnvWorker->Next; EnvWorker = EnvWorker->Next) ++NumVars;
+	
+	if (Worker->Credentials) NumVars += 3;
+	
+	if (!NumVars)
+	{
+		Worker->EnvOverlay = NULL;
+		return;
+	}
+	
+	Worker->EnvOverlay = ConfigArena_Alloc(Worker->Arena, (NumVars + 1) * sizeof(char*));
+	
+	for (EnvWorker = Worker->EnvVars; EnvWorker && EnvWorker->Next; EnvWorker = EnvWorker->Next)
+	{
+		Worker->EnvOverlay[Inc++] = (char*)EnvWorker->EnvVar;
+	}
+	
+	if (Worker->Credentials)
+	{
+		Worker->EnvOverlay[Inc++] = Worker->Credentials->EnvStrings[0];
+		Worker->EnvOverlay[Inc++] = Worker->Credentials->EnvStrings[1];
+		Worker->EnvOverlay[Inc++] = Worker->Credentials->EnvStrings[2];
+	}
+	
+	Worker->EnvOverlay[Inc] = NULL;
+}
+
+static Bool ObjTable_SameCredentials(const struct _ObjCredentials *Old, const struct _ObjCredentials *New)
+{ /*So a reload picks up changes to the passwd or group files, even if the config didn't change.*/
+	int Inc = 0;
+	
+	if (!Old || !New) return Old == New;
+	
+	if (Old->GroupID != New->GroupID || Old->NumGroups != New->NumGroups ||
+		memcmp(Old->Groups, New->Groups, Old->NumGroups * sizeof(gid_t)) != 0)
+	{
+		return false;
+	}
+	
+	for (; Inc < 3; ++Inc)
+	{
+		if (strcmp(Old->EnvStrings[Inc], New->EnvStrings[Inc]) != 0) return false;
+	}
+	
+	return true;
+}
+
+static Bool ObjTable_CredentialsCurrent(const struct _ObjCredentials *Creds, const struct passwd *UserStruct,
+										unsigned GroupID, const gid_t *Groups, int NumGroups)
+{ /*ObjTable_SameCredentials(), against a fresh lookup instead of a second copy.*/
+	if (!Creds) return false;
+	
+	return Creds->GroupID == GroupID && Creds->NumGroups == NumGroups &&
+			!memcmp(Creds->Groups, Groups, NumGroups * sizeof(gid_t)) &&
+			!strcmp(Creds->EnvStrings[0] + sizeof "HOME=" - 1, UserStruct->pw_dir) &&
+			!strcmp(Creds->EnvStrings[1] + sizeof "USER=" - 1, UserStruct->pw_name) &&
+			!strcmp(Creds->EnvStrings[2] + sizeof "SHELL=" - 1, UserStruct->pw_shell);
+}
+
+static struct _ConfigArena *ConfigArena_New(void)
+{
+	struct _ConfigArena *RetVal = malloc(sizeof(struct _ConfigArena));
+	
+	RetVal->Chunks = NULL;
+	RetVal->Users = 0;
+	
+	return RetVal;
+}
+
+static void *ConfigArena_Alloc(struct _ConfigArena *Arena, size_t Size)
+{
+	struct _ConfigArenaChunk *Chunk = Arena->Chunks;
+	void *RetVal = NULL;
+	
+	Size = (Size + sizeof(void*) - 1) & ~(sizeof(void*) - 1); /*Keep the next one aligned for list nodes.*/
+	
+	if (!Chunk || Chunk->Size - Chunk->Used < Size)
+	{ /*Something bigger than a chunk gets one of its own, behind the current one so we keep filling that.*/
+		const size_t ChunkSize = Size > CONFIG_ARENA_CHUNK_SIZE ? Size : CONFIG_ARENA_CHUNK_SIZE;
+		
+		Chunk = malloc(sizeof(struct _ConfigArenaChunk) + ChunkSize);
+		Chunk->Used = 0;
+		Chunk->Size = ChunkSize;
 		
-		if (!Worker->ObjectRunlevels)
+		if (Size == ChunkSize && Arena->Chunks)
 		{
-			continue;
+			Chunk->Next = Arena->Chunks->Next;
+			Arena->Chunks->Next = Chunk;
 		}
-		
-		RLTemp2 = SWorker->ObjectRunlevels = malloc(sizeof(struct _RLTree));
-		
-		TempPtr2 = NULL;
-		for (RLTemp1 = Worker->ObjectRunlevels; RLTemp1->Next; RLTemp1 = RLTemp1->Next)
+		else
 		{
-			*RLTemp2 = *RLTemp1;
-			RLTemp2->Prev = TempPtr2;
-			RLTemp2->Next = malloc(sizeof(struct _RLTree));
-			RLTemp2->Next->Next = NULL;
-			TempPtr2 = RLTemp2;
-			
-			RLTemp2 = RLTemp2->Next;
+			Chunk->Next = Arena->Chunks;
+			Arena->Chunks = Chunk;
 		}
 	}
+	
+	RetVal = Chunk->Data + Chunk->Used;
+	Chunk->Used += Size;
+	
+	return RetVal;
+}
+
+static char *ConfigArena_StrDup(struct _ConfigArena *Arena, const char *String)
+{
+	char *RetVal = NULL;
+	size_t Length;
+	
+	if (!String) return NULL;
+	
+	Length = strlen(String) + 1;
+	RetVal = ConfigArena_Alloc(Arena, Length);
+	memcpy(RetVal, String, Length);
+	
+	return RetVal;
+}
+
+static void ConfigArena_Release(struct _ConfigArena *Arena)
+{ /*Drops an object's hold on its arena, and frees the arena if it was the last one.*/
+	struct _ConfigArenaChunk *Chunk = NULL, *Next = NULL;
+	
+	if (!Arena || --Arena->Users) return;
+	
+	for (Chunk = Arena->Chunks; Chunk; Chunk = Next)
+	{
+		Next = Chunk->Next;
+		free(Chunk);
+	}
+	
+	if (CurArena == Arena) CurArena = NULL;
+	
+	free(Arena);
+}
 
-	/*Back up the runlevel inheritance table.*/
-	if (RunlevelInheritance != NULL)
+static Bool ObjTable_SameString(const char *First, const char *Second)
+{
+	if (!First || !Second) return First == Second;
+	
+	return !strcmp(First, Second);
+}
+
+static Bool ObjTable_SameConfig(const ObjTable *Old, const ObjTable *New)
+{ /*Whether the config says the same thing about both. Runtime state doesn't count.*/
+	const struct _EnvVarList *EnvWorker[2] = { Old->EnvVars, New->EnvVars };
+	const struct _RLTree *RLWorker[2] = { Old->ObjectRunlevels, New->ObjectRunlevels };
+	
+	if (Old->ObjectStartPriority != New->ObjectStartPriority || Old->ObjectStopPriority != New->ObjectStopPriority ||
+		Old->UserID != New->UserID || Old->GroupID != New->GroupID || Old->Enabled != New->Enabled ||
+		Old->TermSignal != New->TermSignal || Old->ReloadCommandSignal != New->ReloadCommandSignal ||
+		memcmp(Old->ExitStatuses, New->ExitStatuses, sizeof Old->ExitStatuses) != 0 ||
+		memcmp(&Old->Opts, &New->Opts, sizeof Old->Opts) != 0)
+	{
+		return false;
+	}
+	
+	if (!ObjTable_SameString(Old->ConfigFile, New->ConfigFile) ||
+		!ObjTable_SameString(Old->ObjectDescription, New->ObjectDescription) ||
+		!ObjTable_SameString(Old->ObjectStartCommand, New->ObjectStartCommand) ||
+		!ObjTable_SameString(Old->ObjectPrestartCommand, New->ObjectPrestartCommand) ||
+		!ObjTable_SameString(Old->ObjectStopCommand, New->ObjectStopCommand) ||
+		!ObjTable_SameString(Old->ObjectReloadCommand, New->ObjectReloadCommand) ||
+		!ObjTable_SameString(Old->ObjectPIDFile, New->ObjectPIDFile) ||
+		!ObjTable_SameString(Old->ObjectWorkingDirectory, New->ObjectWorkingDirectory) ||
+		!ObjTable_SameString(Old->ObjectStdout, New->ObjectStdout) ||
+		!ObjTable_SameString(Old->ObjectStderr, New->ObjectStderr) ||
+		!ObjTable_SameString(Old->ObjectRequires, New->ObjectRequires) ||
+		!ObjTable_SameString(Old->ObjectAfter, New->ObjectAfter) ||
+		!ObjTable_SameCredentials(Old->Credentials, New->Credentials))
+	{
+		return false;
+	}
+	
+	/*Both lists end in an empty node, or are NULL if nothing was ever added.*/
+	for (; EnvWorker[0] && EnvWorker[0]->Next && EnvWorker[1] && EnvWorker[1]->Next;
+		EnvWorker[0] = EnvWorker[0]->Next, EnvWorker[1] = EnvWorker[1]->Next)
+	{
+		if (strcmp(EnvWorker[0]->EnvVar, EnvWorker[1]->EnvVar) != 0) return false;
+	}
+	
+	if ((EnvWorker[0] && EnvWorker[0]->Next) || (EnvWorker[1] && EnvWorker[1]->Next)) return false;
+	
+	for (; RLWorker[0] && RLWorker[0]->Next && RLWorker[1] && RLWorker[1]->Next;
+		RLWorker[0] = RLWorker[0]->Next, RLWorker[1] = RLWorker[1]->Next)
 	{
-		RLIRoot = RLIWorker[1] = malloc(sizeof(struct _RunlevelInheritance));
-		memset(RLIWorker[1], 0, sizeof(struct _RunlevelInheritance));
-		TempPtr = NULL;
+		if (strcmp(RLWorker[0]->RL, RLWorker[1]->RL) != 0) return false;
+	}
+	
+	return !((RLWorker[0] && RLWorker[0]->Next) || (RLWorker[1] && RLWorker[1]->Next));
+}
+
+ReturnCode ReloadConfig(void)
+{ /*Parses the config into a new table, then patches the live one from it by ObjectID,
+	* so objects that are still there keep their nodes, PIDs and pidfds.*/
+	ObjTable *OldTable = ObjectTable, *Worker = NULL, *OldNext = NULL, *New = NULL, *Spares = NULL;
+	struct _RunlevelInheritance *OldRLI = RunlevelInheritance, *RLIWorker = NULL;
+	struct _EnvVarList *OldGlobalEnvVars = GlobalEnvVars;
+	char *OldConfigFileList[MAX_CONFIG_FILES] = { ConfigFile };
+	const int OldNumConfigFiles = NumConfigFiles;
+	char RunlevelBackup[MAX_DESCRIPT_SIZE], CGroupHierarchyBackup[MAX_LINE_SIZE];
+	const unsigned BootWorkersBackup = BootWorkers, ConfigAutoReloadBackup = ConfigAutoReload;
+	Bool GlobalOpts[2];
+	unsigned Kept = 0, Changed = 0, Added = 0, Removed = 0;
+	char LogBuf[MAX_LINE_SIZE];
+	int Inc = 1;
+	
+	WriteLogLine("CONFIG: Reloading configuration.\n", true);
+	
+	LoopTimerStale = true; /*Objects may come, go or change options, so PrimaryLoop() rethinks its timer.*/
+	
+	if (LoadedStamp.Size && !ConfigCache.Dirty)
+	{ /*If none of the files it came from have changed, the config can't have either.*/
+		struct _ConfigCacheBuf Now = { NULL };
+		Bool Unchanged;
 		
-		for (RLIWorker[0] = RunlevelInheritance; RLIWorker[0]->Next; RLIWorker[0] = RLIWorker[0]->Next)
+		ConfigCache_Stamp(&Now);
+		Unchanged = Now.Size == LoadedStamp.Size && !memcmp(Now.Data, LoadedStamp.Data, Now.Size);
+		free(Now.Data);
+		
+		if (Unchanged)
 		{
-			*RLIWorker[1] = *RLIWorker[0];
-			RLIWorker[1]->Prev = TempPtr;
-			TempPtr = RLIWorker[1];
-			RLIWorker[1]->Next = malloc(sizeof(struct _RunlevelInheritance));
-			memset(RLIWorker[1]->Next, 0, sizeof(struct _RunlevelInheritance));
+			for (Worker = ObjectTable; Worker && Worker->Next; Worker = Worker->Next)
+			{ /*Users and groups needn't come from files the stamp can see, so look them up again anyway.*/
+				if (Worker->UserID != 0) ObjTable_LoadCredentials(Worker);
+			}
 			
-			RLIWorker[1] = RLIWorker[1]->Next;
+			WriteLogLine("CONFIG: No config file has changed since it was loaded. Nothing to reload.", true);
+			puts(CONSOLE_COLOR_GREEN "Epoch: Configuration unchanged." CONSOLE_ENDCOLOR);
+			FinaliseLogStartup(false);
+			return SUCCESS;
 		}
 	}
 	
-	WriteLogLine("CONFIG: Shutting down configuration.", true);
+	/*Set the current configuration aside. InitConfig() builds the new one from scratch.*/
+	snprintf(RunlevelBackup, MAX_DESCRIPT_SIZE, "%s", CurRunlevel);
+	snprintf(CGroupHierarchyBackup, sizeof CGroupHierarchyBackup, "%s", CGroupHierarchy);
 	
-	/*Actually do the reload of the config.*/
-	ShutdownConfig();
+	for (; Inc < MAX_CONFIG_FILES; ++Inc)
+	{
+		OldConfigFileList[Inc] = ConfigFileList[Inc];
+		ConfigFileList[Inc] = NULL;
+	}
+	NumConfigFiles = 1;
+	
+	ObjectTable = NULL;
+	RunlevelInheritance = NULL;
+	GlobalEnvVars = NULL;
+	ObjIndex_Shutdown();
+	ObjSchedule_Invalidate();
 	
 	/*Do this to prevent some weird options from being changeable by a config reload.*/
 	GlobalOpts[0] = EnableLogging;
@@ -3434,85 +4178,722 @@ ReturnCode ReloadConfig(void)
 	if (!InitConfig(ConfigFile))
 	{
 		WriteLogLine("CONFIG: " CONSOLE_COLOR_RED "FAILED TO RELOAD CONFIGURATION." CONSOLE_ENDCOLOR 
-					" Restoring previous configuration from backup.", true);
+					" Restoring previous configuration.", true);
 		SpitError("ReloadConfig(): Failed to reload configuration.\n"
 					"Restoring old configuration to memory.\n"
 					"Please check Epoch's configuration file for syntax errors.");
 		
 		ShutdownConfig();
 		
-		GlobalEnvVars = GlobalEnvRoot;
-		ObjectTable = TRoot; /*Point ObjectTable to our new, identical copy of the old tree.*/
-		RunlevelInheritance = RLIRoot; /*Restore runlevel inheritance.*/
+		ObjectTable = OldTable;
+		ObjIndex_Rebuild();
+		RunlevelInheritance = OldRLI;
+		GlobalEnvVars = OldGlobalEnvVars;
 		
-		/*Restore config file names.*/
 		for (Inc = 1; Inc < MAX_CONFIG_FILES; ++Inc)
 		{
-			ConfigFileList[Inc] = BackupConfigFileList[Inc];
+			ConfigFileList[Inc] = OldConfigFileList[Inc];
 		}
+		NumConfigFiles = OldNumConfigFiles;
 		
-		/*Restore current runlevel*/
 		snprintf(CurRunlevel, MAX_DESCRIPT_SIZE, "%s", RunlevelBackup);
+		snprintf(CGroupHierarchy, sizeof CGroupHierarchy, "%s", CGroupHierarchyBackup);
+		BootWorkers = BootWorkersBackup; /*InitConfig() resets these before it parses anything.*/
+		ConfigAutoReload = ConfigAutoReloadBackup;
 		
-		ConfigOK = false;
+		EnableLogging = GlobalOpts[0];
+		DisableCAD = GlobalOpts[1];
 		
 		FinaliseLogStartup(false); /*Write any logs to disk.*/
+		
+		return FAILURE;
 	}
 	
-	/*And then restore those options to their previous states.*/
 	EnableLogging = GlobalOpts[0];
 	DisableCAD = GlobalOpts[1];
 	
-	if (!ConfigOK) return ConfigOK;
+	WriteLogLine("CONFIG: Patching the object table.", true);
+	
+	/*Objects in both configs get their old node put in place of the new one, so anything holding
+	 * a pointer to them stays good. The new nodes pile up in Spares until we're done looking them up.*/
+	for (Worker = OldTable; Worker && Worker->Next; Worker = OldNext)
+	{
+		ObjTable Temp;
+		
+		OldNext = Worker->Next;
+		
+		if (!(New = ObjIndex_Lookup(Worker->ObjectID)))
+		{ /*Gone from the config.*/
+			ObjTable_Shutdown(Worker);
+			free(Worker);
+			++Removed;
+			continue;
+		}
+		
+		if (ObjTable_SameConfig(Worker, New)) ++Kept;
+		else ++Changed;
+		
+		/*Take the new config even when it says the same thing, so nothing keeps the old generation's arena alive.
+		 * Keep the runtime state, and leave the old config to be freed with New.*/
+		Temp = *Worker;
+		
+		*Worker = *New;
+		Worker->Started = Temp.Started;
+		Worker->ObjectPID = Temp.ObjectPID;
+		Worker->StartedSince = Temp.StartedSince;
+		Worker->PIDFD = Temp.PIDFD;
+		Worker->PIDFDTarget = Temp.PIDFDTarget;
+		
+		*New = Temp;
+		New->PIDFD = -1; /*Worker still owns it.*/
+		
+		if (Worker->Prev) Worker->Prev->Next = Worker;
+		else ObjectTable = Worker;
+		
+		Worker->Next->Prev = Worker;
+		
+		New->Next = Spares;
+		Spares = New;
+	}
+	
+	if (Worker) free(Worker); /*The empty node at the end.*/
+	
+	for (; Spares != NULL; Spares = New)
+	{
+		New = Spares->Next;
+		ObjTable_Shutdown(Spares);
+		free(Spares);
+	}
+	
+	ObjIndex_Rebuild();
+	ObjSchedule_Invalidate();
 	
-	WriteLogLine("CONFIG: Restoring object statuses and deleting backup configuration.", true);
+	Added = ObjectIndex.Count - Kept - Changed;
 	
-	for (SWorker = TRoot; SWorker != NULL; SWorker = Temp)
-	{ /*Add back the Started states, so we don't forget to stop services, etc.*/
+	/*Release the rest of the old configuration.*/
+	for (; OldRLI != NULL; OldRLI = RLIWorker)
+	{
+		RLIWorker = OldRLI->Next;
+		free(OldRLI);
+	}
+	
+	EnvVarList_Shutdown(&OldGlobalEnvVars);
+	
+	for (Inc = 1; Inc < MAX_CONFIG_FILES && OldConfigFileList[Inc] != NULL; ++Inc)
+	{
+		free(OldConfigFileList[Inc]);
+	}
+	
+	snprintf(LogBuf, sizeof LogBuf, "CONFIG: %u objects unchanged, %u changed, %u added, %u removed.",
+			Kept, Changed, Added, Removed);
+	WriteLogLine(LogBuf, true);
+	
+	ConfigWatch_Reset(); /*The files, or whether we watch them at all, may be different now.*/
+	
+	WriteLogLine("CONFIG: " CONSOLE_COLOR_GREEN "Configuration reload successful." CONSOLE_ENDCOLOR, true);
+	puts(CONSOLE_COLOR_GREEN "Epoch: Configuration reloaded." CONSOLE_ENDCOLOR);
+	
+	FinaliseLogStartup(false); /*Clean up logs in memory.*/
+	
+	return SUCCESS;
+}
+
+/*ConfigAutoReload support.*/
+void ConfigWatch_Reset(void)
+{ /*Watch the config files as they are now, or stop watching if ConfigAutoReload is off
+	* or PrimaryLoop() has no epoll set for us.*/
+	struct epoll_event Event;
+	char Directory[MAX_LINE_SIZE];
+	int Inc = 0;
+	
+	if (ConfigWatch.Descriptor != -1)
+	{ /*Closing it takes it out of the epoll set too.*/
+		close(ConfigWatch.Descriptor);
+		ConfigWatch.Descriptor = -1;
+	}
+	
+	ConfigWatch.Pending = false;
+	
+	if (!ConfigAutoReload || ObjectWatchDescriptor == -1) return;
+	
+	if ((ConfigWatch.Descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+	{
+		WriteLogLine(CONSOLE_COLOR_YELLOW "WARNING: " CONSOLE_ENDCOLOR
+					"Unable to set up inotify. ConfigAutoReload will not work.", true);
+		return;
+	}
+	
+	for (; Inc < NumConfigFiles; ++Inc)
+	{
+		const char *Slash = strrchr(ConfigFileList[Inc], '/');
+		
+		if (Slash) snprintf(Directory, sizeof Directory, "%.*s", (int)(Slash - ConfigFileList[Inc]) + 1, ConfigFileList[Inc]);
+		else snprintf(Directory, sizeof Directory, ".");
 		
-		if (SWorker->Next)
+		/*The same directory twice gets us the same watch, which is what we want.*/
+		ConfigWatch.WatchOf[Inc] = inotify_add_watch(ConfigWatch.Descriptor, Directory,
+													IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+	}
+	
+	memset(&Event, 0, sizeof Event);
+	Event.events = EPOLLIN;
+	Event.data.fd = ConfigWatch.Descriptor;
+	epoll_ctl(ObjectWatchDescriptor, EPOLL_CTL_ADD, ConfigWatch.Descriptor, &Event);
+}
+
+Bool ConfigWatch_Owns(int Descriptor)
+{
+	return Descriptor != -1 && Descriptor == ConfigWatch.Descriptor;
+}
+
+void ConfigWatch_Service(void)
+{ /*Drain the inotify descriptor. A change to any of our config files starts the debounce over.*/
+	uint64_t Buffer[512]; /*Aligned for struct inotify_event.*/
+	ssize_t Length = 0;
+	Bool Changed = false;
+	
+	while ((Length = read(ConfigWatch.Descriptor, Buffer, sizeof Buffer)) > 0)
+	{
+		const char *Worker = (const char*)Buffer;
+		
+		while (Worker < (const char*)Buffer + Length)
 		{
-			if ((Worker = LookupObjectInTable(SWorker->ObjectID)))
+			const struct inotify_event *Event = (const struct inotify_event*)Worker;
+			int Inc = 0;
+			
+			if (Event->mask & IN_Q_OVERFLOW) Changed = true; /*We lost some, so assume the worst.*/
+			
+			for (; Event->len && Inc < NumConfigFiles; ++Inc)
 			{
-				Worker->Started = SWorker->Started;
-				Worker->ObjectPID = SWorker->ObjectPID;
-				Worker->StartedSince = SWorker->StartedSince;
+				const char *Slash = strrchr(ConfigFileList[Inc], '/');
+				
+				if (ConfigWatch.WatchOf[Inc] == Event->wd &&
+					!strcmp(Event->name, Slash ? Slash + 1 : ConfigFileList[Inc]))
+				{
+					Changed = true;
+					break;
+				}
 			}
 			
-			ObjRL_ShutdownRunlevels(SWorker);
+			Worker += sizeof(struct inotify_event) + Event->len;
+		}
+	}
+	
+	if (!Changed) return;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ConfigWatch.Deadline);
+	ConfigWatch.Deadline.tv_sec += ConfigAutoReload / 1000;
+	ConfigWatch.Deadline.tv_nsec += (ConfigAutoReload % 1000) * 1000000;
+	
+	if (ConfigWatch.Deadline.tv_nsec >= 1000000000)
+	{
+		++ConfigWatch.Deadline.tv_sec;
+		ConfigWatch.Deadline.tv_nsec -= 1000000000;
+	}
+	
+	ConfigWatch.Pending = true;
+}
+
+void ConfigWatch_Check(void)
+{ /*Called every pass of PrimaryLoop(). Reloads once the edits have stopped for long enough.*/
+	struct timespec Now;
+	
+	if (!ConfigWatch.Pending) return;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	
+	if (Now.tv_sec < ConfigWatch.Deadline.tv_sec ||
+		(Now.tv_sec == ConfigWatch.Deadline.tv_sec && Now.tv_nsec < ConfigWatch.Deadline.tv_nsec))
+	{
+		return;
+	}
+	
+	ConfigWatch.Pending = false;
+	
+	WriteLogLine("CONFIG: Config file changed on disk. Reloading automatically.", true);
+	
+	/*A config that fails to load leaves the old one in place, and ReloadConfig() logs why.*/
+	ReloadConfig();
+}
+
+int ConfigWatch_Timeout(void)
+{ /*Milliseconds until ConfigWatch_Check() wants to reload, or -1 if it doesn't. PrimaryLoop() sleeps no longer than this.*/
+	struct timespec Now;
+	long Remaining;
+	
+	if (!ConfigWatch.Pending) return -1;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	
+	Remaining = (ConfigWatch.Deadline.tv_sec - Now.tv_sec) * 1000 + (ConfigWatch.Deadline.tv_nsec - Now.tv_nsec + 999999) / 1000000;
+	
+	return Remaining > 0 ? Remaining : 0;
+}
+
+/*The compiled config cache.*/
+static void ConfigCache_Depend(const char *Path)
+{ /*Note a file the config read besides config files, so the cache goes stale when it changes.*/
+	unsigned Inc = 0;
+	
+	for (; Inc < ConfigCache.NumDepends; ++Inc)
+	{
+		if (!strcmp(ConfigCache.Depends[Inc], Path)) return;
+	}
+	
+	if (ConfigCache.NumDepends == CONFIG_CACHE_MAX_DEPENDS)
+	{ /*We couldn't tell when it's stale.*/
+		ConfigCache.Dirty = true;
+		return;
+	}
+	
+	ConfigCache.Depends[ConfigCache.NumDepends] = malloc(strlen(Path) + 1);
+	strcpy(ConfigCache.Depends[ConfigCache.NumDepends++], Path);
+}
+
+static void ConfigCache_Reset(void)
+{
+	unsigned Inc = 0;
+	
+	for (; Inc < ConfigCache.NumDepends; ++Inc) free(ConfigCache.Depends[Inc]);
+	
+	memset(&ConfigCache, 0, sizeof ConfigCache);
+}
+
+static void ConfigCache_Put(struct _ConfigCacheBuf *Buf, const void *Data, unsigned Size)
+{
+	if (Buf->Size + Size > Buf->Alloc)
+	{
+		while (Buf->Size + Size > Buf->Alloc) Buf->Alloc = Buf->Alloc ? Buf->Alloc * 2 : 65536;
+		Buf->Data = realloc(Buf->Data, Buf->Alloc);
+	}
+	
+	memcpy(Buf->Data + Buf->Size, Data, Size);
+	Buf->Size += Size;
+}
+
+static void ConfigCache_PutString(struct _ConfigCacheBuf *Buf, const char *String)
+{ /*Zero length means NULL. Otherwise the length counts the terminator.*/
+	unsigned Length = String ? strlen(String) + 1 : 0;
+	
+	ConfigCache_Put(Buf, &Length, sizeof Length);
+	if (Length) ConfigCache_Put(Buf, String, Length);
+}
+
+static void ConfigCache_PutFile(struct _ConfigCacheBuf *Buf, const char *Path)
+{ /*What we check the file against when we load the cache.*/
+	struct stat FileStat;
+	uint64_t Stamp[4] = { 0 };
+	
+	if (stat(Path, &FileStat) == 0)
+	{
+		Stamp[0] = FileStat.st_size;
+		Stamp[1] = FileStat.st_ino;
+		Stamp[2] = FileStat.st_mtim.tv_sec;
+		Stamp[3] = FileStat.st_mtim.tv_nsec;
+	}
+	
+	ConfigCache_PutString(Buf, Path);
+	ConfigCache_Put(Buf, Stamp, sizeof Stamp);
+}
+
+static Bool ConfigCache_Get(struct _ConfigCacheReader *Reader, void *Out, unsigned Size)
+{
+	if (Reader->Bad || (size_t)(Reader->End - Reader->Pos) < Size)
+	{
+		Reader->Bad = true;
+		memset(Out, 0, Size);
+		return false;
+	}
+	
+	memcpy(Out, Reader->Pos, Size);
+	Reader->Pos += Size;
+	return true;
+}
+
+static const char *ConfigCache_GetString(struct _ConfigCacheReader *Reader)
+{ /*Points into the cache itself. NULL if it was NULL or the cache is bad.*/
+	unsigned Length = 0;
+	const char *String = (const char*)Reader->Pos + sizeof Length;
+	
+	if (!ConfigCache_Get(Reader, &Length, sizeof Length) || !Length) return NULL;
+	
+	if ((size_t)(Reader->End - Reader->Pos) < Length || String[Length - 1] != '\0')
+	{
+		Reader->Bad = true;
+		return NULL;
+	}
+	
+	Reader->Pos += Length;
+	return String;
+}
+
+static Bool ConfigCache_CheckFile(struct _ConfigCacheReader *Reader, const char **PathOut)
+{ /*false if the file isn't what it was when we wrote the cache.*/
+	const char *Path = ConfigCache_GetString(Reader);
+	struct stat FileStat;
+	uint64_t Stamp[4];
+	
+	if (!ConfigCache_Get(Reader, Stamp, sizeof Stamp) || !Path || stat(Path, &FileStat) != 0)
+	{
+		return false;
+	}
+	
+	if (PathOut) *PathOut = Path;
+	
+	return Stamp[0] == (uint64_t)FileStat.st_size && Stamp[1] == (uint64_t)FileStat.st_ino &&
+			Stamp[2] == (uint64_t)FileStat.st_mtim.tv_sec && Stamp[3] == (uint64_t)FileStat.st_mtim.tv_nsec;
+}
+
+static void ConfigCache_Save(Bool TrueLogEnable)
+{ /*Writes out what InitConfig() just parsed, so next time we needn't.*/
+	struct _ConfigCacheBuf Buf = { NULL };
+	const unsigned Magic[2] = { CONFIG_CACHE_MAGIC, CONFIG_CACHE_VERSION };
+	char Path[MAX_LINE_SIZE + sizeof CONFIG_CACHE_SUFFIX], NewPath[sizeof Path + sizeof ".new"];
+	struct _RunlevelInheritance *RLIWorker = RunlevelInheritance;
+	struct _EnvVarList *EnvWorker = GlobalEnvVars;
+	ObjTable *Worker = ObjectTable;
+	unsigned Count = 0, Inc = 0;
+	FILE *Descriptor = NULL;
+	
+	snprintf(Path, sizeof Path, "%s" CONFIG_CACHE_SUFFIX, ConfigFile);
+	snprintf(NewPath, sizeof NewPath, "%s.new", Path);
+	
+	/*What built it. Nothing else reads this, so the layout of the structs we copy whole is fine.*/
+	ConfigCache_Put(&Buf, Magic, sizeof Magic);
+	ConfigCache_PutString(&Buf, VERSIONSTRING " " __DATE__ " " __TIME__);
+	Count = sizeof(ObjTable);
+	ConfigCache_Put(&Buf, &Count, sizeof Count);
+	
+	/*Every file the config came from.*/
+	ConfigCache_Put(&Buf, &NumConfigFiles, sizeof NumConfigFiles);
+	for (Inc = 0; Inc < NumConfigFiles; ++Inc) ConfigCache_PutFile(&Buf, ConfigFileList[Inc]);
+	
+	ConfigCache_Put(&Buf, &ConfigCache.NumDepends, sizeof ConfigCache.NumDepends);
+	for (Inc = 0; Inc < ConfigCache.NumDepends; ++Inc) ConfigCache_PutFile(&Buf, ConfigCache.Depends[Inc]);
+	
+	/*Global options.*/
+	ConfigCache_Put(&Buf, &ConfigCache.Seen, sizeof ConfigCache.Seen);
+	ConfigCache_Put(&Buf, &DisableCAD, sizeof DisableCAD);
+	ConfigCache_Put(&Buf, &BlankLogOnBoot, sizeof BlankLogOnBoot);
+	ConfigCache_Put(&Buf, &TrueLogEnable, sizeof TrueLogEnable);
+	ConfigCache_Put(&Buf, AutoMountOpts, sizeof AutoMountOpts);
+	ConfigCache_Put(&Buf, &BootBanner, sizeof BootBanner);
+	ConfigCache_Put(&Buf, &StatusReportFormat, sizeof StatusReportFormat);
+	ConfigCache_Put(&Buf, &BootWorkers, sizeof BootWorkers);
+	ConfigCache_Put(&Buf, &ConfigAutoReload, sizeof ConfigAutoReload);
+	ConfigCache_PutString(&Buf, CGroupHierarchy);
+	ConfigCache_PutString(&Buf, LogFile);
+	ConfigCache_PutString(&Buf, Hostname);
+	ConfigCache_PutString(&Buf, Domainname);
+	ConfigCache_PutString(&Buf, ConfigCache.DefaultRunlevel);
+	
+	for (Count = 0; RLIWorker && RLIWorker->Next; RLIWorker = RLIWorker->Next) ++Count;
+	ConfigCache_Put(&Buf, &Count, sizeof Count);
+	
+	for (RLIWorker = RunlevelInheritance; RLIWorker && RLIWorker->Next; RLIWorker = RLIWorker->Next)
+	{
+		ConfigCache_PutString(&Buf, RLIWorker->Inheriter);
+		ConfigCache_PutString(&Buf, RLIWorker->Inherited);
+	}
+	
+	for (Count = 0; EnvWorker && EnvWorker->Next; EnvWorker = EnvWorker->Next) ++Count;
+	ConfigCache_Put(&Buf, &Count, sizeof Count);
+	
+	for (EnvWorker = GlobalEnvVars; EnvWorker && EnvWorker->Next; EnvWorker = EnvWorker->Next)
+	{
+		ConfigCache_PutString(&Buf, EnvWorker->EnvVar);
+	}
+	
+	/*The objects, after ScanConfigIntegrity() is through with them.*/
+	for (Count = 0; Worker->Next; Worker = Worker->Next) ++Count;
+	ConfigCache_Put(&Buf, &Count, sizeof Count);
+	
+	for (Worker = ObjectTable; Worker->Next; Worker = Worker->Next)
+	{
+		const char *Strings[11] = { Worker->ObjectDescription == Worker->ObjectID ? NULL : Worker->ObjectDescription,
+									Worker->ObjectStartCommand, Worker->ObjectPrestartCommand, Worker->ObjectStopCommand,
+									Worker->ObjectReloadCommand, Worker->ObjectPIDFile, Worker->ObjectWorkingDirectory,
+									Worker->ObjectStderr, Worker->ObjectStdout, Worker->ObjectRequires, Worker->ObjectAfter };
+		struct _EnvVarList *ObjEnv = Worker->EnvVars;
+		struct _RLTree *RLWorker = Worker->ObjectRunlevels;
+		
+		ConfigCache_PutString(&Buf, Worker->ObjectID);
+		
+		for (Inc = 0; Inc < NumConfigFiles && ConfigFileList[Inc] != Worker->ConfigFile; ++Inc);
+		ConfigCache_Put(&Buf, &Inc, sizeof Inc);
+		
+		for (Inc = 0; Inc < sizeof Strings / sizeof *Strings; ++Inc) ConfigCache_PutString(&Buf, Strings[Inc]);
+		
+		ConfigCache_Put(&Buf, &Worker->ObjectStartPriority, sizeof Worker->ObjectStartPriority);
+		ConfigCache_Put(&Buf, &Worker->ObjectStopPriority, sizeof Worker->ObjectStopPriority);
+		ConfigCache_Put(&Buf, &Worker->UserID, sizeof Worker->UserID);
+		ConfigCache_Put(&Buf, &Worker->GroupID, sizeof Worker->GroupID);
+		ConfigCache_Put(&Buf, &Worker->TermSignal, sizeof Worker->TermSignal);
+		ConfigCache_Put(&Buf, &Worker->ReloadCommandSignal, sizeof Worker->ReloadCommandSignal);
+		ConfigCache_Put(&Buf, &Worker->Enabled, sizeof Worker->Enabled);
+		ConfigCache_Put(&Buf, &Worker->Started, sizeof Worker->Started);
+		ConfigCache_Put(&Buf, Worker->ExitStatuses, sizeof Worker->ExitStatuses);
+		ConfigCache_Put(&Buf, &Worker->Opts, sizeof Worker->Opts);
+		
+		for (Count = 0; ObjEnv && ObjEnv->Next; ObjEnv = ObjEnv->Next) ++Count;
+		ConfigCache_Put(&Buf, &Count, sizeof Count);
+		for (ObjEnv = Worker->EnvVars; ObjEnv && ObjEnv->Next; ObjEnv = ObjEnv->Next) ConfigCache_PutString(&Buf, ObjEnv->EnvVar);
+		
+		for (Count = 0; RLWorker && RLWorker->Next; RLWorker = RLWorker->Next) ++Count;
+		ConfigCache_Put(&Buf, &Count, sizeof Count);
+		for (RLWorker = Worker->ObjectRunlevels; RLWorker && RLWorker->Next; RLWorker = RLWorker->Next) ConfigCache_PutString(&Buf, RLWorker->RL);
+	}
+	
+	/*Write it beside and rename over, so nobody ever loads half a cache.*/
+	if (!(Descriptor = fopen(NewPath, "wb")))
+	{ /*Probably a read-only root during boot. We'll get it next time.*/
+		free(Buf.Data);
+		return;
+	}
+	
+	if (fwrite(Buf.Data, 1, Buf.Size, Descriptor) != Buf.Size)
+	{
+		fclose(Descriptor);
+		unlink(NewPath);
+	}
+	else if (fclose(Descriptor) != 0 || rename(NewPath, Path) != 0)
+	{
+		unlink(NewPath);
+	}
+	
+	free(Buf.Data);
+}
+
+static void ConfigCache_Stamp(struct _ConfigCacheBuf *Buf)
+{ /*Every file the loaded config came from, as stat() sees it now.*/
+	unsigned Inc = 0;
+	
+	Buf->Size = 0;
+	
+	for (; Inc < NumConfigFiles; ++Inc) ConfigCache_PutFile(Buf, ConfigFileList[Inc]);
+	for (Inc = 0; Inc < ConfigCache.NumDepends; ++Inc) ConfigCache_PutFile(Buf, ConfigCache.Depends[Inc]);
+}
+
+static void ConfigCache_Remove(void)
+{
+	char Path[MAX_LINE_SIZE + sizeof CONFIG_CACHE_SUFFIX];
+	
+	snprintf(Path, sizeof Path, "%s" CONFIG_CACHE_SUFFIX, ConfigFile);
+	unlink(Path);
+}
+
+static Bool ConfigCache_Load(Bool *TrueLogEnable)
+{ /*Rebuilds the config from the cache, if it's there and nothing it came from has changed since.*/
+	char Path[MAX_LINE_SIZE + sizeof CONFIG_CACHE_SUFFIX];
+	struct _ConfigCacheReader Reader = { NULL };
+	struct stat FileStat;
+	void *Map = NULL;
+	int Descriptor = -1;
+	unsigned Magic[2], Count = 0, Inc = 0, Seen = 0;
+	const char *Build = NULL;
+	const char *FilePaths[MAX_CONFIG_FILES];
+	const char *GlobalStrings[5];
+	Bool Globals[3];
+	unsigned char TAutoMountOpts[sizeof AutoMountOpts];
+	struct _BootBanner TBootBanner;
+	struct _StatusReportFormat TStatusReportFormat;
+	unsigned TBootWorkers = 0, TConfigAutoReload = 0;
+	
+	snprintf(Path, sizeof Path, "%s" CONFIG_CACHE_SUFFIX, ConfigFile);
+	
+	if ((Descriptor = open(Path, O_RDONLY)) == -1) return false;
+	
+	if (fstat(Descriptor, &FileStat) != 0 || FileStat.st_size == 0 ||
+		(Map = mmap(NULL, FileStat.st_size, PROT_READ, MAP_PRIVATE, Descriptor, 0)) == MAP_FAILED)
+	{
+		close(Descriptor);
+		return false;
+	}
+	close(Descriptor);
+	
+	Reader.Pos = Map;
+	Reader.End = Reader.Pos + FileStat.st_size;
+	
+	/*Is it ours, and still current?*/
+	ConfigCache_Get(&Reader, Magic, sizeof Magic);
+	Build = ConfigCache_GetString(&Reader);
+	ConfigCache_Get(&Reader, &Count, sizeof Count);
+	
+	if (Reader.Bad || Magic[0] != CONFIG_CACHE_MAGIC || Magic[1] != CONFIG_CACHE_VERSION ||
+		!Build || strcmp(Build, VERSIONSTRING " " __DATE__ " " __TIME__) != 0 || Count != sizeof(ObjTable))
+	{
+		munmap(Map, FileStat.st_size);
+		return false;
+	}
+	
+	ConfigCache_Get(&Reader, &Count, sizeof Count);
+	
+	for (Inc = 0; Inc < Count && Count <= MAX_CONFIG_FILES; ++Inc)
+	{
+		if (!ConfigCache_CheckFile(&Reader, &FilePaths[Inc]) || (Inc == 0 && strcmp(FilePaths[0], ConfigFile) != 0)) break;
+	}
+	
+	if (Inc != Count || Count == 0)
+	{
+		munmap(Map, FileStat.st_size);
+		return false;
+	}
+	
+	NumConfigFiles = Count;
+	
+	ConfigCache_Get(&Reader, &Count, sizeof Count);
+	
+	for (Inc = 0; Inc < Count && Count <= CONFIG_CACHE_MAX_DEPENDS; ++Inc)
+	{
+		const char *Depend = NULL;
+		
+		if (!ConfigCache_CheckFile(&Reader, &Depend)) break;
+		
+		ConfigCache_Depend(Depend); /*ReloadConfig() wants these too.*/
+	}
+	
+	if (Inc != Count)
+	{
+		NumConfigFiles = 1;
+		munmap(Map, FileStat.st_size);
+		return false;
+	}
+	
+	/*It's current. Objects point at their config file's name, so those go first.*/
+	for (Inc = 1; Inc < NumConfigFiles; ++Inc)
+	{
+		ConfigFileList[Inc] = malloc(strlen(FilePaths[Inc]) + 1);
+		strcpy(ConfigFileList[Inc], FilePaths[Inc]);
+	}
+	
+	/*Global options. We hold onto these until we know the rest is good.*/
+	ConfigCache_Get(&Reader, &Seen, sizeof Seen);
+	ConfigCache_Get(&Reader, &Globals[0], sizeof(Bool));
+	ConfigCache_Get(&Reader, &Globals[1], sizeof(Bool));
+	ConfigCache_Get(&Reader, &Globals[2], sizeof(Bool));
+	ConfigCache_Get(&Reader, TAutoMountOpts, sizeof TAutoMountOpts);
+	ConfigCache_Get(&Reader, &TBootBanner, sizeof TBootBanner);
+	ConfigCache_Get(&Reader, &TStatusReportFormat, sizeof TStatusReportFormat);
+	ConfigCache_Get(&Reader, &TBootWorkers, sizeof TBootWorkers);
+	ConfigCache_Get(&Reader, &TConfigAutoReload, sizeof TConfigAutoReload);
+	
+	for (Inc = 0; Inc < sizeof GlobalStrings / sizeof *GlobalStrings; ++Inc)
+	{
+		GlobalStrings[Inc] = ConfigCache_GetString(&Reader);
+	}
+	
+	ConfigCache_Get(&Reader, &Count, sizeof Count);
+	for (Inc = 0; Inc < Count && !Reader.Bad; ++Inc)
+	{
+		const char *Inheriter = ConfigCache_GetString(&Reader), *Inherited = ConfigCache_GetString(&Reader);
+		
+		if (Inheriter && Inherited && strlen(Inheriter) < MAX_DESCRIPT_SIZE && strlen(Inherited) < MAX_DESCRIPT_SIZE)
+		{
+			RLInheritance_Add(Inheriter, Inherited);
+		}
+	}
+	
+	ConfigCache_Get(&Reader, &Count, sizeof Count);
+	for (Inc = 0; Inc < Count && !Reader.Bad; ++Inc)
+	{
+		const char *EnvVar = ConfigCache_GetString(&Reader);
+		
+		if (EnvVar) EnvVarList_Add(EnvVar, &GlobalEnvVars);
+	}
+	
+	/*The objects.*/
+	ConfigCache_Get(&Reader, &Count, sizeof Count);
+	for (Inc = 0; Inc < Count && !Reader.Bad; ++Inc)
+	{
+		const char *ObjectID = ConfigCache_GetString(&Reader);
+		char **Strings[11];
+		unsigned FileIndex = 0, SInc = 0, SubCount = 0;
+		ObjTable *CurObj = NULL;
+		
+		ConfigCache_Get(&Reader, &FileIndex, sizeof FileIndex);
+		
+		if (!ObjectID || FileIndex >= NumConfigFiles || !(CurObj = AddObjectToTable(ObjectID, ConfigFileList[FileIndex])))
+		{
+			Reader.Bad = true;
+			break;
+		}
+		
+		Strings[0] = &CurObj->ObjectDescription;
+		Strings[1] = &CurObj->ObjectStartCommand;
+		Strings[2] = &CurObj->ObjectPrestartCommand;
+		Strings[3] = &CurObj->ObjectStopCommand;
+		Strings[4] = &CurObj->ObjectReloadCommand;
+		Strings[5] = &CurObj->ObjectPIDFile;
+		Strings[6] = &CurObj->ObjectWorkingDirectory;
+		Strings[7] = &CurObj->ObjectStderr;
+		Strings[8] = &CurObj->ObjectStdout;
+		Strings[9] = &CurObj->ObjectRequires;
+		Strings[10] = &CurObj->ObjectAfter;
+		
+		for (SInc = 0; SInc < sizeof Strings / sizeof *Strings; ++SInc) *Strings[SInc] = ConfigArena_StrDup(CurObj->Arena, ConfigCache_GetString(&Reader));
+		
+		if (!CurObj->ObjectDescription) CurObj->ObjectDescription = CurObj->ObjectID;
+		
+		ConfigCache_Get(&Reader, &CurObj->ObjectStartPriority, sizeof CurObj->ObjectStartPriority);
+		ConfigCache_Get(&Reader, &CurObj->ObjectStopPriority, sizeof CurObj->ObjectStopPriority);
+		ConfigCache_Get(&Reader, &CurObj->UserID, sizeof CurObj->UserID);
+		ConfigCache_Get(&Reader, &CurObj->GroupID, sizeof CurObj->GroupID);
+		ConfigCache_Get(&Reader, &CurObj->TermSignal, sizeof CurObj->TermSignal);
+		ConfigCache_Get(&Reader, &CurObj->ReloadCommandSignal, sizeof CurObj->ReloadCommandSignal);
+		ConfigCache_Get(&Reader, &CurObj->Enabled, sizeof CurObj->Enabled);
+		ConfigCache_Get(&Reader, &CurObj->Started, sizeof CurObj->Started);
+		ConfigCache_Get(&Reader, CurObj->ExitStatuses, sizeof CurObj->ExitStatuses);
+		ConfigCache_Get(&Reader, &CurObj->Opts, sizeof CurObj->Opts);
+		
+		ConfigCache_Get(&Reader, &SubCount, sizeof SubCount);
+		for (SInc = 0; SInc < SubCount && !Reader.Bad; ++SInc)
+		{
+			const char *EnvVar = ConfigCache_GetString(&Reader);
 			
-			if (SWorker->ObjectID) free(SWorker->ObjectID);
-			if (SWorker->ObjectDescription &&
-				SWorker->ObjectDescription != SWorker->ObjectID) free(SWorker->ObjectDescription);
-			if (SWorker->ObjectStartCommand) free(SWorker->ObjectStartCommand);
-			if (SWorker->ObjectStopCommand) free(SWorker->ObjectStopCommand);
-			if (SWorker->ObjectReloadCommand) free(SWorker->ObjectReloadCommand);
-			if (SWorker->ObjectPrestartCommand) free(SWorker->ObjectPrestartCommand);
-			if (SWorker->ObjectPIDFile) free(SWorker->ObjectPIDFile);
-			if (SWorker->ObjectWorkingDirectory) free(SWorker->ObjectWorkingDirectory);
-			if (SWorker->ObjectStdout) free(SWorker->ObjectStdout);
-			if (SWorker->ObjectStderr) free(SWorker->ObjectStderr);
-			EnvVarList_Shutdown(&SWorker->EnvVars);
+			if (EnvVar) EnvVarList_Insert(EnvVar, &CurObj->EnvVars, CurObj->Arena);
 		}
 		
-		Temp = SWorker->Next;
-		free(SWorker);
+		ConfigCache_Get(&Reader, &SubCount, sizeof SubCount);
+		for (SInc = 0; SInc < SubCount && !Reader.Bad; ++SInc)
+		{
+			const char *RL = ConfigCache_GetString(&Reader);
+			
+			if (RL) ObjRL_AddRunlevel(RL, CurObj);
+		}
+	}
+	
+	if (Reader.Bad || !ObjectTable)
+	{ /*Corrupt. Parse the config like normal.*/
+		ShutdownConfig();
+		munmap(Map, FileStat.st_size);
+		return false;
 	}
 	
-	/*Release the backup runlevel inheritance table.*/
-	for (; RLIRoot != NULL; RLIRoot = RLIWorker[0])
+	/*Everything's good, so the global options can go in now.*/
+	if (Seen & CCACHE_DISABLECAD) DisableCAD = Globals[0];
+	if (Seen & CCACHE_BLANKLOG) BlankLogOnBoot = Globals[1];
+	if (Seen & CCACHE_ENABLELOG) *TrueLogEnable = Globals[2];
+	if (Seen & CCACHE_BANNER) BootBanner = TBootBanner;
+	if (Seen & CCACHE_STATUSFORMAT) StatusReportFormat = TStatusReportFormat;
+	if ((Seen & CCACHE_LOGFILE) && GlobalStrings[1]) snprintf(LogFile, sizeof LogFile, "%s", GlobalStrings[1]);
+	if ((Seen & CCACHE_HOSTNAME) && GlobalStrings[2]) snprintf(Hostname, sizeof Hostname, "%s", GlobalStrings[2]);
+	if ((Seen & CCACHE_DOMAINNAME) && GlobalStrings[3]) snprintf(Domainname, sizeof Domainname, "%s", GlobalStrings[3]);
+	
+	for (Inc = 0; Inc < sizeof AutoMountOpts; ++Inc)
 	{
-		RLIWorker[0] = RLIRoot->Next;
-		free(RLIRoot);
+		if (TAutoMountOpts[Inc]) AutoMountOpts[Inc] = TAutoMountOpts[Inc];
 	}
 	
-	/*Release the backup global envvars.*/
-	EnvVarList_Shutdown(&GlobalEnvRoot);
+	BootWorkers = TBootWorkers;
+	ConfigAutoReload = TConfigAutoReload;
+	snprintf(CGroupHierarchy, sizeof CGroupHierarchy, "%s", GlobalStrings[0] ? GlobalStrings[0] : "");
 	
-	WriteLogLine("CONFIG: " CONSOLE_COLOR_GREEN "Configuration reload successful." CONSOLE_ENDCOLOR, true);
-	puts(CONSOLE_COLOR_GREEN "Epoch: Configuration reloaded." CONSOLE_ENDCOLOR);
+	if (*CurRunlevel == '\0' && GlobalStrings[4])
+	{
+		snprintf(CurRunlevel, sizeof CurRunlevel, "%s", GlobalStrings[4]);
+	}
 	
-	FinaliseLogStartup(false); /*Clean up logs in memory.*/
+	munmap(Map, FileStat.st_size);
 	
-	return SUCCESS;
+	return true;
 }
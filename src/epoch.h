@@ -15,6 +15,9 @@
 #define MAX_DESCRIPT_SIZE 384
 #define MAX_LINE_SIZE 2048
 #define MAX_CONFIG_FILES 400
+#define MAX_BOOT_WORKERS 64 /*Upper limit for the BootWorkers attribute.*/
+#define STOP_KILL_GRACE 2 /*Seconds a shutdown stop group gets to die after StopTimeout runs out and we send SIGKILL.*/
+#define LOG_BUFFER_SIZE (MAX_LINE_SIZE * 16) /*Log lines held before we must write them out.*/
 
 /*Configuration.*/
 
@@ -37,6 +40,24 @@
 
 #define CONF_NAME "epoch.conf"
 
+/*The compiled config, kept beside the config file when it says ConfigCache true.*/
+#define CONFIG_CACHE_SUFFIX ".cache"
+#define CONFIG_CACHE_MAGIC 0x43434545
+#define CONFIG_CACHE_VERSION 2
+#define CONFIG_CACHE_MAX_DEPENDS 32 /*Files besides config files, like Hostname FILE, the cache goes stale with.*/
+
+#define CONFIG_ARENA_CHUNK_SIZE (64 * 1024) /*Objects' strings and lists are carved out of blocks this big.*/
+
+#define CONFIG_AUTORELOAD_DEFAULT 2000 /*Msecs of quiet after an edit before "ConfigAutoReload true" reloads.*/
+
+#ifndef CGROUP_HIERARCHY /*Objects get their own cgroups under here when it's on cgroup2.*/
+#define CGROUP_HIERARCHY "/sys/fs/cgroup/epoch"
+#endif
+
+#ifndef CGROUP2_SUPER_MAGIC
+#define CGROUP2_SUPER_MAGIC 0x63677270
+#endif
+
 
 /*Environment variables.*/
 #ifndef ENVVAR_HOME
@@ -93,6 +114,19 @@
 
 #define MEMBUS_SIZE 4096 + sizeof(long) * 2
 #define MEMBUS_MSGSIZE 2047
+#define MEMBUS_SLOTS 8 /*How many clients can be connected at once.*/
+#define MEMBUS_LEGACY_SIZE 8192 /*Slot 0 is laid out like the old single-client bus, so old clients still find it.*/
+#define MEMBUS_HEADER_OFFSET 7168 /*Where struct _MemBusHeader sits, past the end of slot 0's old layout.*/
+#define MEMBUS_MAGIC 0x42504545
+#define MEMBUS_FRAME_SIZE (64 * 1024) /*The least one message on slots 1 and up can carry.*/
+#define MEMBUS_FRAME_PEROBJ 256 /*Room we give each object, so LSBULK still goes in one message on big configs.*/
+#define MEMBUS_FRAME_MAX (1024 * 1024)
+
+/*The control socket, an abstract AF_UNIX SOCK_SEQPACKET socket that takes the same commands as the membus.*/
+#define CONTROL_SOCKET_NAME "epoch-control"
+#define CONTROL_MAX_CLIENTS 16
+#define CONTROL_MSGSIZE MEMBUS_FRAME_SIZE /*Largest reply we send in one packet.*/
+#define MEMBUS_NAP_MSECS 10 /*Longest we sleep on a futex before looking again, in case the other end is too old to wake us.*/
 
 /*The codes that are sent over the bus.*/
 
@@ -133,11 +167,25 @@
 #define MEMBUS_CODE_LSOBJS "LSOBJS"
 #define MEMBUS_CODE_CFMERGE "CFMERGE"
 #define MEMBUS_CODE_CFUMERGE "CFUMERGE"
+#define MEMBUS_CODE_LAUNCHER "LAUNCHER"
 
 #define MEMBUS_CODE_RXD "RXD"
 #define MEMBUS_CODE_RXD_OPTS "ORXD"
 
+/*Re-exec hands its state over in a sealed memfd. Its descriptor number is in this environment variable.*/
+#define REEXEC_STATE_ENVVAR "EPOCHRXDSTATE"
+#define REEXEC_STATE_MAGIC 0x44585245
+#define REEXEC_STATE_VERSION 1 /*Bump whenever the layout changes. Mismatches fall back to the membus.*/
+
 #define MEMBUS_LSOBJS_VERSION "V4"
+#define MEMBUS_CODE_LSOBJS_BULK "LSBULK" /*LSOBJS, packing many objects into each message. Older Epochs answer BADPARAM.*/
+#define MEMBUS_LSOBJS_BULK_VERSION "V5"
+#define LSBULK_RLTRUNCATED 0x01 /*Record flag. Not all of the object's runlevels fit.*/
+
+/*How often PrimaryLoop() looks at the membus, in milliseconds.*/
+#define LOOP_BUSPOLL_ACTIVE 5 /*While a membus client holds a slot.*/
+#define LOOP_BUSPOLL_IDLE 100 /*Only without the control socket. Clients knock on it otherwise, so we needn't look.*/
+
 /**Types, enums, structs and whatnot**/
 
 #define MOUNTVIRTUAL_MKDIR 2
@@ -166,10 +214,21 @@ typedef enum { BOOT_NEUTRAL, BOOT_BOOTUP, BOOT_SHUTDOWN } BootMode;
 /**Structures go here.**/
 struct _RLTree
 { /*Runlevel linked list.*/
-	char RL[MAX_DESCRIPT_SIZE];
-	
 	struct _RLTree *Prev;
 	struct _RLTree *Next;
+	
+	char RL[]; /*Sized to fit. The empty node at the end has just the terminator.*/
+};
+
+struct _ConfigArena; /*Where an object's strings and lists are allocated. Private to config.c.*/
+
+struct _ObjCredentials
+{ /*What ObjectUser's passwd entry says, looked up with the config so launching needs no NSS.*/
+	char *EnvStrings[3]; /*"HOME=", "USER=" and "SHELL=", for the object's environment.*/
+	const char *HomeDirectory; /*Points into EnvStrings[0].*/
+	unsigned GroupID; /*ObjectGroup if there is one, otherwise the user's own.*/
+	gid_t *Groups; /*Supplementary groups, what initgroups() would set.*/
+	int NumGroups;
 };
 	
 typedef struct _EpochObjectTable
@@ -177,6 +236,8 @@ typedef struct _EpochObjectTable
 	unsigned ObjectStartPriority;
 	unsigned ObjectStopPriority;
 	unsigned ObjectPID; /*The process ID, used for shutting down.*/
+	int PIDFD; /*A pidfd for PIDFDTarget, or -1. See GetObjectPIDFD().*/
+	unsigned PIDFDTarget;
 	unsigned UserID; /*The user ID we run this as. Zero, of course, is root and we need do nothing.*/
 	unsigned GroupID; /*Same as above, but with groups.*/
 	unsigned StartedSince; /*The time in UNIX seconds since it was started.*/
@@ -190,6 +251,14 @@ typedef struct _EpochObjectTable
 	char *ObjectWorkingDirectory; /*The working directory the object chdirs to before execution.*/
 	char *ObjectStderr; /*A file that stderr redirects to.*/
 	char *ObjectStdout; /*A file that stdout redirects to.*/
+	char *ObjectRequires; /*Space separated ObjectIDs that must start successfully before we can.*/
+	char *ObjectAfter; /*Same as above, but we start even if they failed.*/
+	char **StartArgV; /*The commands above already split into words for execvp(), when they don't need a shell.*/
+	char **PrestartArgV; /*NULL if the command does need one. Built when the config is loaded, in the arena.*/
+	char **StopArgV;
+	char **ReloadArgV;
+	char **EnvOverlay; /*EnvVars, then Credentials' strings, as one array to lay over our environment. NULL if empty.*/
+	struct _ObjCredentials *Credentials; /*Only with ObjectUser. NULL until a lookup works.*/
 	
 	const char *ConfigFile; /*The config file this object was declared in.
 	* Points either to the correct element in ConfigFileList or it points to the single-file ConfigFile array.
@@ -235,6 +304,7 @@ typedef struct _EpochObjectTable
 	
 	struct _EnvVarList *EnvVars; /*List of environment variables.*/
 	struct _RLTree *ObjectRunlevels; /*Dynamically allocated, needless to say.*/
+	struct _ConfigArena *Arena; /*Holds the strings above and the nodes of both lists. Never free() them.*/
 	
 	struct _EpochObjectTable *Prev;
 	struct _EpochObjectTable *Next;
@@ -267,26 +337,55 @@ struct _CTask
 	unsigned Set : 1;
 };
 
+struct _MemBusHeader
+{ /*Server picks these at startup. Lives at MEMBUS_HEADER_OFFSET, if the server is new enough.*/
+	unsigned Magic; /*MEMBUS_MAGIC.*/
+	unsigned NumSlots; /*Counting slot 0.*/
+	unsigned SlotSize; /*Of each slot after slot 0, which is always MEMBUS_LEGACY_SIZE.*/
+	unsigned FrameSize; /*Largest message slots after slot 0 carry either way.*/
+	unsigned Doorbell; /*Clients bump it whenever they send, so init can sleep on just one futex.*/
+	unsigned Futex[2]; /*Slot 0 has no room of its own for these.*/
+};
+
+struct _ReexecState
+{ /*Starts the re-exec memfd. One record per object follows: unsigned PID, unsigned StartedSince, Bool Started, then the ObjectID.*/
+	unsigned Magic; /*REEXEC_STATE_MAGIC.*/
+	unsigned Version;
+	unsigned Size; /*Of everything, counting this header.*/
+	unsigned NumObjects;
+	int ChildPID; /*The child still serving the old membus exchange, for binaries that don't know about us.*/
+	struct _HaltParams HaltParams;
+	Bool EnableLogging;
+	char CurRunlevel[MAX_DESCRIPT_SIZE];
+};
+
 struct _MemBusInterface
 {
 	void *Root;
-	unsigned long *LockPID;
+	struct _MemBusHeader *Header; /*NULL if the other end is from before we had one.*/
+	unsigned NumSlots; /*1 if the other end is from before we had slots.*/
+	unsigned CurSlot; /*The slot everything below points into.*/
+	unsigned MsgSize; /*Largest message CurSlot carries. MEMBUS_MSGSIZE on slot 0.*/
+	unsigned long *LockPID; /*Who owns CurSlot.*/
 	unsigned long *LockTime;
+	unsigned *Doorbell;
 	
 	struct
 	{
 		unsigned char *Status;
 		char *Message;
 		unsigned char *BinMessage;
+		unsigned *Futex; /*Bumped on every change of Status. NULL on a bus too old to have them.*/
+		unsigned *Length; /*Of the message waiting. NULL on slot 0, where it's always MEMBUS_MSGSIZE.*/
 	} Server, Client;
 };
 
 struct _EnvVarList
 {
-	char EnvVar[MAX_LINE_SIZE];
-
 	struct _EnvVarList *Next;
 	struct _EnvVarList *Prev;
+	
+	char EnvVar[]; /*Sized to fit, like _RLTree.*/
 };
 
 struct _StatusReportFormat
@@ -319,6 +418,7 @@ extern Bool EnableLogging;
 extern Bool LogInMemory;
 extern Bool BlankLogOnBoot;
 extern char *MemLogBuffer;
+extern size_t MemLogLength;
 extern struct _CTask CurrentTask;
 extern BootMode CurrentBootMode;
 extern int MemBusKey;
@@ -332,6 +432,11 @@ extern struct _StatusReportFormat StatusReportFormat;
 extern struct _StartupCustomObjCommands StartupCustomObjCommands;
 extern Bool InteractiveBoot;
 extern char LogFile[MAX_LINE_SIZE];
+extern unsigned BootWorkers;
+extern unsigned ConfigAutoReload;
+extern int ObjectWatchDescriptor;
+extern Bool LoopTimerStale;
+extern char CGroupHierarchy[MAX_LINE_SIZE];
 //End of globals
 
 
@@ -342,8 +447,8 @@ extern ReturnCode InitConfig(const char *CurConfigFile);
 extern void ShutdownConfig(void);
 extern ReturnCode ReloadConfig(void);
 extern ObjTable *LookupObjectInTable(const char *ObjectID);
-extern ObjTable *GetObjectByPriority(const char *ObjectRunlevel, ObjTable *LastNode,
-									Bool WantStartPriority, unsigned ObjectPriority);
+extern ObjTable **GetObjectSchedule(const char *ObjectRunlevel, Bool WantStartPriority);
+extern void ObjSchedule_Invalidate(void);
 extern unsigned GetHighestPriority(Bool WantStartPriority);
 extern ReturnCode EditConfigValue(const char *File, const char *ObjectID, const char *Attribute, const char *Value);
 extern void ObjRL_AddRunlevel(const char *InRL, ObjTable *InObj);
@@ -354,16 +459,23 @@ extern void ObjRL_ShutdownRunlevels(ObjTable *InObj);
 extern char *WhitespaceArg(const char *InStream);
 extern void EnvVarList_Shutdown(struct _EnvVarList **const List);
 extern void EnvVarList_Add(const char *Var, struct _EnvVarList **const List);
-extern Bool EnvVarList_Del(const char *const Check, struct _EnvVarList **const List);
+extern Bool ObjTable_LoadCredentials(ObjTable *Worker);
 extern void EnvVarList_Shutdown(struct _EnvVarList **const List);
 extern ReturnCode UnmergeImportLine(const char *Filename);
 extern ReturnCode MergeImportLine(const char *LineData);
+extern void ConfigWatch_Reset(void);
+extern Bool ConfigWatch_Owns(int Descriptor);
+extern void ConfigWatch_Service(void);
+extern void ConfigWatch_Check(void);
+extern int ConfigWatch_Timeout(void);
 
 /*parse.c*/
 extern ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool PrintStatus);
 extern ReturnCode RunAllObjects(Bool IsStartingMode);
 extern ReturnCode SwitchRunlevels(const char *Runlevel);
 extern ReturnCode ProcessReloadCommand(ObjTable *CurObj, Bool PrintStatus);
+extern void LauncherProfile_Resolve(void);
+extern const char *LauncherProfile_Describe(void);
 
 /*actions.c*/
 extern void LaunchBootup(void);
@@ -392,6 +504,12 @@ extern Bool HandleMemBusPings(void);
 extern Bool CheckMemBusIntegrity(void);
 extern unsigned MemBus_BinWrite(const void *InStream_, unsigned DataSize, Bool ServerSide);
 extern unsigned MemBus_BinRead(void *OutStream_, unsigned MaxOutSize, Bool ServerSide);
+extern Bool MemBus_Busy(void);
+extern void MemBus_WaitMessage(Bool ServerSide);
+extern void MemBus_WaitDoorbell(int Timeout);
+extern void ControlSock_Watch(void);
+extern Bool ControlSock_Owns(int Descriptor);
+extern Bool ControlSock_Listening(void);
 
 /*console.c*/
 extern void PrintBootBanner(void);
@@ -411,10 +529,25 @@ extern void MinsToDate(unsigned MinInc, unsigned *OutHr, unsigned *OutMin,
 extern short GetStateOfTime(unsigned Hr, unsigned Min, unsigned Sec,
 				unsigned Month, unsigned Day, unsigned Year);
 extern Bool AllNumeric(const char *InStream);
-extern Bool ObjectProcessRunning(const ObjTable *InObj);
+extern Bool ObjectProcessRunning(ObjTable *InObj);
+extern Bool ObjectPIDRunning(ObjTable *InObj);
+extern int GetObjectPIDFD(ObjTable *InObj, unsigned PID);
+extern void CloseObjectPIDFD(ObjTable *InObj);
+extern Bool WaitForObjectExit(ObjTable *InObj, unsigned PID, unsigned Timeout, const Bool *Abort);
 extern unsigned ReadPIDFile(const ObjTable *InObj);
 extern ReturnCode WriteLogLine(const char *InStream, Bool AddDate);
+extern ReturnCode FlushLogBuffer(void);
+extern ReturnCode WriteLogBuffer(const char *InBuffer, size_t Length, Bool Truncate);
+extern void ShutdownLogging(void);
 extern unsigned AdvancedPIDFind(ObjTable *InObj, Bool UpdatePID);
+extern void AdvancedPIDFindAll(void);
+extern Bool CGroup_Create(const ObjTable *InObj);
+extern Bool CGroup_Attach(const ObjTable *InObj);
+extern void CGroup_Remove(const ObjTable *InObj);
+extern void CGroup_Release(const ObjTable *InObj, Bool Kill);
+extern short CGroup_Populated(const ObjTable *InObj);
+extern Bool CGroup_FindPID(const ObjTable *InObj, unsigned Hint, unsigned *OutPID);
+extern Bool CGroup_Kill(const ObjTable *InObj);
 extern Bool ProcAvailable(void);
 extern Bool ValidIdentifierName(const char *const Identifier);
 
@@ -27,6 +27,19 @@
 #define ArgIs(z) !strcmp(CArg, z)
 #define CmdIs(z) __CmdIs(argv[0], z)
 
+struct _ObjStatus
+{ /*One object as 'epoch status' sees it, decoded from either LSOBJS V4 or LSBULK.*/
+	char ObjectID[MAX_DESCRIPT_SIZE];
+	char ObjectDescription[MAX_DESCRIPT_SIZE];
+	char Runlevels[MEMBUS_MSGSIZE]; /*Each preceded by a space.*/
+	unsigned PID, UserID, GroupID, StartedSince, StopTimeout;
+	enum _StopMode StopMode;
+	unsigned char TermSignal, ReloadCommandSignal;
+	unsigned char NumMXS, MXS[8][2]; /*Value, then exit status.*/
+	Bool Started, Running, Enabled, RLTruncated;
+	Bool Opts[COPT_MAX]; /*Indexed by COPT_*.*/
+};
+
 /*Forward declarations for static functions.*/
 static ReturnCode ProcessGenericHalt(int argc, char **argv);
 static Bool __CmdIs(const char *CArg, const char *InCmd);
@@ -36,6 +49,9 @@ static void SigHandler(int Signal);
 static void SetDefaultProcessTitle(int argc, char **argv);
 static Bool KCmdLineObjCmd_Add(const char *ObjectID, Bool StartMode);
 static Bool NoKArgsFileExists(void);
+static void PrintObjectStatus(const struct _ObjStatus *Status, Bool UseColor);
+static Bool ReadObjectStatusV4(char *InBuf, struct _ObjStatus *Status);
+static const unsigned char *UnpackObjectStatus(const unsigned char *Record, struct _ObjStatus *Status);
 ///static Bool KCmdLineObjCmd_Del(const char *ObjectID, Bool StartMode);
 
 /*
@@ -366,13 +382,18 @@ static void PrintEpochHelp(const char *RootCommand, const char *InCmd)
 		  "This command simply edits the configuration file on-disk."
 		),
 		  
+		( "launcher:\n\t"
+		
+		  "Prints which shell Epoch runs object commands with, if they need one."
+		),
+		  
 		( "version:\n\t"
 		
 		  "Prints the current version of the Epoch Init System."
 		)
 	};
 	enum { HCMD, SHTDN, ENDIS, STAP, REL, OBJRL, STATUS, SETCAD, CONFRL, REEXEC,
-		RLCTL, GETPID, KILLOBJ, MERGECMD, VER, ENUM_MAX };
+		RLCTL, GETPID, KILLOBJ, MERGECMD, LAUNCHER, VER, ENUM_MAX };
 	
 	printf("%s\nCompiled %s %s\n\n", VERSIONSTRING, __DATE__, __TIME__);
 	
@@ -457,6 +478,11 @@ static void PrintEpochHelp(const char *RootCommand, const char *InCmd)
 		printf("%s %s\n\n", RootCommand, HelpMsgs[MERGECMD]);
 		return;
 	}
+	else if (!strcmp(InCmd, "launcher"))
+	{
+		printf("%s %s\n\n", RootCommand, HelpMsgs[LAUNCHER]);
+		return;
+	}
 	else if (!strcmp(InCmd, "version"))
 	{
 		printf("%s %s\n\n", RootCommand, HelpMsgs[VER]);
@@ -545,6 +571,265 @@ static ReturnCode ProcessGenericHalt(int argc, char **argv)
 	return SUCCESS;
 }
 
+static void PrintObjectStatus(const struct _ObjStatus *Status, Bool UseColor)
+{ /*What 'epoch status' shows for one object, whichever LSOBJS version it came over.*/
+	const char *const YN[2][3] = { { "No", "Yes", "N/A" },
+								{ CONSOLE_COLOR_RED "No" CONSOLE_ENDCOLOR,
+								CONSOLE_COLOR_GREEN "Yes" CONSOLE_ENDCOLOR,
+								CONSOLE_COLOR_YELLOW "N/A" CONSOLE_ENDCOLOR } };
+	const Bool *const Opts = Status->Opts;
+	const Bool NotApplicable = Opts[COPT_HALTONLY] || Opts[COPT_PIVOTROOT] || Opts[COPT_EXEC];
+	Bool OptNewline = false;
+	unsigned Inc = 0;
+	
+	printf("ObjectID: %s\nObjectDescription: %s\nEnabled: %s | Started: %s | Running: %s | Stop mode: ",
+			Status->ObjectID, Status->ObjectDescription, YN[UseColor][Status->Enabled],
+			NotApplicable ? YN[UseColor][2] : YN[UseColor][Status->Started],
+			NotApplicable ? YN[UseColor][2] : YN[UseColor][Status->Running]);
+	
+	if (Status->StopMode == STOP_COMMAND) printf("Command");
+	else if (Status->StopMode == STOP_NONE) printf("None");
+	else if (Status->StopMode == STOP_PID) printf("PID");
+	else if (Status->StopMode == STOP_PIDFILE) printf("PID File");
+	
+	if (Status->Running)
+	{
+		printf(" | PID: %u\n", Status->PID);
+	}
+	else
+	{
+		putchar('\n');
+	}
+	
+	if (Status->Started)
+	{
+		time_t SS = (time_t)Status->StartedSince, CTime = time(NULL);
+		struct tm TStruct;
+		char TimeBuf[64] = { '\0' };
+		unsigned Offset = (CTime - Status->StartedSince) / 60;
+		localtime_r(&SS, &TStruct);
+		
+		asctime_r(&TStruct, TimeBuf);
+		
+		TimeBuf[strlen(TimeBuf) - 1] = '\0'; /*Nuke newline.*/
+		printf("Started since %s, for total of %u mins.\n", TimeBuf, Offset);
+	}
+	
+	if (Opts[COPT_SERVICE] || Opts[COPT_AUTORESTART] || Opts[COPT_HALTONLY] || Opts[COPT_PERSISTENT] || Opts[COPT_FORK] ||
+		Status->StopTimeout != 10 || Opts[COPT_NOTRACK] || Opts[COPT_FORCESHELL] || Opts[COPT_RAWDESCRIPTION] ||
+		Opts[COPT_NOSTOPWAIT] || Opts[COPT_PIVOTROOT] || Opts[COPT_RUNONCE] || Status->TermSignal != SIGTERM || Opts[COPT_EXEC] ||
+		Opts[COPT_STARTFAILCRITICAL] || Opts[COPT_STOPFAILCRITICAL])
+	{
+		printf("Options:");
+		
+		if (Opts[COPT_SERVICE]) printf(" SERVICE");
+		if (Opts[COPT_AUTORESTART]) printf(" AUTORESTART");
+		if (Opts[COPT_HALTONLY]) printf(" HALTONLY");
+		if (Opts[COPT_PERSISTENT]) printf(" PERSISTENT");
+		if (Opts[COPT_FORCESHELL]) printf(" FORCESHELL");
+		if (Opts[COPT_FORK])
+		{
+			if (Opts[COPT_FORKSCANONCE]) printf(" FORKN");
+			else printf(" FORK");
+		}
+		if (Opts[COPT_RAWDESCRIPTION]) printf(" RAWDESCRIPTION");
+		if (Status->TermSignal != SIGTERM) printf(" TERMSIGNAL=%u", Status->TermSignal);
+		if (Opts[COPT_NOSTOPWAIT]) printf(" NOSTOPWAIT");
+		if (Opts[COPT_PIVOTROOT]) printf(" PIVOT");
+		if (Opts[COPT_EXEC]) printf(" EXEC");
+		if (Opts[COPT_RUNONCE]) printf(" RUNONCE");
+		if (Opts[COPT_NOTRACK]) printf(" NOTRACK");
+		if (Opts[COPT_STARTFAILCRITICAL]) printf( "STARTFAILCRITICAL");
+		if (Opts[COPT_STOPFAILCRITICAL]) printf( "STOPFAILCRITICAL");
+		if (Status->StopTimeout != 10) printf(" STOPTIMEOUT=%u", Status->StopTimeout);
+		
+		OptNewline = true;
+	}
+	
+	if (Status->NumMXS > 0) OptNewline = true;
+	
+	for (; Inc < Status->NumMXS; ++Inc)
+	{
+		const char *Stringy = NULL;
+		unsigned char Value = Status->MXS[Inc][0], ExitStatus = Status->MXS[Inc][1];
+		
+		if (Value == SUCCESS) Stringy = "SUCCESS";
+		else if (Value == WARNING) Stringy = "WARNING";
+		else if (Value == FAILURE) Stringy = "FAILURE";
+		else Stringy = "<BAD>";
+		
+		printf(" MAPEXITSTATUS=%d,%s", ExitStatus, Stringy);
+	}
+	
+	if (OptNewline) putchar('\n');
+	
+	if (*Status->Runlevels && !Opts[COPT_HALTONLY])
+	{
+		printf("Runlevels:%s%s\n", Status->Runlevels, Status->RLTruncated ? " ..." : "");
+	}
+	
+	if (Status->UserID || Status->GroupID)
+	{
+		struct passwd *UserStruct = getpwuid(Status->UserID);
+		struct group *GroupStruct = getgrgid(Status->GroupID);
+		
+		if (UserStruct) printf("User: %s\n", UserStruct->pw_name);
+		if (GroupStruct && Status->GroupID != 0) printf("Group: %s\n", GroupStruct->gr_name);
+	}
+}
+
+static Bool ReadObjectStatusV4(char *InBuf, struct _ObjStatus *Status)
+{ /*InBuf holds the first message of a V4 LSOBJS record. When we return, it holds whatever came after the record.*/
+	unsigned char *BinWorker = NULL;
+	char RLExpect[MEMBUS_MSGSIZE], *Worker = InBuf + strlen(MEMBUS_CODE_LSOBJS " ");
+	unsigned Inc = 0;
+	
+	memset(Status, 0, sizeof(struct _ObjStatus));
+	
+	/*Version matters.*/
+	if (strncmp(Worker, MEMBUS_LSOBJS_VERSION, strlen(MEMBUS_LSOBJS_VERSION)) != 0)
+	{
+		SpitError("LSOBJS protocol version mismatch. Expected \"" MEMBUS_LSOBJS_VERSION "\".");
+		
+		while (strcmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS) != 0)
+		{ /*Don't mess up the membus, let it empty.*/
+			while (!MemBus_Read(InBuf, false)) MemBus_WaitMessage(false);
+		}
+		
+		return false;
+	}
+	
+	Worker += strlen(MEMBUS_LSOBJS_VERSION) + 1;
+	
+	BinWorker = (void*)Worker;
+	
+	Status->Started = *BinWorker++;
+	Status->Running = *BinWorker++;
+	Status->Enabled = *BinWorker++;
+	Status->TermSignal = *BinWorker++;
+	Status->ReloadCommandSignal = *BinWorker++;
+	
+	memcpy(&Status->UserID, BinWorker, sizeof(int));
+	memcpy(&Status->GroupID, (BinWorker += sizeof(int)), sizeof(int));
+	
+	memcpy(&Status->StopMode, (BinWorker += sizeof(int)), sizeof(enum _StopMode));
+	memcpy(&Status->PID, (BinWorker += sizeof(enum _StopMode)), sizeof(int));
+	
+	memcpy(&Status->StartedSince, (BinWorker += sizeof(int)), sizeof(int));
+	memcpy(&Status->StopTimeout, BinWorker + sizeof(int), sizeof(int));
+
+	while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) MemBus_WaitMessage(false);
+	
+	for (Worker = InBuf, Inc = 0; Worker[Inc] != ' '; ++Inc)
+	{ /*Get ObjectID*/
+		Status->ObjectID[Inc] = Worker[Inc];
+	}
+	Status->ObjectID[Inc] = '\0';
+	
+	Worker += Inc + 1;
+	
+	/*Get ObjectDescription.*/
+	snprintf(Status->ObjectDescription, sizeof Status->ObjectDescription, "%s", Worker);
+	
+	/*Retrieve the options.*/
+	while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) MemBus_WaitMessage(false);
+	
+	for (BinWorker = (void*)InBuf; *BinWorker != 0; ++BinWorker)
+	{
+		if (*BinWorker < COPT_MAX) Status->Opts[*BinWorker] = true; /*Skip what we don't understand.*/
+	}
+	
+	/*Get exit status mappings.*/
+	while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) MemBus_WaitMessage(false);
+
+	BinWorker = (void*)(InBuf + sizeof MEMBUS_CODE_LSOBJS " MXS");
+	Status->NumMXS = *BinWorker++; /*Get the count.*/
+	
+	if (Status->NumMXS > sizeof Status->MXS / sizeof *Status->MXS) Status->NumMXS = sizeof Status->MXS / sizeof *Status->MXS;
+	
+	for (Inc = 0; Inc < Status->NumMXS; ++Inc)
+	{
+		Status->MXS[Inc][0] = *BinWorker++;
+		Status->MXS[Inc][1] = *BinWorker++;
+	}
+	
+	snprintf(RLExpect, sizeof RLExpect, "%s %s %s", MEMBUS_CODE_LSOBJS, MEMBUS_LSOBJS_VERSION, Status->ObjectID);
+	
+	/*Done with this, now read runlevels.*/
+	while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) MemBus_WaitMessage(false);
+	
+	while (!strncmp(InBuf, RLExpect, strlen(RLExpect)))
+	{ /*Also causes the next object to be read.*/
+		const unsigned Length = strlen(Status->Runlevels);
+		
+		Worker = InBuf + strlen(MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION " ") + strlen(Status->ObjectID) + 1;
+		
+		snprintf(Status->Runlevels + Length, sizeof Status->Runlevels - Length, " %s", Worker);
+		
+		while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) MemBus_WaitMessage(false);
+	}
+	
+	return true;
+}
+
+static const unsigned char *UnpackObjectStatus(const unsigned char *Record, struct _ObjStatus *Status)
+{ /*Decode one V5 LSBULK record. See MemBus_PackObject() for the layout. Returns the record after it.*/
+	const unsigned char *BinWorker = Record;
+	unsigned short Length = 0;
+	unsigned char NumOpts = 0, StopMode = 0;
+	unsigned Inc = 0;
+	
+	memset(Status, 0, sizeof(struct _ObjStatus));
+	
+	memcpy(&Length, BinWorker, sizeof(short));
+	BinWorker += sizeof(short);
+	
+	Status->Started = *BinWorker++;
+	Status->Running = *BinWorker++;
+	Status->Enabled = *BinWorker++;
+	Status->TermSignal = *BinWorker++;
+	Status->ReloadCommandSignal = *BinWorker++;
+	StopMode = *BinWorker++;
+	Status->StopMode = (enum _StopMode)StopMode;
+	Status->RLTruncated = (*BinWorker++ & LSBULK_RLTRUNCATED) != 0;
+	
+	memcpy(&Status->UserID, BinWorker, sizeof(int));
+	memcpy(&Status->GroupID, (BinWorker += sizeof(int)), sizeof(int));
+	memcpy(&Status->PID, (BinWorker += sizeof(int)), sizeof(int));
+	memcpy(&Status->StartedSince, (BinWorker += sizeof(int)), sizeof(int));
+	memcpy(&Status->StopTimeout, (BinWorker += sizeof(int)), sizeof(int));
+	BinWorker += sizeof(int);
+	
+	for (NumOpts = *BinWorker++; NumOpts; --NumOpts, ++BinWorker)
+	{
+		if (*BinWorker < COPT_MAX) Status->Opts[*BinWorker] = true;
+	}
+	
+	Status->NumMXS = *BinWorker++;
+	
+	for (Inc = 0; Inc < Status->NumMXS; ++Inc)
+	{ /*The server never has more than fit here.*/
+		Status->MXS[Inc][0] = *BinWorker++;
+		Status->MXS[Inc][1] = *BinWorker++;
+	}
+	
+	snprintf(Status->ObjectID, sizeof Status->ObjectID, "%s", (const char*)BinWorker);
+	BinWorker += strlen((const char*)BinWorker) + 1;
+	
+	snprintf(Status->ObjectDescription, sizeof Status->ObjectDescription, "%s", (const char*)BinWorker);
+	BinWorker += strlen((const char*)BinWorker) + 1;
+	
+	for (; *BinWorker; BinWorker += strlen((const char*)BinWorker) + 1)
+	{
+		const unsigned RLLength = strlen(Status->Runlevels);
+		
+		snprintf(Status->Runlevels + RLLength, sizeof Status->Runlevels - RLLength, " %s", (const char*)BinWorker);
+	}
+	
+	/*Anything past the runlevels is from a newer Epoch than us, so we skip it.*/
+	return Record + Length;
+}
+
 static ReturnCode HandleEpochCommand(int argc, char **argv)
 {
 	const char *CArg = argv[1];
@@ -637,7 +922,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		while (shmget(MEMKEY, MEMBUS_SIZE, 0660) == -1) usleep(100); /*Then wait for it to start...*/
 		InitMemBus(false);
 
-		while (!MemBus_Read(InStream, false)) usleep(100);
+		while (!MemBus_Read(InStream, false)) MemBus_WaitMessage(false);
 		
 		if (!strcmp(InStream, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_RXD))
 		{
@@ -677,7 +962,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			return FAILURE;
 		}
 		
-		while (!MemBus_Read(TRecv, false)) usleep(1000);
+		while (!MemBus_Read(TRecv, false)) MemBus_WaitMessage(false);
 		
 		snprintf(TBuf[0], sizeof TBuf[0], "%s %s", MEMBUS_CODE_ACKNOWLEDGED, MEMBUS_CODE_RESET);
 		snprintf(TBuf[1], sizeof TBuf[1], "%s %s", MEMBUS_CODE_FAILURE, MEMBUS_CODE_RESET);
@@ -714,301 +999,128 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 	}
 	else if (ArgIs("status") || ArgIs("statusnc"))
 	{
-		char OutBuf[MEMBUS_MSGSIZE], InBuf[MEMBUS_MSGSIZE];
-		char *Worker = NULL;
-		const char *const YN[2][3] = { { "No", "Yes", "N/A" },
-									{ CONSOLE_COLOR_RED "No" CONSOLE_ENDCOLOR,
-									CONSOLE_COLOR_GREEN "Yes" CONSOLE_ENDCOLOR,
-									CONSOLE_COLOR_YELLOW "N/A" CONSOLE_ENDCOLOR } };
+		char OutBuf[MEMBUS_MSGSIZE], InBuf[MEMBUS_MSGSIZE], *Frame = NULL;
+		struct _ObjStatus Status;
 		unsigned Inc = 2;
 		int Stopper = argc > 2 ? argc : 3;
 		const Bool UseColor = ArgIs("status");
+		Bool Bulk = true; /*Until an older Epoch tells us it doesn't know LSBULK.*/
 		
 		if (!InitMemBus(false))
 		{
 			return FAILURE;
 		}
 		
+		Frame = malloc(MemBus.MsgSize); /*LSBULK replies can be as big as our slot allows.*/
+		
 		for (; Inc < Stopper; ++Inc)
 		{
+			unsigned Found = 0;
 			
-			/*Send the activation code.*/
-			if (argc > 2)
-			{
-				snprintf(OutBuf, sizeof OutBuf, "%s %s", MEMBUS_CODE_LSOBJS, argv[Inc]);
-			}
-			else
-			{
-				strncpy(OutBuf, MEMBUS_CODE_LSOBJS, strlen(MEMBUS_CODE_LSOBJS) + 1);
-			}
-			
-			MemBus_Write(OutBuf, false);
-			
-			while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-	
-			if (!strcmp(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS, InBuf))
-			{
-				puts(argc < 3 ? "No objects found!" : "Specified object not found.");
-				ShutdownMemBus(false);
-				return FAILURE;
-			}
-			
-			while (strcmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS) != 0)
-			{
-				Bool FoundRL = false;
-				unsigned PID = 0;
-				Bool Started = false, Running = false, Enabled = false, PivotRoot = false, Persistent = false, Exec = false;
-				enum _StopMode StopMode;
-				unsigned char TermSignal = 0, ReloadCommandSignal = 0, *BinWorker = NULL;
-				unsigned StartedSince, UserID, GroupID, Inc = 0, StopTimeout;
-				Bool HaltCmdOnly = false, IsService = false, AutoRestart = false, NoStopWait = false, NoTrack = false;
-				Bool ForceShell = false, RawDescription = false, Fork = false, RunOnce = false, ForkScanOnce = false;
-				Bool StartFailIsCritical = false, StopFailIsCritical = false, OptNewline = false;
-				char RLExpect[MEMBUS_MSGSIZE], ObjectID[MAX_DESCRIPT_SIZE], ObjectDescription[MAX_DESCRIPT_SIZE];
-				
-				Worker = InBuf + strlen(MEMBUS_CODE_LSOBJS " ");
-				
-				/*Version matters.*/
-				if (strncmp(Worker, MEMBUS_LSOBJS_VERSION, strlen(MEMBUS_LSOBJS_VERSION)) != 0)
+			if (Bulk)
+			{ /*One message carries as many objects as fit.*/
+				if (argc > 2)
 				{
-					SpitError("LSOBJS protocol version mismatch. Expected \"" MEMBUS_LSOBJS_VERSION "\".");
-					
-					while (strcmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS) != 0)
-					{ /*Don't mess up the membus, let it empty.*/
-						while (!MemBus_Read(InBuf, false)) usleep(10);
-					}
-					
-					ShutdownMemBus(false);
-					return FAILURE;
+					snprintf(OutBuf, sizeof OutBuf, "%s %s", MEMBUS_CODE_LSOBJS_BULK, argv[Inc]);
 				}
-				
-				Worker += strlen(MEMBUS_LSOBJS_VERSION) + 1;
-				
-				BinWorker = (void*)Worker;
-				
-				Started = *BinWorker++;
-				Running = *BinWorker++;
-				Enabled = *BinWorker++;
-				TermSignal = *BinWorker++;
-				ReloadCommandSignal = *BinWorker++;
-	
-				/*Remove this line when we make use of ReloadCommandSignal.*/
-				(void)ReloadCommandSignal;
-				
-				memcpy(&UserID, BinWorker, sizeof(int));
-				memcpy(&GroupID, (BinWorker += sizeof(int)), sizeof(int));
-				
-				memcpy(&StopMode, (BinWorker += sizeof(int)), sizeof(enum _StopMode));
-				memcpy(&PID, (BinWorker += sizeof(enum _StopMode)), sizeof(int));
-				
-				memcpy(&StartedSince, (BinWorker += sizeof(int)), sizeof(int));
-				memcpy(&StopTimeout, BinWorker + sizeof(int), sizeof(int));
-	
-				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-				
-				for (Worker = InBuf, Inc = 0; Worker[Inc] != ' '; ++Inc)
-				{ /*Get ObjectID*/
-					ObjectID[Inc] = Worker[Inc];
-				}
-				ObjectID[Inc] = '\0';
-				
-				Worker += Inc + 1;
-				
-				/*Get ObjectDescription.*/
-				strncpy(ObjectDescription, Worker, strlen(Worker) + 1);
-				
-				/*Retrieve the options.*/
-				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-				
-				for (Worker = InBuf; *Worker != 0; ++Worker)
+				else
 				{
-					if (*(unsigned char*)Worker >= COPT_MAX) continue; /*If we don't understand.*/
-	
-					switch (*(unsigned char*)Worker)
-					{
-						case COPT_HALTONLY:
-							HaltCmdOnly = true;
-							break;
-						case COPT_PERSISTENT:
-							Persistent = true;
-							break;
-						case COPT_FORK:
-							Fork = true;
-							break;
-						case COPT_FORKSCANONCE:
-							ForkScanOnce = true;
-							break;
-						case COPT_SERVICE:
-							IsService = true;
-							break;
-						case COPT_RAWDESCRIPTION:
-							RawDescription = true;
-							break;
-						case COPT_AUTORESTART:
-							AutoRestart = true;
-							break;
-						case COPT_FORCESHELL:
-							ForceShell = true;
-							break;
-						case COPT_NOSTOPWAIT:
-							NoStopWait = true;
-							break;
-						case COPT_NOTRACK:
-							NoTrack = true;
-							break;
-						case COPT_STARTFAILCRITICAL:
-							StartFailIsCritical = true;
-							break;
-						case COPT_STOPFAILCRITICAL:
-							StopFailIsCritical = true;
-							break;
-						case COPT_EXEC:
-							Exec = true;
-							break;
-						case COPT_PIVOTROOT:
-							PivotRoot = true;
-							break; 
-						case COPT_RUNONCE:
-							RunOnce = true;
-							break;
-						default:
-							break;
-					}
+					snprintf(OutBuf, sizeof OutBuf, "%s", MEMBUS_CODE_LSOBJS_BULK);
 				}
-			
-			
-				printf("ObjectID: %s\nObjectDescription: %s\nEnabled: %s | Started: %s | Running: %s | Stop mode: ",
-						ObjectID, ObjectDescription, YN[UseColor][Enabled],
-						HaltCmdOnly || PivotRoot || Exec ? YN[UseColor][2] : YN[UseColor][Started],
-						HaltCmdOnly || PivotRoot || Exec ? YN[UseColor][2] : YN[UseColor][Running]);
 				
-				if (StopMode == STOP_COMMAND) printf("Command");
-				else if (StopMode == STOP_NONE) printf("None");
-				else if (StopMode == STOP_PID) printf("PID");
-				else if (StopMode == STOP_PIDFILE) printf("PID File");
+				MemBus_Write(OutBuf, false);
 				
-				if (Running)
-				{
-					printf(" | PID: %u\n", PID);
-				}
-				else
-				{
-					putchar('\n');
-				}
+				while (!MemBus_BinRead(Frame, MemBus.MsgSize, false)) MemBus_WaitMessage(false);
 				
-				if (Started)
+				if (!strncmp(Frame, MEMBUS_CODE_BADPARAM " ", sizeof MEMBUS_CODE_BADPARAM))
+				{ /*Old Epoch. Do it the V4 way from now on.*/
+					Bulk = false;
+				}
+				else for (;;)
 				{
-					time_t SS = (time_t)StartedSince, CTime = time(NULL);
-					struct tm TStruct;
-					char TimeBuf[64] = { '\0' };
-					unsigned Offset = (CTime - StartedSince) / 60;
-					localtime_r(&SS, &TStruct);
+					const unsigned char *BinWorker = (void*)(Frame + sizeof MEMBUS_CODE_LSOBJS_BULK " " MEMBUS_LSOBJS_BULK_VERSION);
+					unsigned short Count = 0;
+					Bool Final = false;
 					
-					asctime_r(&TStruct, TimeBuf);
+					if (strcmp(Frame, MEMBUS_CODE_LSOBJS_BULK " " MEMBUS_LSOBJS_BULK_VERSION) != 0)
+					{
+						SpitError("LSBULK protocol version mismatch. Expected \"" MEMBUS_LSOBJS_BULK_VERSION "\".");
+						ShutdownMemBus(false);
+						free(Frame);
+						return FAILURE;
+					}
 					
-					TimeBuf[strlen(TimeBuf) - 1] = '\0'; /*Nuke newline.*/
-					printf("Started since %s, for total of %u mins.\n", TimeBuf, Offset);
-				}
-				
-				if (IsService || AutoRestart || HaltCmdOnly || Persistent || Fork || StopTimeout != 10 || NoTrack ||
-					ForceShell || RawDescription || NoStopWait || PivotRoot || RunOnce || TermSignal != SIGTERM || Exec ||
-					StartFailIsCritical || StopFailIsCritical)
-				{
-					printf("Options:");
+					Final = *BinWorker++;
+					memcpy(&Count, BinWorker, sizeof(short));
+					BinWorker += sizeof(short);
 					
-					if (IsService) printf(" SERVICE");
-					if (AutoRestart) printf(" AUTORESTART");
-					if (HaltCmdOnly) printf(" HALTONLY");
-					if (Persistent) printf(" PERSISTENT");
-					if (ForceShell) printf(" FORCESHELL");
-					if (Fork)
+					for (; Count; --Count, ++Found)
 					{
-						if (ForkScanOnce) printf(" FORKN");
-						else printf(" FORK");
+						BinWorker = UnpackObjectStatus(BinWorker, &Status);
+						
+						PrintObjectStatus(&Status, UseColor);
+						
+						if (argc == 2)
+						{
+							puts("-------");
+						}
 					}
-					if (RawDescription) printf(" RAWDESCRIPTION");
-					if (TermSignal != SIGTERM) printf(" TERMSIGNAL=%u", TermSignal);
-					if (NoStopWait) printf(" NOSTOPWAIT");
-					if (PivotRoot) printf(" PIVOT");
-					if (Exec) printf(" EXEC");
-					if (RunOnce) printf(" RUNONCE");
-					if (NoTrack) printf(" NOTRACK");
-					if (StartFailIsCritical) printf( "STARTFAILCRITICAL");
-					if (StopFailIsCritical) printf( "STOPFAILCRITICAL");
-					if (StopTimeout != 10) printf(" STOPTIMEOUT=%u", StopTimeout);
 					
-					OptNewline = true;
+					if (Final) break;
+					
+					while (!MemBus_BinRead(Frame, MemBus.MsgSize, false)) MemBus_WaitMessage(false);
 				}
-	
-				/*Get exit status mappings.*/
-				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-	
-				BinWorker = (void*)(InBuf + sizeof MEMBUS_CODE_LSOBJS " MXS");
-				Inc = *BinWorker++; /*Get the count.*/
-				
-				if (Inc > 0) OptNewline = true;
-				
-				for (; Inc; --Inc)
+			}
+			
+			if (!Bulk)
+			{
+				/*Send the activation code.*/
+				if (argc > 2)
 				{
-					const char *Stringy = NULL;
-					unsigned char Value = *BinWorker++, ExitStatus = *BinWorker++;
-					
-					if (Value == SUCCESS) Stringy = "SUCCESS";
-					else if (Value == WARNING) Stringy = "WARNING";
-					else if (Value == FAILURE) Stringy = "FAILURE";
-					else Stringy = "<BAD>";
-					
-					printf(" MAPEXITSTATUS=%d,%s", ExitStatus, Stringy);
+					snprintf(OutBuf, sizeof OutBuf, "%s %s", MEMBUS_CODE_LSOBJS, argv[Inc]);
+				}
+				else
+				{
+					strncpy(OutBuf, MEMBUS_CODE_LSOBJS, strlen(MEMBUS_CODE_LSOBJS) + 1);
 				}
 				
-				if (OptNewline) putchar('\n');
-				
-				snprintf(RLExpect, sizeof RLExpect, "%s %s %s", MEMBUS_CODE_LSOBJS, MEMBUS_LSOBJS_VERSION, ObjectID);
+				MemBus_Write(OutBuf, false);
 				
-				/*Done with this, now read runlevels.*/
-				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
+				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) MemBus_WaitMessage(false);
 				
-				while (!strncmp(InBuf, RLExpect, strlen(RLExpect)))
-				{ /*Also causes the next object to be read.*/
-					if (!FoundRL && !HaltCmdOnly)
+				for (; strcmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS) != 0; ++Found)
+				{
+					if (!ReadObjectStatusV4(InBuf, &Status))
 					{
-						printf("Runlevels:");
-						FoundRL = true;
+						ShutdownMemBus(false);
+						free(Frame);
+						return FAILURE;
 					}
 					
-					Worker = InBuf + strlen(MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION " ") + strlen(ObjectID) + 1;
+					PrintObjectStatus(&Status, UseColor);
 					
-					if (!HaltCmdOnly)
+					if (argc == 2)
 					{
-						printf(" %s", Worker);
+						puts("-------");
 					}
-					
-					while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-				}
-				
-				if (FoundRL) putchar('\n');
-				
-				if (UserID || GroupID)
-				{
-					struct passwd *UserStruct = getpwuid(UserID);
-					struct group *GroupStruct = getgrgid(GroupID);
-					
-					if (UserStruct) printf("User: %s\n", UserStruct->pw_name);
-					if (GroupStruct && GroupID != 0) printf("Group: %s\n", GroupStruct->gr_name);
-				}
-				
-				if (argc == 2)
-				{
-					puts("-------");
 				}
 			}
 			
+			if (!Found)
+			{
+				puts(argc < 3 ? "No objects found!" : "Specified object not found.");
+				ShutdownMemBus(false);
+				free(Frame);
+				return FAILURE;
+			}
+			
 			if (argc > 3)
 			{
 				puts("-------");
 			}
 		}
 		ShutdownMemBus(false);
+		free(Frame);
 		return SUCCESS;
 	}
 	else if (ArgIs("runlevel"))
@@ -1032,7 +1144,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		{
 			MemBus_Write(MEMBUS_CODE_GETRL, false);
 			
-			while (!MemBus_Read(InBuf, false)) usleep(1000);
+			while (!MemBus_Read(InBuf, false)) MemBus_WaitMessage(false);
 			
 			if (!strcmp(MEMBUS_CODE_BADPARAM " " MEMBUS_CODE_GETRL, InBuf))
 			{
@@ -1062,7 +1174,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			
 			MemBus_Write(OutBuf, false);
 			
-			while (!MemBus_Read(InBuf, false)) usleep(1000);
+			while (!MemBus_Read(InBuf, false)) MemBus_WaitMessage(false);
 			
 			if (!strcmp(PossibleResponses[0], InBuf))
 			{
@@ -1088,6 +1200,45 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		ShutdownMemBus(false);
 		return RV;
 	}
+	else if (ArgIs("launcher"))
+	{
+		char InBuf[MEMBUS_MSGSIZE];
+		ReturnCode RV = SUCCESS;
+		
+		if (argc > 2)
+		{
+			puts("Too many arguments.");
+			PrintEpochHelp(argv[0], "launcher");
+			return FAILURE;
+		}
+		
+		if (!InitMemBus(false))
+		{
+			return FAILURE;
+		}
+		
+		MemBus_Write(MEMBUS_CODE_LAUNCHER, false);
+		
+		while (!MemBus_Read(InBuf, false)) MemBus_WaitMessage(false);
+		
+		if (!strncmp(MEMBUS_CODE_LAUNCHER " ", InBuf, strlen(MEMBUS_CODE_LAUNCHER " ")))
+		{
+			puts(InBuf + strlen(MEMBUS_CODE_LAUNCHER " "));
+		}
+		else if (!strcmp(MEMBUS_CODE_BADPARAM " " MEMBUS_CODE_LAUNCHER, InBuf))
+		{
+			SpitError("The running Epoch is too old to report its launcher.");
+			RV = FAILURE;
+		}
+		else
+		{
+			SpitError("We have received a corrupted response over the membus.\nThis is a bug. Please report.");
+			RV = FAILURE;
+		}
+		
+		ShutdownMemBus(false);
+		return RV;
+	}
 	else if (ArgIs("merge") || ArgIs("unmerge"))
 	{
 		const char *const ArgType = ArgIs("merge") ? "merge" : "unmerge";
@@ -1137,7 +1288,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			return FAILURE;
 		}
 		
-		while (!MemBus_Read(Msg, false)) usleep(1000);
+		while (!MemBus_Read(Msg, false)) MemBus_WaitMessage(false);
 		
 		ShutdownMemBus(false); //We're done with membus now.
 		
@@ -1373,7 +1524,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			
 			MemBus_Write(OutBuf, false);
 			
-			while (!MemBus_Read(InBuf, false)) usleep(1000);
+			while (!MemBus_Read(InBuf, false)) MemBus_WaitMessage(false);
 			
 			if (!strcmp(InBuf, PossibleResponses[0]))
 			{
@@ -1443,7 +1594,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		
 		MemBus_Write(OutBuf, false);
 		
-		while (!MemBus_Read(InBuf, false)) usleep(1000);
+		while (!MemBus_Read(InBuf, false)) MemBus_WaitMessage(false);
 		
 		if (!strncmp(InBuf, PossibleResponses[0], strlen(PossibleResponses[0])))
 		{
@@ -1501,7 +1652,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		
 		MemBus_Write(OutBuf, false);
 		
-		while (!MemBus_Read(InBuf, false)) usleep(1000);
+		while (!MemBus_Read(InBuf, false)) MemBus_WaitMessage(false);
 		
 		if (!strcmp(InBuf, PossibleResponses[0]))
 		{
@@ -1584,7 +1735,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			return FAILURE;
 		}
 		
-		while (!MemBus_Read(IBuf, false)) usleep(1000);
+		while (!MemBus_Read(IBuf, false)) MemBus_WaitMessage(false);
 		
 		if (ArgIs("add") || ArgIs("del"))
 		{	
@@ -1908,7 +2059,7 @@ int main(int argc, char **argv)
 				return 1;
 			}
 			
-			while (!MemBus_Read(MembusResponse, false)) usleep(1000);
+			while (!MemBus_Read(MembusResponse, false)) MemBus_WaitMessage(false);
 			
 			if (!strcmp(MembusResponse, PossibleResponses[0]))
 			{
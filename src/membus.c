@@ -7,16 +7,28 @@
  * shared memory communication system
  * and it's extremely simple protocol,
  * called the "membus".
+ * It also runs the control socket,
+ * which speaks the same language.
  * **/
- 
+
+#define _GNU_SOURCE /*For struct ucred and accept4().*/
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <sys/reboot.h>
 #include <time.h>
 #include "epoch.h"
@@ -29,16 +41,182 @@ Bool BusRunning;
 int MemBusKey = MEMKEY;
 int MemDescriptor;
 
+/*Control socket. Clients there get the same treatment as membus clients.*/
+static int ControlDescriptor = -1;
+static int ControlClients[CONTROL_MAX_CLIENTS];
+static unsigned NumControlClients;
+static int ControlReply = -1; /*Who we're answering, or -1 if they hung up on us.*/
+static Bool ControlReplying; /*Set while a control socket message is being handled, so replies go there.*/
+
+static void ParseMemBusMessage(char *BusData);
+static Bool ControlSock_Open(void);
+static void ControlSock_Close(void);
+static void ControlSock_Service(void);
+static void ControlSock_Knock(void);
+
+static void MemBus_Signal(unsigned *Futex)
+{ /*Tell anyone sleeping on this status byte that it changed.*/
+	if (!Futex) return;
+	
+	__sync_fetch_and_add(Futex, 1);
+	syscall(SYS_futex, Futex, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+
+static void MemBus_Nap(const unsigned char *Status, unsigned char Value, Bool UntilEqual, unsigned *Futex, int Timeout)
+{ /*Sleep until *Status becomes (or stops being) Value, or Timeout milliseconds pass.
+	* Callers loop around us, so waking up early is harmless.*/
+	struct timespec Time = { Timeout / 1000, (Timeout % 1000) * 1000000 };
+	unsigned Seq;
+	
+	if (!Futex)
+	{ /*Old bus, old ways.*/
+		usleep(100);
+		return;
+	}
+	
+	Seq = *(volatile unsigned*)Futex;
+	__sync_synchronize(); /*Read the sequence before the status, so we can't miss a change in between.*/
+	
+	if ((*(volatile const unsigned char*)Status == Value) == UntilEqual) return;
+	
+	syscall(SYS_futex, Futex, FUTEX_WAIT, Seq, &Time, NULL, 0);
+}
+
+static unsigned MemBus_ChannelSize(unsigned FrameSize)
+{ /*One direction of a slot after slot 0: futex, length, status byte, then the message.*/
+	return (sizeof(unsigned) * 2 + 1 + FrameSize + 7) & ~7u;
+}
+
+static void MemBus_SelectSlot(unsigned Slot)
+{ /*Point MemBus at one client's slot. Slot 0 keeps the offsets it always had.*/
+	unsigned char *SlotRoot = MemBus.Root;
+	
+	MemBus.CurSlot = Slot;
+	
+	if (Slot > 0)
+	{
+		SlotRoot += MEMBUS_LEGACY_SIZE + (Slot - 1) * MemBus.Header->SlotSize;
+	}
+	
+	/*Status.*/
+	MemBus.LockPID = (unsigned long*)SlotRoot;
+	MemBus.LockTime = (unsigned long*)(SlotRoot + sizeof(long));
+	
+	if (Slot == 0)
+	{
+		/*Server side.*/
+		MemBus.Server.Status = SlotRoot + sizeof(long) * 2;
+		
+		/*Client side.*/
+		MemBus.Client.Status = SlotRoot + sizeof(long) * 2 + MEMBUS_SIZE/2;
+		
+		MemBus.Server.Futex = MemBus.Header ? &MemBus.Header->Futex[0] : NULL;
+		MemBus.Client.Futex = MemBus.Header ? &MemBus.Header->Futex[1] : NULL;
+		MemBus.Server.Length = MemBus.Client.Length = NULL;
+		MemBus.MsgSize = MEMBUS_MSGSIZE;
+	}
+	else
+	{ /*Length-prefixed, and as big as the server said.*/
+		const unsigned ChannelSize = MemBus_ChannelSize(MemBus.Header->FrameSize);
+		
+		MemBus.Server.Futex = (unsigned*)(SlotRoot + sizeof(long) * 2);
+		MemBus.Server.Length = MemBus.Server.Futex + 1;
+		MemBus.Server.Status = (unsigned char*)(MemBus.Server.Length + 1);
+		
+		MemBus.Client.Futex = (unsigned*)((unsigned char*)MemBus.Server.Futex + ChannelSize);
+		MemBus.Client.Length = MemBus.Client.Futex + 1;
+		MemBus.Client.Status = (unsigned char*)(MemBus.Client.Length + 1);
+		
+		MemBus.MsgSize = MemBus.Header->FrameSize;
+	}
+	
+	MemBus.Server.BinMessage = MemBus.Server.Status + 1;
+	MemBus.Server.Message = (char*)MemBus.Server.BinMessage;
+	MemBus.Client.BinMessage = MemBus.Client.Status + 1;
+	MemBus.Client.Message = (char*)MemBus.Client.BinMessage;
+}
+
+static unsigned MemBus_PickFrameSize(void)
+{ /*Big enough for LSBULK to list every object we have in one go, within reason.*/
+	const ObjTable *Worker = ObjectTable;
+	unsigned FrameSize = 0;
+	
+	for (; Worker && Worker->Next; Worker = Worker->Next) FrameSize += MEMBUS_FRAME_PEROBJ;
+	
+	if (FrameSize < MEMBUS_FRAME_SIZE) FrameSize = MEMBUS_FRAME_SIZE;
+	else if (FrameSize > MEMBUS_FRAME_MAX) FrameSize = MEMBUS_FRAME_MAX;
+	
+	return FrameSize;
+}
+
+static void MemBus_ResetSlot(void)
+{ /*Forget whatever the last owner of the current slot left behind.*/
+	*MemBus.Server.Status = MEMBUS_NOMSG;
+	*MemBus.Server.Message = '\0';
+	*MemBus.Client.Status = MEMBUS_NOMSG;
+	*MemBus.Client.Message = '\0';
+	*MemBus.LockTime = 0;
+	*MemBus.LockPID = 0;
+	
+	MemBus_Signal(MemBus.Server.Futex);
+	MemBus_Signal(MemBus.Client.Futex);
+}
+
+static Bool MemBus_ClaimSlot(void)
+{ /*Find a free slot, or one whose owner died on us, and take it atomically.*/
+	const unsigned long OurPID = getpid();
+	unsigned Inc = 1;
+	
+	for (; Inc <= MemBus.NumSlots; ++Inc)
+	{ /*Slot 0 goes last. It has the smallest messages, and it's the only one old clients can use.*/
+		unsigned long Owner;
+		
+		MemBus_SelectSlot(Inc % MemBus.NumSlots);
+		
+		if ((Owner = *MemBus.LockPID) == OurPID) return true;
+		
+		if (Owner != 0 && (kill(Owner, 0) == 0 || errno != ESRCH))
+		{ /*Taken, and whoever has it is still around.*/
+			continue;
+		}
+		
+		if (__sync_bool_compare_and_swap(MemBus.LockPID, Owner, OurPID))
+		{
+			*MemBus.LockTime = time(NULL);
+			
+			if (Owner != 0)
+			{ /*Clean up after the dead one.*/
+				*MemBus.Server.Status = MEMBUS_NOMSG;
+				*MemBus.Client.Status = MEMBUS_NOMSG;
+				MemBus_Signal(MemBus.Server.Futex);
+			}
+			
+			return true;
+		}
+	}
+	
+	return false;
+}
+
 ReturnCode InitMemBus(Bool ServerSide)
 { /*Fire up the memory bus.*/
 	char CheckCode = 0;
-	unsigned Inc = 0;
+	unsigned Inc = 0, FrameSize = 0, SlotSize = 0;
+	struct shmid_ds BusInfo;
 
 	if (BusRunning) return SUCCESS;
 	
 	memset(&MemBus, 0, sizeof(struct _MemBusInterface));
 	
-	if ((MemDescriptor = shmget((key_t)MemBusKey, MEMBUS_SIZE + sizeof(long) * 2, (ServerSide ? (IPC_CREAT | 0660) : 0660))) < 0)
+	if (ServerSide)
+	{ /*Slot 0 is fixed, the rest are as big as we want them.*/
+		FrameSize = MemBus_PickFrameSize();
+		SlotSize = sizeof(long) * 2 + MemBus_ChannelSize(FrameSize) * 2;
+	}
+	
+	/*Clients ask for size 0 so they can still talk to an older Epoch with a smaller bus.*/
+	if ((MemDescriptor = shmget((key_t)MemBusKey, (ServerSide ? MEMBUS_LEGACY_SIZE + (MEMBUS_SLOTS - 1) * SlotSize : 0),
+								(ServerSide ? (IPC_CREAT | 0660) : 0660))) < 0)
 	{
 		if (ServerSide) SpitError("InitMemBus(): Failed to allocate memory bus."); /*should probably use perror*/
 		else SpitError("InitMemBus(): Failed to connect to memory bus.\n\n"
@@ -61,29 +239,31 @@ ReturnCode InitMemBus(Bool ServerSide)
 		return FAILURE;
 	}
 	
-	/*Status.*/
-	MemBus.LockPID = MemBus.Root;
-	MemBus.LockTime = (unsigned long*) ((char*)MemBus.Root + sizeof(long));
-	
-	/*Server side.*/
-	MemBus.Server.Status = (unsigned char*)MemBus.Root + sizeof(long) * 2;
-	MemBus.Server.BinMessage = MemBus.Server.Status + 1;
-	MemBus.Server.Message = (char*)MemBus.Server.BinMessage;
-	
-	/*Client side.*/
-	MemBus.Client.Status = (unsigned char*)MemBus.Root + sizeof(long) * 2 + MEMBUS_SIZE/2;
-	MemBus.Client.BinMessage = MemBus.Client.Status + 1;
-	MemBus.Client.Message = (char*)MemBus.Client.BinMessage;
+	/*Until we know better, it's an old single-client bus.*/
+	MemBus.NumSlots = 1;
+	MemBus_SelectSlot(0);
 	
 	if (ServerSide) /*Don't nuke messages on startup if we aren't init.*/
 	{
-		memset((void*)MemBus.Root, 0, MEMBUS_SIZE); /*Zero it out just to be neat. Probably don't really need this.*/
+		MemBus.Header = (void*)((char*)MemBus.Root + MEMBUS_HEADER_OFFSET);
+		memset(MemBus.Header, 0, sizeof(struct _MemBusHeader));
 		
-		*MemBus.Server.Status = MEMBUS_NOMSG; /*Set to no message by default.*/
+		MemBus.Header->NumSlots = MemBus.NumSlots = MEMBUS_SLOTS;
+		MemBus.Header->SlotSize = SlotSize;
+		MemBus.Header->FrameSize = FrameSize;
+		MemBus.Header->Magic = MEMBUS_MAGIC;
+		MemBus.Doorbell = &MemBus.Header->Doorbell;
+		
+		for (Inc = MemBus.NumSlots; Inc-- > 0;)
+		{ /*Set to no message by default. Slot 0 goes last, clients wait on it to know we're ready.
+			* We don't zero the whole thing, the pages nobody touches then cost us nothing.*/
+			MemBus_SelectSlot(Inc);
+			MemBus_ResetSlot();
+		}
 	}
 	else
 	{ /*Client side stuff.*/
-		for (; *MemBus.Server.Status != MEMBUS_NOMSG && *MemBus.Server.Status != MEMBUS_MSG; ++Inc)
+		for (; *(volatile unsigned char*)MemBus.Server.Status != MEMBUS_NOMSG && *MemBus.Server.Status != MEMBUS_MSG; ++Inc)
 		{ /*Wait for server-side to finish setting up its half, if it was just starting up itself.*/
 			if (Inc == 100000) /*Ten secs.*/
 			{
@@ -97,42 +277,68 @@ ReturnCode InitMemBus(Bool ServerSide)
 			usleep(100);
 		}
 		
-		/*Check the lock.*/
-		if (*MemBus.LockPID != 0 && *MemBus.LockPID != getpid())
+		if (shmctl(MemDescriptor, IPC_STAT, &BusInfo) == 0 && BusInfo.shm_segsz >= MEMBUS_LEGACY_SIZE &&
+			((struct _MemBusHeader*)((char*)MemBus.Root + MEMBUS_HEADER_OFFSET))->Magic == MEMBUS_MAGIC)
+		{ /*A server new enough to tell us how it laid things out.*/
+			struct _MemBusHeader *Header = (void*)((char*)MemBus.Root + MEMBUS_HEADER_OFFSET);
+			
+			if (Header->NumSlots > 0 && MEMBUS_LEGACY_SIZE + (Header->NumSlots - 1) * (size_t)Header->SlotSize <= BusInfo.shm_segsz)
+			{
+				MemBus.Header = Header;
+				MemBus.NumSlots = Header->NumSlots;
+				MemBus.Doorbell = &Header->Doorbell;
+				MemBus_SelectSlot(0);
+			}
+		}
+		
+		/*Get a slot of our own.*/
+		if (!MemBus_ClaimSlot())
 		{
-			SmallError("Another client is currently connected to the membus. Cannot continue!");
+			SmallError("All membus slots are in use by other clients. Cannot continue!");
 			BusRunning = false;
+			shmdt(MemBus.Root);
 			memset(&MemBus, 0, sizeof(struct _MemBusInterface));
 
 			return FAILURE;
 		}
 		
+		/*Init sleeps until something happens when nobody holds a slot. Now somebody does, so wake it.*/
+		if (MemBusKey == MEMKEY) ControlSock_Knock();
+		
+		/*Before the ping, not after. A server that answers the ping and writes right away must not have that erased.*/
+		*MemBus.Client.Status = MEMBUS_NOMSG;
+		
 		CheckCode = *MemBus.Server.Status = (*MemBus.Server.Status == MEMBUS_MSG ? MEMBUS_CHECKALIVE_MSG : MEMBUS_CHECKALIVE_NOMSG); /*Ask server-side if they're alive.*/
+		MemBus_Signal(MemBus.Doorbell);
 		
-		for (Inc = 0; *MemBus.Server.Status == CheckCode; ++Inc)
+		for (Inc = 0; *(volatile unsigned char*)MemBus.Server.Status == CheckCode; ++Inc)
 		{ /*Wait ten seconds for server-side to respond.*/
-			if (Inc == 100000)
+			if ((MemBus.Server.Futex ? Inc * MEMBUS_NAP_MSECS >= 10000 : Inc == 100000))
 			{ /*Ten seconds.*/
 				SmallError("Cannot connect to Epoch over MemBus, timeout expired. Aborting MemBus initialization.");
 				
+				*MemBus.Server.Status = MEMBUS_NOMSG;
+				*MemBus.LockPID = 0;
 				BusRunning = false;
 				memset(&MemBus, 0, sizeof(struct _MemBusInterface));
 
 				return FAILURE;
 			}
 			
-			usleep(100);
+			MemBus_Nap(MemBus.Server.Status, CheckCode, false, MemBus.Server.Futex, MEMBUS_NAP_MSECS);
 		}
 		
-		/*Acquire the lock.*/
-		*MemBus.LockPID = getpid();
+		/*Renew the lock.*/
 		*MemBus.LockTime = time(NULL);
-
-		*MemBus.Client.Status = MEMBUS_NOMSG;
 	}
 	/*Either the server side is alive, or we ARE the server side.*/
 	BusRunning = true;
 	
+	if (ServerSide && MemBusKey == MEMKEY && !ControlSock_Open())
+	{ /*Not fatal, the membus still works.*/
+		WriteLogLine("Unable to open the control socket. Only the membus will be available.", true);
+	}
+	
 	return SUCCESS;
 }
 
@@ -140,23 +346,35 @@ unsigned MemBus_BinWrite(const void *InStream_, unsigned DataSize, Bool ServerSi
 { /*Copies binary data of length DataSize to the membus.*/
 	const char *InStream = InStream_;
 	unsigned char *BusData = NULL, *BusStatus = NULL;
+	unsigned *BusFutex = NULL, *BusLength = NULL;
 	unsigned Inc = 0;
 	unsigned short WaitCount = 0;
 	
+	if (ServerSide && ControlReplying)
+	{ /*Answering someone on the control socket, not the membus.*/
+		Inc = DataSize < MemBus.MsgSize ? DataSize : MemBus.MsgSize;
+		
+		return ControlReply != -1 && send(ControlReply, InStream, Inc, MSG_NOSIGNAL) == Inc ? Inc : 0;
+	}
+	
 	if (ServerSide)
 	{
 		BusStatus = MemBus.Client.Status;
+		BusFutex = MemBus.Client.Futex;
+		BusLength = MemBus.Client.Length;
 	}
 	else
 	{
 		BusStatus = MemBus.Server.Status;
+		BusFutex = MemBus.Server.Futex;
+		BusLength = MemBus.Server.Length;
 	}
 	
 	BusData = BusStatus + 1;
 	
-	while (*BusStatus != MEMBUS_NOMSG) /*Wait ten secs for their last message to process.*/
+	while (*(volatile unsigned char*)BusStatus != MEMBUS_NOMSG) /*Wait ten secs for their last message to process.*/
 	{
-		usleep(1000); /*0.001 seconds.*/
+		MemBus_Nap(BusStatus, MEMBUS_NOMSG, true, BusFutex, 1); /*0.001 seconds at most.*/
 		++WaitCount;
 		
 		if (WaitCount == 10000)
@@ -165,12 +383,16 @@ unsigned MemBus_BinWrite(const void *InStream_, unsigned DataSize, Bool ServerSi
 		}
 	}
 	
-	for (; Inc < DataSize && Inc < MEMBUS_MSGSIZE; ++Inc)
-	{
-		BusData[Inc] = InStream[Inc];
-	}
+	Inc = DataSize < MemBus.MsgSize ? DataSize : MemBus.MsgSize;
+	
+	memcpy(BusData, InStream, Inc);
 	
+	if (BusLength) *BusLength = Inc;
+	
+	__sync_synchronize(); /*All of it must be there before they see the status change.*/
 	*BusStatus = MEMBUS_MSG;
+	MemBus_Signal(BusFutex);
+	if (!ServerSide) MemBus_Signal(MemBus.Doorbell);
 	
 	return Inc; /*Return number of bytes written.*/
 }
@@ -179,30 +401,45 @@ unsigned MemBus_BinRead(void *OutStream_, unsigned MaxOutSize, Bool ServerSide)
 {
 	unsigned char *BusStatus = NULL, *BusData = NULL;
 	unsigned char *OutStream = OutStream_;
+	const unsigned *BusLength = NULL;
 	unsigned Inc = 0;
 	
+	if (ServerSide && ControlReplying)
+	{
+		const ssize_t Received = ControlReply != -1 ? recv(ControlReply, OutStream, MaxOutSize, MSG_DONTWAIT) : 0;
+		
+		return Received > 0 ? Received : 0;
+	}
+	
 	if (ServerSide)
 	{
 		BusStatus = MemBus.Server.Status;
+		BusLength = MemBus.Server.Length;
 	}
 	else
 	{
 		BusStatus = MemBus.Client.Status;
+		BusLength = MemBus.Client.Length;
 	}
 	
 	BusData = BusStatus + 1;
 	
-	if (*BusStatus != MEMBUS_MSG)
+	if (*(volatile unsigned char*)BusStatus != MEMBUS_MSG)
 	{
 		return 0;
 	}
 	
-	for (; Inc < MaxOutSize && Inc < MEMBUS_MSGSIZE; ++Inc)
-	{
-		OutStream[Inc] = BusData[Inc];
-	}
+	__sync_synchronize();
+	
+	/*Slot 0 has no length, so it's always a full message like it used to be.*/
+	Inc = BusLength && *BusLength < MemBus.MsgSize ? *BusLength : MemBus.MsgSize;
+	
+	if (Inc > MaxOutSize) Inc = MaxOutSize;
+	
+	memcpy(OutStream, BusData, Inc);
 	
 	*BusStatus = MEMBUS_NOMSG;
+	MemBus_Signal(ServerSide ? MemBus.Server.Futex : MemBus.Client.Futex);
 	
 	return Inc;
 }
@@ -210,23 +447,33 @@ unsigned MemBus_BinRead(void *OutStream_, unsigned MaxOutSize, Bool ServerSide)
 ReturnCode MemBus_Write(const char *InStream, Bool ServerSide)
 {
 	unsigned char *BusStatus = NULL;
+	unsigned *BusFutex = NULL, *BusLength = NULL;
 	char *BusData = NULL;
 	unsigned short WaitCount = 0;
 	
+	if (ServerSide && ControlReplying)
+	{
+		return ControlReply != -1 && send(ControlReply, InStream, strlen(InStream) + 1, MSG_NOSIGNAL) != -1;
+	}
+	
 	if (ServerSide)
 	{
 		BusStatus = MemBus.Client.Status; /*This isn't a typo, we write to the opposite side.*/
+		BusFutex = MemBus.Client.Futex;
+		BusLength = MemBus.Client.Length;
 	}
 	else
 	{
 		BusStatus = MemBus.Server.Status;
+		BusFutex = MemBus.Server.Futex;
+		BusLength = MemBus.Server.Length;
 	}
 	
 	BusData = (char*)BusStatus + 1; /*Our actual data goes one byte after the status byte.*/
 	
-	while (*BusStatus != MEMBUS_NOMSG) /*Wait for them to finish eating their last message.*/
+	while (*(volatile unsigned char*)BusStatus != MEMBUS_NOMSG) /*Wait for them to finish eating their last message.*/
 	{
-		usleep(1000); /*0.001 seconds.*/
+		MemBus_Nap(BusStatus, MEMBUS_NOMSG, true, BusFutex, 1); /*0.001 seconds at most.*/
 		++WaitCount;
 		
 		if (WaitCount == 10000)
@@ -235,9 +482,14 @@ ReturnCode MemBus_Write(const char *InStream, Bool ServerSide)
 		}
 	}
 	
-	snprintf((char*)BusData, MEMBUS_MSGSIZE, "%s", InStream);
+	snprintf((char*)BusData, MEMBUS_MSGSIZE, "%s", InStream); /*Text stays small, whatever the slot. Readers use MEMBUS_MSGSIZE buffers.*/
+	
+	if (BusLength) *BusLength = strlen(BusData) + 1;
 	
+	__sync_synchronize();
 	*BusStatus = MEMBUS_MSG; /*Now we sent it.*/
+	MemBus_Signal(BusFutex);
+	if (!ServerSide) MemBus_Signal(MemBus.Doorbell);
 	
 	return SUCCESS;
 }
@@ -247,6 +499,19 @@ Bool MemBus_Read(char *OutStream, Bool ServerSide)
 	unsigned char *BusStatus = NULL;
 	char *BusData = NULL;
 	
+	if (ServerSide && ControlReplying)
+	{ /*Someone who hung up counts as having answered, or we'd wait on them forever.*/
+		ssize_t Received = 0;
+		
+		if (ControlReply != -1 && (Received = recv(ControlReply, OutStream, MEMBUS_MSGSIZE - 1, MSG_DONTWAIT)) == -1)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+		}
+		
+		OutStream[Received > 0 ? Received : 0] = '\0';
+		return true;
+	}
+	
 	if (ServerSide)
 	{
 		BusStatus = MemBus.Server.Status;
@@ -258,71 +523,498 @@ Bool MemBus_Read(char *OutStream, Bool ServerSide)
 	
 	BusData = (char*)BusStatus + 1;
 		
-	if (*BusStatus != MEMBUS_MSG)
+	if (*(volatile unsigned char*)BusStatus != MEMBUS_MSG)
 	{ /*No data? Quit.*/
 		return false;
 	}
 	
+	__sync_synchronize();
+	
 	snprintf(OutStream, MEMBUS_MSGSIZE, "%s", BusData);
 	
 	*BusStatus = MEMBUS_NOMSG; /*Set back to NOMSG once we got the message.*/
+	MemBus_Signal(ServerSide ? MemBus.Server.Futex : MemBus.Client.Futex);
 
 	return true;
 }
 
 Bool HandleMemBusPings(void)
-{ /*If we are pinged, we must initialize the client side immediately.*/
+{ /*If we are pinged, we must initialize the client side immediately.
+	* The slot of whoever pinged us is left selected, so the caller can answer them there.*/
+	unsigned Inc = 0, PingedSlot = 0;
+	Bool Pinged = false;
+	
 	if (!BusRunning) return false;
-
-	switch (*MemBus.Server.Status)
+	
+	for (; Inc < MemBus.NumSlots; ++Inc)
 	{
-		case MEMBUS_CHECKALIVE_MSG:
-			*MemBus.Server.Status = MEMBUS_MSG;
-			return true;
-			break;
-		case MEMBUS_CHECKALIVE_NOMSG:
-			*MemBus.Server.Status = MEMBUS_NOMSG;
-			return true;
-			break;
-		default:
-			break;
+		MemBus_SelectSlot(Inc);
+		
+		switch (*MemBus.Server.Status)
+		{
+			case MEMBUS_CHECKALIVE_MSG:
+				*MemBus.Server.Status = MEMBUS_MSG;
+				MemBus_Signal(MemBus.Server.Futex);
+				break;
+			case MEMBUS_CHECKALIVE_NOMSG:
+				*MemBus.Server.Status = MEMBUS_NOMSG;
+				MemBus_Signal(MemBus.Server.Futex);
+				break;
+			default:
+				continue;
+		}
+		
+		if (!Pinged) PingedSlot = Inc;
+		Pinged = true;
 	}
 	
-	return false;
+	MemBus_SelectSlot(PingedSlot);
+	
+	return Pinged;
 }
 
 Bool CheckMemBusIntegrity(void)
 {
+	unsigned Inc = 0;
+	Bool AllOK = true;
+	
 	if (!BusRunning) return true;
 	
-	if (*MemBus.LockPID == 0) return true;
+	for (; Inc < MemBus.NumSlots; ++Inc)
+	{
+		MemBus_SelectSlot(Inc);
+		
+		if (*MemBus.LockPID == 0) continue;
+		
+		if ((kill(*MemBus.LockPID, 0) == -1 && errno == ESRCH) || *MemBus.LockTime + 60 < time(NULL))
+		{ /*A dead client gets disconnected right away. Anything after a minute does too.*/
+			MemBus_ResetSlot();
+			AllOK = false;
+		}
+	}
+	
+	MemBus_SelectSlot(0);
 	
-	if (*MemBus.LockTime + 60 < time(NULL))
-	{ /*Anything after a minute needs to be disconnected.*/
-		*MemBus.Server.Status = MEMBUS_NOMSG;
-		*MemBus.Server.Message = '\0';
-		*MemBus.Client.Status = MEMBUS_NOMSG;
-		*MemBus.Client.Message = '\0';
-		*MemBus.LockTime = 0;
-		*MemBus.LockPID = 0;
+	return AllOK;	
+}
+
+Bool MemBus_Busy(void)
+{ /*Is any client connected or talking to us?*/
+	unsigned Inc = 0;
+	Bool Busy = false;
+	
+	if (!BusRunning) return false;
+	
+	for (; Inc < MemBus.NumSlots && !Busy; ++Inc)
+	{
+		MemBus_SelectSlot(Inc);
+		
+		Busy = *MemBus.LockPID != 0 || *MemBus.Server.Status != MEMBUS_NOMSG;
+	}
+	
+	MemBus_SelectSlot(0);
+	
+	return Busy;
+}
+
+void MemBus_WaitMessage(Bool ServerSide)
+{ /*Sleep until something is waiting for us to MemBus_Read() it. We may return early, so loop around this.*/
+	if (ServerSide && ControlReplying)
+	{
+		struct pollfd Watch = { ControlReply, POLLIN, 0 };
+		
+		if (ControlReply != -1) poll(&Watch, 1, MEMBUS_NAP_MSECS);
+	}
+	else if (ServerSide)
+	{
+		MemBus_Nap(MemBus.Server.Status, MEMBUS_MSG, true, MemBus.Server.Futex, MEMBUS_NAP_MSECS);
+	}
+	else
+	{
+		MemBus_Nap(MemBus.Client.Status, MEMBUS_MSG, true, MemBus.Client.Futex, MEMBUS_NAP_MSECS);
+	}
+}
+
+void MemBus_WaitDoorbell(int Timeout)
+{ /*Server side. Sleep until any client sends or pings us, or Timeout milliseconds pass.*/
+	struct timespec Time = { Timeout / 1000, (Timeout % 1000) * 1000000 };
+	unsigned Inc = 0, Seq;
+	
+	if (!BusRunning) return;
+	
+	if (!MemBus.Doorbell)
+	{
+		usleep(Timeout * 1000);
+		return;
+	}
+	
+	Seq = *(volatile unsigned*)MemBus.Doorbell;
+	__sync_synchronize();
+	
+	for (; Inc < MemBus.NumSlots; ++Inc)
+	{ /*Anything already there? Then don't bother sleeping.*/
+		MemBus_SelectSlot(Inc);
+		
+		if (*(volatile unsigned char*)MemBus.Server.Status != MEMBUS_NOMSG) break;
+	}
+	
+	MemBus_SelectSlot(0);
+	
+	if (Inc < MemBus.NumSlots) return;
+	
+	syscall(SYS_futex, MemBus.Doorbell, FUTEX_WAIT, Seq, &Time, NULL, 0);
+}
+
+static Bool ControlSock_Open(void)
+{ /*Listen on an abstract AF_UNIX socket too. Abstract, so it works before anything is mounted.*/
+	struct sockaddr_un Address;
+	const socklen_t AddressSize = offsetof(struct sockaddr_un, sun_path) + sizeof CONTROL_SOCKET_NAME; /*Leading NUL, no trailing one.*/
+	
+	if (ControlDescriptor != -1) return true;
+	
+	memset(&Address, 0, sizeof Address);
+	Address.sun_family = AF_UNIX;
+	memcpy(Address.sun_path + 1, CONTROL_SOCKET_NAME, sizeof CONTROL_SOCKET_NAME - 1);
+	
+	if ((ControlDescriptor = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+	{
 		return false;
 	}
 	
-	return true;	
+	if (bind(ControlDescriptor, (struct sockaddr*)&Address, AddressSize) == -1 || listen(ControlDescriptor, CONTROL_MAX_CLIENTS) == -1)
+	{
+		close(ControlDescriptor);
+		ControlDescriptor = -1;
+		return false;
+	}
+	
+	ControlSock_Watch();
+	
+	return true;
+}
+
+static void ControlSock_Knock(void)
+{ /*Client side. Connecting is enough to wake PrimaryLoop(), we have nothing to say over the socket itself.
+	* An Epoch too old to have the socket polls the membus anyway, so failing here is fine.*/
+	struct sockaddr_un Address;
+	const socklen_t AddressSize = offsetof(struct sockaddr_un, sun_path) + sizeof CONTROL_SOCKET_NAME;
+	int Descriptor = -1;
+	
+	memset(&Address, 0, sizeof Address);
+	Address.sun_family = AF_UNIX;
+	memcpy(Address.sun_path + 1, CONTROL_SOCKET_NAME, sizeof CONTROL_SOCKET_NAME - 1);
+	
+	if ((Descriptor = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) return;
+	
+	connect(Descriptor, (struct sockaddr*)&Address, AddressSize);
+	close(Descriptor);
+}
+
+static void ControlSock_Drop(unsigned Index)
+{ /*They hung up, or we're hanging up on them. Closing also takes them out of the epoll set.*/
+	if (ControlClients[Index] == ControlReply) ControlReply = -1;
+	
+	close(ControlClients[Index]);
+	ControlClients[Index] = ControlClients[--NumControlClients];
+}
+
+static void ControlSock_Close(void)
+{
+	while (NumControlClients > 0) ControlSock_Drop(NumControlClients - 1);
+	
+	if (ControlDescriptor != -1)
+	{
+		close(ControlDescriptor);
+		ControlDescriptor = -1;
+	}
+}
+
+static Bool ControlSock_Authorized(int Descriptor)
+{ /*Same rule as the membus' 0660 permissions: root, or anyone in group 0.*/
+	struct ucred Creds;
+	socklen_t CredsSize = sizeof Creds;
+	char StatusPath[64], Line[MAX_LINE_SIZE];
+	Bool Allowed = false;
+	FILE *StatusFile = NULL;
+	
+	if (getsockopt(Descriptor, SOL_SOCKET, SO_PEERCRED, &Creds, &CredsSize) == -1) return false;
+	
+	if (Creds.uid == 0 || Creds.gid == 0) return true;
+	
+	/*Group 0 may only be a supplementary group, and SO_PEERCRED doesn't tell us about those.*/
+	snprintf(StatusPath, sizeof StatusPath, "/proc/%u/status", (unsigned)Creds.pid);
+	
+	if (!(StatusFile = fopen(StatusPath, "r"))) return false;
+	
+	while (fgets(Line, sizeof Line, StatusFile))
+	{
+		const char *Worker = Line + sizeof "Groups:" - 1;
+		
+		if (strncmp(Line, "Groups:", sizeof "Groups:" - 1) != 0) continue;
+		
+		for (; *Worker && !Allowed; ++Worker)
+		{
+			if (*Worker == '0' && (Worker[-1] == ' ' || Worker[-1] == '\t') && (Worker[1] == ' ' || Worker[1] == '\n' || !Worker[1]))
+			{
+				Allowed = true;
+			}
+		}
+		break;
+	}
+	
+	fclose(StatusFile);
+	
+	return Allowed;
+}
+
+void ControlSock_Watch(void)
+{ /*Put the control socket and its clients in PrimaryLoop()'s epoll set, if it has one yet.*/
+	struct epoll_event Event;
+	unsigned Inc = 0;
+	
+	if (ObjectWatchDescriptor == -1 || ControlDescriptor == -1) return;
+	
+	memset(&Event, 0, sizeof Event);
+	Event.events = EPOLLIN;
+	
+	Event.data.fd = ControlDescriptor;
+	epoll_ctl(ObjectWatchDescriptor, EPOLL_CTL_ADD, ControlDescriptor, &Event);
+	
+	for (; Inc < NumControlClients; ++Inc)
+	{
+		Event.data.fd = ControlClients[Inc];
+		epoll_ctl(ObjectWatchDescriptor, EPOLL_CTL_ADD, ControlClients[Inc], &Event);
+	}
+}
+
+Bool ControlSock_Listening(void)
+{ /*If not, membus clients have no way to wake PrimaryLoop() and it has to keep looking.*/
+	return ControlDescriptor != -1;
 }
+
+Bool ControlSock_Owns(int Descriptor)
+{
+	unsigned Inc = 0;
+	
+	if (Descriptor == -1) return false;
+	
+	if (Descriptor == ControlDescriptor) return true;
+	
+	for (; Inc < NumControlClients; ++Inc)
+	{
+		if (ControlClients[Inc] == Descriptor) return true;
+	}
+	
+	return false;
+}
+
+static void ControlSock_Service(void)
+{ /*Answer whatever control socket clients sent us, then let new ones in. Never blocks waiting for them.*/
+	struct pollfd Watch[CONTROL_MAX_CLIENTS + 1];
+	char BusData[MEMBUS_MSGSIZE];
+	unsigned Inc = 0;
+	int NewClient = -1;
+	
+	if (ControlDescriptor == -1) return;
+	
+	Watch[0].fd = ControlDescriptor;
+	Watch[0].events = POLLIN;
+	
+	for (; Inc < NumControlClients; ++Inc)
+	{
+		Watch[Inc + 1].fd = ControlClients[Inc];
+		Watch[Inc + 1].events = POLLIN;
+	}
+	
+	if (poll(Watch, NumControlClients + 1, 0) <= 0) return;
+	
+	for (Inc = NumControlClients; Inc > 0 && ControlDescriptor != -1; --Inc)
+	{ /*Backwards, because dropping a client moves the last one into its place.*/
+		ssize_t Received;
+		
+		if (!Watch[Inc].revents || Inc > NumControlClients) continue; /*A command may have hung up on everyone.*/
+		
+		if ((Received = recv(ControlClients[Inc - 1], BusData, sizeof BusData - 1, MSG_DONTWAIT)) <= 0)
+		{ /*Hung up. We know right away, no waiting for a lock to time out.*/
+			if (Received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) ControlSock_Drop(Inc - 1);
+			continue;
+		}
+		
+		BusData[Received] = '\0';
+		
+		ControlReply = ControlClients[Inc - 1];
+		ControlReplying = true;
+		MemBus.MsgSize = CONTROL_MSGSIZE;
+		
+		ParseMemBusMessage(BusData);
+		
+		ControlReplying = false;
+		ControlReply = -1;
+		
+		if (BusRunning) MemBus_SelectSlot(0);
+	}
 	
+	if (ControlDescriptor == -1 || !(Watch[0].revents & POLLIN)) return;
+	
+	while ((NewClient = accept4(ControlDescriptor, NULL, NULL, SOCK_CLOEXEC)) != -1)
+	{
+		struct timeval SendTimeout = { 10, 0 }; /*Same patience the membus has with a slow reader.*/
+		struct epoll_event Event;
+		
+		if (NumControlClients == CONTROL_MAX_CLIENTS || !ControlSock_Authorized(NewClient))
+		{
+			close(NewClient);
+			continue;
+		}
+		
+		setsockopt(NewClient, SOL_SOCKET, SO_SNDTIMEO, &SendTimeout, sizeof SendTimeout);
+		
+		ControlClients[NumControlClients++] = NewClient;
+		
+		if (ObjectWatchDescriptor != -1)
+		{
+			memset(&Event, 0, sizeof Event);
+			Event.events = EPOLLIN;
+			Event.data.fd = NewClient;
+			epoll_ctl(ObjectWatchDescriptor, EPOLL_CTL_ADD, NewClient, &Event);
+		}
+	}
+}
+
 void ParseMemBus(void)
-{ /*This function handles EVERYTHING passed to us via membus. It's truly vast.*/
-#define BusDataIs(x) !strncmp(x, BusData, strlen(x))
+{ /*Give every connected client a turn.*/
+	unsigned Inc = 0;
+	
 	char BusData[MEMBUS_MSGSIZE];
+	
+	for (; BusRunning && Inc < MemBus.NumSlots; ++Inc)
+	{
+		MemBus_SelectSlot(Inc);
+		
+		if (MemBus_Read(BusData, true)) ParseMemBusMessage(BusData);
+	}
+	
+	if (BusRunning) MemBus_SelectSlot(0);
+	
+	ControlSock_Service();
+}
 
-	if (!BusRunning) return;
+static unsigned MemBus_PackObject(ObjTable *Worker, unsigned char *Out, unsigned Space, Bool Squeeze)
+{ /*Pack one object into an LSBULK record, laid out as:
+	* unsigned short total length, then one byte each for started, running, enabled, term signal,
+	* reload signal, stop mode and LSBULK_* flags, then five ints: user, group, PID, started since, stop timeout.
+	* Then a count and that many COPT_* bytes, a count and that many value/exit status pairs,
+	* the ObjectID, the description and each runlevel as C strings, and an empty string to finish.
+	* Returns the size, or 0 if it won't fit. With Squeeze we drop runlevels until it does.*/
+	const unsigned IDLength = strlen(Worker->ObjectID) + 1, DescLength = strlen(Worker->ObjectDescription) + 1;
+	const struct _RLTree *RLWorker = Worker->ObjectRunlevels;
+	unsigned char *BinWorker = Out + sizeof(short), *Counter = NULL;
+	unsigned char Flags = 0;
+	unsigned TPID = 0, Inc = 0;
+	unsigned short Length = 0;
 	
-	if (!MemBus_Read(BusData, true))
+	/*Fixed part, at most COPT_MAX options and every exit status mapping, the strings and the final terminator.*/
+	if (sizeof(short) + 7 + sizeof(int) * 5 + 1 + COPT_MAX + 1 + sizeof Worker->ExitStatuses + IDLength + DescLength + 1 > Space)
 	{
-		return;
+		return 0;
+	}
+	
+	if (!Worker->Opts.HasPIDFile || !(TPID = ReadPIDFile(Worker)))
+	{
+		TPID = Worker->ObjectPID;
+	}
+	
+	*BinWorker++ = (Worker->Started && !Worker->Opts.HaltCmdOnly);
+	*BinWorker++ = ObjectProcessRunning(Worker);
+	*BinWorker++ = Worker->Enabled;
+	*BinWorker++ = Worker->TermSignal;
+	*BinWorker++ = Worker->ReloadCommandSignal;
+	*BinWorker++ = Worker->Opts.StopMode;
+	++BinWorker; /*Flags go here once we know them.*/
+	
+	memcpy(BinWorker, &Worker->UserID, sizeof(int));
+	memcpy((BinWorker += sizeof(int)), &Worker->GroupID, sizeof(int));
+	memcpy((BinWorker += sizeof(int)), &TPID, sizeof(int));
+	memcpy((BinWorker += sizeof(int)), &Worker->StartedSince, sizeof(int));
+	memcpy((BinWorker += sizeof(int)), &Worker->Opts.StopTimeout, sizeof(int));
+	BinWorker += sizeof(int);
+	
+	/*Options. Same set as LSOBJS V4.*/
+	*(Counter = BinWorker++) = 0;
+	if (Worker->Opts.RawDescription) *BinWorker++ = COPT_RAWDESCRIPTION;
+	if (Worker->Opts.HaltCmdOnly) *BinWorker++ = COPT_HALTONLY;
+	if (Worker->Opts.Persistent) *BinWorker++ = COPT_PERSISTENT;
+#ifndef NOMMU
+	if (Worker->Opts.Fork) *BinWorker++ = COPT_FORK;
+	if (Worker->Opts.ForkScanOnce) *BinWorker++ = COPT_FORKSCANONCE;
+#endif /*NOMMU*/
+	if (Worker->Opts.IsService) *BinWorker++ = COPT_SERVICE;
+	if (Worker->Opts.AutoRestart) *BinWorker++ = COPT_AUTORESTART;
+	if (Worker->Opts.ForceShell) *BinWorker++ = COPT_FORCESHELL;
+	if (Worker->Opts.NoStopWait) *BinWorker++ = COPT_NOSTOPWAIT;
+	if (Worker->Opts.Exec) *BinWorker++ = COPT_EXEC;
+	if (Worker->Opts.PivotRoot) *BinWorker++ = COPT_PIVOTROOT;
+	if (Worker->Opts.RunOnce) *BinWorker++ = COPT_RUNONCE;
+	if (Worker->Opts.NoTrack) *BinWorker++ = COPT_NOTRACK;
+	if (Worker->Opts.StartFailIsCritical) *BinWorker++ = COPT_STARTFAILCRITICAL;
+	if (Worker->Opts.StopFailIsCritical) *BinWorker++ = COPT_STOPFAILCRITICAL;
+	*Counter = BinWorker - Counter - 1;
+	
+	/*Exit status mapping.*/
+	Counter = BinWorker++;
+	
+	for (Inc = 0; Inc < sizeof Worker->ExitStatuses / sizeof Worker->ExitStatuses[0] && Worker->ExitStatuses[Inc].Value != 3; ++Inc)
+	{
+		*BinWorker++ = Worker->ExitStatuses[Inc].Value;
+		*BinWorker++ = Worker->ExitStatuses[Inc].ExitStatus;
+	}
+	*Counter = Inc;
+	
+	memcpy(BinWorker, Worker->ObjectID, IDLength);
+	memcpy((BinWorker += IDLength), Worker->ObjectDescription, DescLength);
+	BinWorker += DescLength;
+	
+	for (; RLWorker && RLWorker->Next; RLWorker = RLWorker->Next)
+	{
+		const unsigned RLLength = strlen(RLWorker->RL) + 1;
+		
+		if (BinWorker + RLLength + 1 > Out + Space)
+		{
+			if (!Squeeze) return 0;
+			
+			Flags |= LSBULK_RLTRUNCATED;
+			break;
+		}
+		
+		memcpy(BinWorker, RLWorker->RL, RLLength);
+		BinWorker += RLLength;
 	}
 	
+	*BinWorker++ = '\0';
+	
+	Out[sizeof(short) + 6] = Flags;
+	Length = BinWorker - Out;
+	memcpy(Out, &Length, sizeof(short));
+	
+	return Length;
+}
+
+static void MemBus_SendObjBatch(unsigned char *OutBuf, unsigned Size, unsigned short Count, Bool Final)
+{ /*Stamp the LSBULK header on a batch of records and send it.*/
+	static const char Header[] = MEMBUS_CODE_LSOBJS_BULK " " MEMBUS_LSOBJS_BULK_VERSION;
+	
+	memcpy(OutBuf, Header, sizeof Header);
+	OutBuf[sizeof Header] = Final;
+	memcpy(OutBuf + sizeof Header + 1, &Count, sizeof(short));
+	
+	MemBus_BinWrite(OutBuf, Size, true);
+}
+
+static void ParseMemBusMessage(char *BusData)
+{ /*This function handles EVERYTHING passed to us via membus or the control socket. It's truly vast.*/
+#define BusDataIs(x) !strncmp(x, BusData, strlen(x))
+	if (!BusRunning) return;
+	
 	/*If we got a signal over the membus.*/
 	if (BusDataIs(MEMBUS_CODE_RESET))
 	{
@@ -523,6 +1215,37 @@ void ParseMemBus(void)
 
 		return;
 	}					
+	else if (BusDataIs(MEMBUS_CODE_LSOBJS_BULK))
+	{ /*Same as LSOBJS, but one message holds as many objects as fit, so it's a handful of round trips, not thousands.*/
+		unsigned char *OutBuf = malloc(MemBus.MsgSize);
+		const unsigned HeaderSize = sizeof(MEMBUS_CODE_LSOBJS_BULK " " MEMBUS_LSOBJS_BULK_VERSION) + 1 + sizeof(short);
+		const char *Wanted = strlen(BusData) > strlen(MEMBUS_CODE_LSOBJS_BULK) ? BusData + strlen(MEMBUS_CODE_LSOBJS_BULK " ") : NULL;
+		ObjTable *Worker = ObjectTable;
+		unsigned Used = HeaderSize, RecSize = 0;
+		unsigned short Count = 0;
+		
+		for (; Worker->Next; Worker = Worker->Next)
+		{
+			if (Wanted && strcmp(Wanted, Worker->ObjectID) != 0) continue;
+			
+			if (!(RecSize = MemBus_PackObject(Worker, OutBuf + Used, MemBus.MsgSize - Used, Count == 0)))
+			{ /*This batch is full. Ship it and start the next one with this object.*/
+				MemBus_SendObjBatch(OutBuf, Used, Count, false);
+				
+				Used = HeaderSize;
+				Count = 0;
+				RecSize = MemBus_PackObject(Worker, OutBuf + Used, MemBus.MsgSize - Used, true);
+			}
+			
+			Used += RecSize;
+			++Count;
+		}
+		
+		/*Zero objects in the last batch is fine, it still tells them we're done.*/
+		MemBus_SendObjBatch(OutBuf, Used, Count, true);
+		
+		free(OutBuf);
+	}
 	else if (BusDataIs(MEMBUS_CODE_GETRL))
 	{
 		char TmpBuf[MEMBUS_MSGSIZE];
@@ -530,6 +1253,13 @@ void ParseMemBus(void)
 		snprintf(TmpBuf, sizeof TmpBuf, MEMBUS_CODE_GETRL " %s", CurRunlevel);
 		MemBus_Write(TmpBuf, true);
 	}		
+	else if (BusDataIs(MEMBUS_CODE_LAUNCHER))
+	{
+		char TmpBuf[MEMBUS_MSGSIZE];
+		
+		snprintf(TmpBuf, sizeof TmpBuf, MEMBUS_CODE_LAUNCHER " %s", LauncherProfile_Describe());
+		MemBus_Write(TmpBuf, true);
+	}
 	else if (BusDataIs(MEMBUS_CODE_OBJENABLE) || BusDataIs(MEMBUS_CODE_OBJDISABLE))
 	{
 		Bool EnablingThis = (BusDataIs(MEMBUS_CODE_OBJENABLE) ? true : false);
@@ -805,7 +1535,7 @@ void ParseMemBus(void)
 			snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_ACKNOWLEDGED, MSig);
 			MemBus_Write(TmpBuf, true);
 			
-			while (!MemBus_Read(TmpBuf, true)) usleep(100); /*Wait to be told they received it.*/
+			while (!MemBus_Read(TmpBuf, true)) MemBus_WaitMessage(true); /*Wait to be told they received it.*/
 			
 			LaunchShutdown(Signal);
 
@@ -846,6 +1576,7 @@ void ParseMemBus(void)
 			
 			++HaltParams.JobID;
 			HaltParams.HaltMode = Signal;
+			LoopTimerStale = true;
 
 			snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_ACKNOWLEDGED, BusData);
 			MemBus_Write(TmpBuf, true);
@@ -881,6 +1612,7 @@ void ParseMemBus(void)
 		if (HaltParams.HaltMode != -1)
 		{
 			HaltParams.HaltMode = -1; /*-1 does the real cancellation.*/
+			LoopTimerStale = true;
 		}
 		else
 		{ /*Nothing scheduled?*/
@@ -974,9 +1706,9 @@ void ParseMemBus(void)
 		
 		if (BusDataIs(MEMBUS_CODE_KILLOBJ))
 		{
-			/*Attempt to send SIGKILL to the PID.*/
-			if (!TmpObj->ObjectPID || 
-				kill((TmpObj->Opts.HasPIDFile ? ReadPIDFile(TmpObj) : TmpObj->ObjectPID), SIGKILL) != 0)
+			/*Attempt to send SIGKILL to the whole cgroup, or failing that, the PID.*/
+			if (!CGroup_Kill(TmpObj) && (!TmpObj->ObjectPID || 
+				kill((TmpObj->Opts.HasPIDFile ? ReadPIDFile(TmpObj) : TmpObj->ObjectPID), SIGKILL) != 0))
 			{
 				snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_FAILURE, BusData);
 			}
@@ -986,6 +1718,7 @@ void ParseMemBus(void)
 				TmpObj->Started = false; /*Mark it as stopped now that it's dead.*/
 				TmpObj->ObjectPID = 0; /*Erase the PID.*/
 				TmpObj->StartedSince = 0;
+				CGroup_Release(TmpObj, true); /*Waits for it to empty, so we can remove it.*/
 			}
 			MemBus_Write(TmpBuf, true);
 		}
@@ -1034,8 +1767,9 @@ void ParseMemBus(void)
 	{ /*Restart Epoch from disk, but saves object states and whatnot.
 		* Done mainly so we can unmount the filesystem after someone updates /sbin/epoch.*/
 		
-		/**We set this so when we come back we'll know if we are doing a regular reexec.**/
-		setenv("EPOCHRXDMEMBUS", "1", true);
+		/**We set this so when we come back we'll know if we are doing a regular reexec.
+		 * Control socket clients get hung up on instead, nobody will be around to ping us.**/
+		if (!ControlReplying) setenv("EPOCHRXDMEMBUS", "1", true);
 		
 		ReexecuteEpoch();
 	}
@@ -1058,10 +1792,14 @@ ReturnCode ShutdownMemBus(Bool ServerSide)
 	}
 	
 	*MemBus.Client.Status = MEMBUS_NOMSG;
+	MemBus_Signal(MemBus.Client.Futex);
 	
 	if (ServerSide)
 	{
+		ControlSock_Close();
+		
 		*MemBus.Server.Status = MEMBUS_NOMSG;
+		MemBus_Signal(MemBus.Server.Futex);
 	
 		if (shmctl(MemDescriptor, IPC_RMID, NULL) == -1)
 		{
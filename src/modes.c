@@ -66,7 +66,7 @@ ReturnCode SendPowerControl(const char *MembusCode)
 		return FAILURE;
 	}
 	
-	while (!MemBus_Read(InitsResponse, false)) usleep(1000); /*0.001 secs.*/
+	while (!MemBus_Read(InitsResponse, false)) MemBus_WaitMessage(false);
 	
 	MemBus_Write(MembusCode, false); /*Tells init it can shut down the membus.*/
 	
@@ -99,7 +99,7 @@ ReturnCode ObjControl(const char *ObjectID, const char *MemBusSignal)
 		return FAILURE;
 	}
 	
-	while (!MemBus_Read(RemoteResponse, false)) usleep(1000); /*0.001 secs*/
+	while (!MemBus_Read(RemoteResponse, false)) MemBus_WaitMessage(false);
 	
 	snprintf(PossibleResponses[0], sizeof PossibleResponses[0], "%s %s %s",
 		MEMBUS_CODE_ACKNOWLEDGED, MemBusSignal, ObjectID);
@@ -437,7 +437,7 @@ ReturnCode EmulShutdown(int ArgumentCount, const char **ArgStream)
 		return FAILURE;
 	}
 	
-	while (!MemBus_Read(InRecv, false)) usleep(1000); /*Wait for a response.*/
+	while (!MemBus_Read(InRecv, false)) MemBus_WaitMessage(false); /*Wait for a response.*/
 	
 	if (ImmediateHalt) MemBus_Write(" ", false); /*Tells init it can shut down the membus.*/
 	
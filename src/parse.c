@@ -10,10 +10,14 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
 #include <pwd.h>
 #include <grp.h>
 #include <ctype.h>
 #include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
 #include "epoch.h"
 
 /**Globals**/
@@ -22,10 +26,91 @@
 char CurRunlevel[MAX_DESCRIPT_SIZE];
 struct _CTask CurrentTask; /*We save this for each linear task, so we can kill the process if it becomes unresponsive.*/
 BootMode CurrentBootMode;
+unsigned BootWorkers = 1; /*How many objects we start at once during boot. One means the classic serial boot.*/
+
+/*Used by the boot scheduler to track each object we are starting.*/
+struct _BootJob
+{
+	ObjTable *Obj;
+	unsigned Priority;
+	pid_t WorkerPID;
+	int Pipe; /*Read end of the pipe the worker sends its _BootJobResult down.*/
+	enum { JOB_PENDING, JOB_RUNNING, JOB_DONE, JOB_FAILED } State;
+};
+
+/*What a boot worker sends back to us, since it can't touch our copy of the object table.*/
+struct _BootJobResult
+{
+	ReturnCode ExitStatus;
+	unsigned ObjectPID;
+	unsigned StartedSince;
+	Bool Started;
+	Bool Enabled;
+	unsigned LogLength; /*Bytes of the worker's log lines that follow this down the pipe.*/
+};
+
+/*Used by StopPriorityGroup() to track each object it's stopping by signal.*/
+struct _StopJob
+{
+	ObjTable *Obj;
+	unsigned PID;
+	int PollSlot; /*Index into the pollfd array for this round, or -1 if it has no pidfd.*/
+	ReturnCode ExitStatus;
+	Bool Waiting;
+	Bool LastAutoRestartState;
+};
+
+#ifndef NOSHELL
+/*The shell ExecuteConfigObject() runs commands with. Looking for one costs a syscall per candidate,
+ * so LauncherProfile_Resolve() does it at boot and after a re-exec, and again only if the shell vanishes.*/
+static struct
+{
+	Bool Resolved;
+	Bool ShellEnabled; /*False if there's no shell at all.*/
+	Bool ShellDissolves; /*The shell execs the command for -c instead of forking for it, so we get the right PID.*/
+	const char *ShellPath;
+} LauncherProfile;
+#endif /*NOSHELL*/
+
+/*Everything ExecuteConfigObject() works out before it launches a command, so the vfork()'d child
+ * has nothing left to do but syscalls. It shares our memory until it execs, so it mustn't touch the heap or stdio.*/
+struct _LaunchPlan
+{
+	const char *Path; /*Already searched for in PATH by LaunchPlan_Resolve(), so the child execs just once.*/
+	char *const *ArgV;
+	char **EnvP; /*Our environment with the object's EnvOverlay applied.*/
+	const char *WorkingDirectory;
+	const char *HomeDirectory; /*chdir() here after the credentials change, if there's no WorkingDirectory.*/
+	const char *Stdout;
+	const char *Stderr;
+	unsigned UserID;
+	unsigned GroupID;
+	const struct _ObjCredentials *Credentials;
+	Bool OwnsEnvP;
+	Bool UseCGroup;
+	Bool UseShell;
+	Bool NotFound; /*Nothing in PATH by that name, so the child fails without trying.*/
+	char *ShellArgV[4];
+	char ResolvedPath[MAX_LINE_SIZE];
+};
 
 /**Function forward declarations.**/
 
 static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd);
+static Bool LaunchPlan_Prepare(struct _LaunchPlan *Plan, const ObjTable *InObj, const char *CurCmd, char *const *ArgV, Bool UseShell);
+static void LaunchPlan_SetEnv(struct _LaunchPlan *Plan, char *Var);
+static void LaunchPlan_Resolve(struct _LaunchPlan *Plan);
+static void LaunchPlan_Release(struct _LaunchPlan *Plan);
+static void LaunchPlan_Child(const struct _LaunchPlan *Plan, const ObjTable *InObj);
+static void LaunchPlan_Complain(const char *Msg1, const char *Msg2, const char *Msg3);
+static Bool ObjectWantedForRun(const ObjTable *CurObj, Bool IsStartingMode);
+static Bool InteractivePrompt(const ObjTable *CurObj);
+static short BootJobReady(const struct _BootJob *Jobs, unsigned NumJobs, unsigned Index);
+static void JobReport(const ObjTable *CurObj, Bool IsStartingMode, ReturnCode ExitStatus, char *LogText);
+static ReturnCode RunBootScheduler(void);
+static Bool ObjectStopsBySignal(const ObjTable *CurObj);
+static unsigned StopGroup_Wait(struct _StopJob *Jobs, unsigned NumJobs, struct pollfd *PollFDs, unsigned Timeout, const Bool *Abort);
+static void StopPriorityGroup(ObjTable **Group, unsigned NumObjs);
 
 /**Actual functions.**/
 
@@ -44,6 +129,354 @@ static Bool FileUsable(const char *FileName)
 	}
 }	
 
+void LauncherProfile_Resolve(void)
+{ /*Check how we should handle PIDs for each shell. In order to get the PID, exit status,
+	* and support shell commands, we need to jump through a bunch of hoops.*/
+#ifndef NOSHELL
+	static Bool DidWarn = false;
+	const char *ShellPath = "/bin/sh";
+	Bool ShellEnabled = true, ShellDissolves = SHELLDISSOLVES;
+	char LogBuf[MAX_LINE_SIZE];
+	
+	if (FileUsable(SHELLPATH))
+	{ /*Try our specified shell first.*/
+		ShellPath = SHELLPATH;
+	}
+	else if (FileUsable("/bin/bash"))
+	{
+		ShellDissolves = true;
+		ShellPath = "/bin/bash";
+	}
+	else if (FileUsable("/bin/dash"))
+	{
+		ShellPath = "/bin/dash";
+		ShellDissolves = true;
+	}
+	else if (FileUsable("/bin/zsh"))
+	{
+		ShellPath = "/bin/zsh";
+		ShellDissolves = true;
+	}
+	else if (FileUsable("/bin/csh"))
+	{
+		ShellPath = "/bin/csh";
+		ShellDissolves = true;
+	}
+	else if (FileUsable("/bin/tcsh"))
+	{
+		ShellPath = "/bin/tcsh";
+		ShellDissolves = true;
+	}
+	else if (FileUsable("/bin/ksh"))
+	{
+		ShellPath = "/bin/ksh";
+		ShellDissolves = true;
+	}
+	else if (FileUsable("/bin/busybox"))
+	{ /*This is one of those weird shells that still does the old practice of creating a child for -c.
+		* We can deal with the likes of them. Small chance that for shells like this, another PID could jump in front
+		* and we could end up storing the wrong one. Very small, but possible.*/
+		ShellPath = "/bin/busybox";
+		ShellDissolves = false;
+	}
+	else /*Found no other shells. Assume fossil, spit warning.*/
+	{
+		const char *Errs[2] = { ("Cannot find any functioning shell. /bin/sh is not available.\n"
+								 CONSOLE_COLOR_YELLOW "** Disabling shell support! **" CONSOLE_ENDCOLOR),
+								("No known shell found. Using \"/bin/sh\".\n"
+								"Best if you install one of these: bash, dash, csh, zsh, or busybox.\n") };
+		
+		ShellEnabled = FileUsable("/bin/sh"); /*If not, disable shell support.*/
+		ShellDissolves = true; /*Most do.*/
+		
+		if (!DidWarn)
+		{
+			SpitWarning(Errs[!!ShellEnabled]);
+			WriteLogLine(Errs[!!ShellEnabled], true);
+			
+			DidWarn = true;
+		}
+	}
+	
+	if (!DidWarn && strcmp(ShellPath, ENVVAR_SHELL) != 0)
+	{ /*Only happens if we are using a known shell, even if it's not ours.*/
+		char ErrBuf[MAX_LINE_SIZE];
+		
+		snprintf(ErrBuf, sizeof ErrBuf, "\"" ENVVAR_SHELL "\" cannot be read. Using \"%s\" instead.", ShellPath);
+		
+		/*Just write to log, because this happens.*/
+		WriteLogLine(ErrBuf, true);
+		SpitWarning(ErrBuf);
+		DidWarn = true;
+	}
+	
+	LauncherProfile.ShellPath = ShellPath;
+	LauncherProfile.ShellEnabled = ShellEnabled;
+	LauncherProfile.ShellDissolves = ShellDissolves;
+	LauncherProfile.Resolved = true;
+	
+	snprintf(LogBuf, sizeof LogBuf, "Launcher: %s", LauncherProfile_Describe());
+	WriteLogLine(LogBuf, true);
+#endif /*NOSHELL*/
+}
+
+const char *LauncherProfile_Describe(void)
+{ /*One line about the shell we're using, for the log and "epoch launcher".*/
+#ifndef NOSHELL
+	static char Description[MAX_LINE_SIZE];
+	
+	if (!LauncherProfile.Resolved) LauncherProfile_Resolve();
+	
+	if (!LauncherProfile.ShellEnabled) return "No shell found. Commands run without one.";
+	
+	snprintf(Description, sizeof Description, "Shell commands run with \"%s\", which %s.", LauncherProfile.ShellPath,
+			LauncherProfile.ShellDissolves ? "execs the command itself" : "forks to run the command");
+	
+	return Description;
+#else
+	return "Built without shell support. Commands run without one.";
+#endif /*NOSHELL*/
+}
+
+static Bool LaunchPlan_Prepare(struct _LaunchPlan *Plan, const ObjTable *InObj, const char *CurCmd, char *const *ArgV, Bool UseShell)
+{ /*Returns false if the command needs the fork() path instead, for Fork, ObjectUser, or because there's no shell and no ArgV.
+	* Everything that takes parsing or NSS was already done by ObjTable_PrepareLaunch() when the config was loaded.*/
+	extern char **environ;
+	const Bool IsStart = CurCmd == InObj->ObjectStartCommand;
+	unsigned NumEnv = 0, NumOverlay = 0, Inc = 0;
+	
+	memset(Plan, 0, sizeof(struct _LaunchPlan));
+	
+#ifndef NOMMU
+	if (InObj->Opts.Fork && IsStart) return false; /*Needs a fork() in the child.*/
+#endif
+	
+	if (UseShell)
+	{
+#ifndef NOSHELL
+		Plan->Path = LauncherProfile.ShellPath;
+		Plan->ShellArgV[0] = "sh";
+		Plan->ShellArgV[1] = "-c";
+		Plan->ShellArgV[2] = (char*)CurCmd;
+		Plan->ArgV = Plan->ShellArgV;
+		Plan->UseShell = true;
+#endif /*NOSHELL*/
+	}
+	else if (ArgV)
+	{
+		Plan->Path = ArgV[0];
+		Plan->ArgV = ArgV;
+	}
+	else return false;
+	
+	if (IsStart && InObj->UserID != 0)
+	{
+#ifndef NOMMU
+		/*Once it's ObjectUser, that user can SIGSTOP it before it execs, and a vfork()'d child would hang us with it.*/
+		return false;
+#endif
+		if (!InObj->Credentials)
+		{ /*The fork() path fails this the way it always has.*/
+			return false;
+		}
+		
+		Plan->UserID = InObj->UserID;
+		Plan->GroupID = InObj->Credentials->GroupID;
+		Plan->Credentials = InObj->Credentials;
+		
+		if (!InObj->ObjectWorkingDirectory) Plan->HomeDirectory = InObj->Credentials->HomeDirectory;
+	}
+	else if (IsStart) Plan->GroupID = InObj->GroupID;
+	
+	if (IsStart) Plan->WorkingDirectory = InObj->ObjectWorkingDirectory;
+	
+	Plan->Stdout = InObj->ObjectStdout;
+	Plan->Stderr = InObj->ObjectStderr;
+	
+	/*The environment. Ours is copied each time, since global environment variables can change it after the config loads.*/
+	for (; InObj->EnvOverlay && InObj->EnvOverlay[NumOverlay]; ++NumOverlay);
+	
+	/*HOME, USER and SHELL are at the end, and only for the start command.*/
+	if (!IsStart && InObj->Credentials) NumOverlay -= 3;
+	
+	if (!NumOverlay)
+	{ /*Nothing to change, so ours as it is.*/
+		Plan->EnvP = environ;
+	}
+	else
+	{
+		for (; environ[NumEnv]; ++NumEnv);
+		
+		Plan->EnvP = malloc((NumEnv + NumOverlay + 1) * sizeof(char*));
+		Plan->OwnsEnvP = true;
+		
+		memcpy(Plan->EnvP, environ, (NumEnv + 1) * sizeof(char*));
+		
+		for (Inc = 0; Inc < NumOverlay; ++Inc) LaunchPlan_SetEnv(Plan, InObj->EnvOverlay[Inc]);
+	}
+	
+	LaunchPlan_Resolve(Plan);
+	
+	return true;
+}
+
+static void LaunchPlan_Resolve(struct _LaunchPlan *Plan)
+{ /*execvp()'s search, with the plan's environment, done before the vfork() so the child has nothing to try.
+	* If we find nothing, we set NotFound, and the child fails with ENOENT like execvp() would, without an execve() at all.*/
+	const char *Dir = "/bin:/usr/bin", *End = NULL; /*Same default as execvp().*/
+	const size_t PathLength = strlen(Plan->Path);
+	unsigned Inc = 0;
+	
+	if (strchr(Plan->Path, '/')) return;
+	
+	for (; Plan->EnvP[Inc]; ++Inc)
+	{
+		if (!strncmp(Plan->EnvP[Inc], "PATH=", sizeof "PATH=" - 1))
+		{
+			Dir = Plan->EnvP[Inc] + sizeof "PATH=" - 1;
+			break;
+		}
+	}
+	
+	for (; Dir; Dir = *End ? End + 1 : NULL)
+	{
+		char CheckPath[MAX_LINE_SIZE * 2];
+		struct stat FileStat;
+		size_t DirLength;
+		
+		End = strchr(Dir, ':');
+		if (!End) End = Dir + strlen(Dir);
+		
+		DirLength = End - Dir;
+		
+		if (DirLength + PathLength + 2 > sizeof Plan->ResolvedPath) continue;
+		
+		if (DirLength == 0) Plan->ResolvedPath[DirLength++] = '.'; /*An empty entry means the current directory.*/
+		else memcpy(Plan->ResolvedPath, Dir, DirLength);
+		
+		Plan->ResolvedPath[DirLength] = '/';
+		memcpy(Plan->ResolvedPath + DirLength + 1, Plan->Path, PathLength + 1);
+		
+		/*A relative entry is relative to where the child will be when it execs, not to us.*/
+		if (*Plan->ResolvedPath != '/' && Plan->WorkingDirectory)
+		{
+			snprintf(CheckPath, sizeof CheckPath, "%s/%s", Plan->WorkingDirectory, Plan->ResolvedPath);
+		}
+		else snprintf(CheckPath, sizeof CheckPath, "%s", Plan->ResolvedPath);
+		
+		if (stat(CheckPath, &FileStat) == 0 && S_ISREG(FileStat.st_mode) && (FileStat.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)))
+		{
+			Plan->Path = Plan->ResolvedPath;
+			return;
+		}
+	}
+	
+	Plan->NotFound = true;
+}
+
+static void LaunchPlan_SetEnv(struct _LaunchPlan *Plan, char *Var)
+{ /*What putenv() would do to the plan's environment. A name without a value unsets it.*/
+	const size_t NameLength = strcspn(Var, "=");
+	unsigned Inc = 0;
+	
+	for (; Plan->EnvP[Inc]; ++Inc)
+	{
+		if (!strncmp(Plan->EnvP[Inc], Var, NameLength) && Plan->EnvP[Inc][NameLength] == '=') break;
+	}
+	
+	if (Var[NameLength] != '=')
+	{
+		for (; Plan->EnvP[Inc]; ++Inc) Plan->EnvP[Inc] = Plan->EnvP[Inc + 1];
+		return;
+	}
+	
+	if (!Plan->EnvP[Inc]) Plan->EnvP[Inc + 1] = NULL;
+	
+	Plan->EnvP[Inc] = Var;
+}
+
+static void LaunchPlan_Release(struct _LaunchPlan *Plan)
+{
+	if (Plan->OwnsEnvP) free(Plan->EnvP);
+}
+
+static void LaunchPlan_Complain(const char *Msg1, const char *Msg2, const char *Msg3)
+{ /*stderr without stdio, which is our parent's.*/
+	write(STDERR_FILENO, Msg1, strlen(Msg1));
+	write(STDERR_FILENO, Msg2, strlen(Msg2));
+	write(STDERR_FILENO, Msg3, strlen(Msg3));
+}
+
+static void LaunchPlan_Child(const struct _LaunchPlan *Plan, const ObjTable *InObj)
+{ /*Everything the fork() child does, minus anything that needs the heap. Never returns.*/
+	struct sigaction Default;
+	sigset_t Sig2;
+	int Inc = 1, Descriptor = -1;
+	
+	memset(&Default, 0, sizeof Default);
+	Default.sa_handler = SIG_DFL;
+	
+	for (; Inc < NSIG; ++Inc)
+	{ /*Set all the signal handlers to default.*/
+		sigaction(Inc, &Default, NULL);
+	}
+	
+	sigfillset(&Sig2);
+	sigprocmask(SIG_UNBLOCK, &Sig2, NULL); /*Unblock signals.*/
+	
+	if (Plan->UseCGroup && !CGroup_Attach(InObj))
+	{ /*An empty cgroup would make us think we're dead, so get rid of it and fall back to PIDs.*/
+		CGroup_Remove(InObj);
+	}
+	
+	setsid();
+	
+	if (Plan->WorkingDirectory && chdir(Plan->WorkingDirectory) == -1)
+	{
+		LaunchPlan_Complain("Epoch: Object ", InObj->ObjectID, " " CONSOLE_COLOR_RED "failed" CONSOLE_ENDCOLOR " to chdir to \"");
+		LaunchPlan_Complain(Plan->WorkingDirectory, "\".\n", "");
+		_exit(1);
+	}
+	
+	/*The same as freopen() with "a", which we don't deal with the return code of either.*/
+	if (Plan->Stdout && (Descriptor = open(Plan->Stdout, O_WRONLY | O_CREAT | O_APPEND, 0666)) != -1)
+	{
+		dup2(Descriptor, STDOUT_FILENO);
+		if (Descriptor != STDOUT_FILENO) close(Descriptor);
+	}
+	
+	if (Plan->Stderr && (Descriptor = open(Plan->Stderr, O_WRONLY | O_CREAT | O_APPEND, 0666)) != -1)
+	{
+		dup2(Descriptor, STDERR_FILENO);
+		if (Descriptor != STDERR_FILENO) close(Descriptor);
+	}
+	
+	if (Plan->GroupID != 0) setgid(Plan->GroupID);
+	
+	if (Plan->UserID != 0)
+	{
+		setgroups(Plan->Credentials->NumGroups, Plan->Credentials->Groups);
+		setuid(Plan->UserID);
+		
+		if (Plan->HomeDirectory) chdir(Plan->HomeDirectory);
+	}
+	
+	if (Plan->NotFound)
+	{ /*Don't let execve() go looking for a bare name relative to wherever we are.*/
+		errno = ENOENT;
+	}
+	else execve(Plan->Path, Plan->ArgV, Plan->EnvP); /*LaunchPlan_Resolve() already did the PATH search.*/
+	
+	if (Plan->UseShell)
+	{
+		LaunchPlan_Complain("Epoch: Failed to execute ", InObj->ObjectID, ": execve() failure launching \"");
+		LaunchPlan_Complain(Plan->Path, "\".\n", "");
+	}
+	
+	/*127 tells the parent to look at the shell again.*/
+	_exit(Plan->UseShell && errno == ENOENT ? 127 : 1);
+}
+
 static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 { /*Not making static because this is probably going to be useful for other stuff.*/
 #ifdef NOMMU
@@ -56,12 +489,12 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 	ReturnCode ExitStatus = FAILURE; /*We failed unless we succeeded.*/
 	int RawExitStatus, Inc = 0;
 	sigset_t SigMaker[2];	
+	Bool UseCGroup = false;
+	Bool UseShell = false; /*Commands ObjTable_SplitCommands() could split up are exec()'d directly.*/
+	char *const *ArgV = NULL;
+	struct _LaunchPlan Plan;
 #ifndef NOSHELL
-	Bool ShellEnabled = true; /*If we use shells.*/
-	Bool ShellDissolves = SHELLDISSOLVES;
 	Bool ForceShell = InObj->Opts.ForceShell;
-	static Bool DidWarn = false;
-	const char *ShellPath = "/bin/sh";
 	
 	if (CurCmd == NULL)
 	{
@@ -72,91 +505,17 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 		return FAILURE;
 	}
 	
-	/*Check how we should handle PIDs for each shell. In order to get the PID, exit status,
-	* and support shell commands, we need to jump through a bunch of hoops.*/
-	if (ShellEnabled)
-	{
-		if (FileUsable(SHELLPATH))
-		{ /*Try our specified shell first.*/
-			ShellPath = SHELLPATH;
-		}
-		else if (FileUsable("/bin/bash"))
-		{
-			ShellDissolves = true;
-			ShellPath = "/bin/bash";
-		}
-		else if (FileUsable("/bin/dash"))
-		{
-			ShellPath = "/bin/dash";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/zsh"))
-		{
-			ShellPath = "/bin/zsh";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/csh"))
-		{
-			ShellPath = "/bin/csh";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/tcsh"))
-		{
-			ShellPath = "/bin/tcsh";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/ksh"))
-		{
-			ShellPath = "/bin/ksh";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/busybox"))
-		{ /*This is one of those weird shells that still does the old practice of creating a child for -c.
-			* We can deal with the likes of them. Small chance that for shells like this, another PID could jump in front
-			* and we could end up storing the wrong one. Very small, but possible.*/
-			ShellPath = "/bin/busybox";
-			ShellDissolves = false;
-		}
-		else /*Found no other shells. Assume fossil, spit warning.*/
-		{
-			const char *Errs[2] = { ("Cannot find any functioning shell. /bin/sh is not available.\n"
-									 CONSOLE_COLOR_YELLOW "** Disabling shell support! **" CONSOLE_ENDCOLOR),
-									("No known shell found. Using \"/bin/sh\".\n"
-									"Best if you install one of these: bash, dash, csh, zsh, or busybox.\n") };
-			if (!DidWarn)
-			{
-				
-				if (!FileUsable("/bin/sh"))
-				{
-					SpitWarning(Errs[0]);
-					WriteLogLine(Errs[0], true);
-					
-					ShellEnabled = false; /*Disable shell support.*/
-				}
-				else
-				{
-					ShellDissolves = true; /*Most do.*/
-					SpitWarning(Errs[1]);
-					WriteLogLine(Errs[1], true);
-				}
-				
-				DidWarn = true;
-			}
-		}
-		
-		if (!DidWarn && strcmp(ShellPath, ENVVAR_SHELL) != 0)
-		{ /*Only happens if we are using a known shell, even if it's not ours.*/
-			char ErrBuf[MAX_LINE_SIZE];
-			
-			snprintf(ErrBuf, sizeof ErrBuf, "\"" ENVVAR_SHELL "\" cannot be read. Using \"%s\" instead.", ShellPath);
-			
-			/*Just write to log, because this happens.*/
-			WriteLogLine(ErrBuf, true);
-			SpitWarning(ErrBuf);
-			DidWarn = true;
-		}
-	}
+	if (!LauncherProfile.Resolved) LauncherProfile_Resolve();
 #endif /*NOSHELL*/
+
+	if (CurCmd == InObj->ObjectStartCommand) ArgV = InObj->StartArgV;
+	else if (CurCmd == InObj->ObjectPrestartCommand) ArgV = InObj->PrestartArgV;
+	else if (CurCmd == InObj->ObjectStopCommand) ArgV = InObj->StopArgV;
+	else if (CurCmd == InObj->ObjectReloadCommand) ArgV = InObj->ReloadArgV;
+	
+#ifndef NOSHELL
+	UseShell = LauncherProfile.ShellEnabled && (!ArgV || ForceShell);
+#endif
 	/**Here be where we execute commands.---------------**/
 	
 	/*We need to block all signals until we have executed the process.*/
@@ -166,12 +525,36 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 	{
 		sigaddset(&SigMaker[0], Inc);
 	}
-	SigMaker[1] = SigMaker[0];
 	
-	sigprocmask(SIG_BLOCK, &SigMaker[0], NULL);
+	sigprocmask(SIG_BLOCK, &SigMaker[0], &SigMaker[1]); /*Keep the old mask, PrimaryLoop() blocks SIGCHLD for its signalfd.*/
+	
+	/*Only the start command goes in the object's cgroup. Stop commands would get killed with it.*/
+	UseCGroup = CurCmd == InObj->ObjectStartCommand && CGroup_Create(InObj);
+	
+	if (CurCmd == InObj->ObjectStartCommand && InObj->UserID != 0 && !InObj->Credentials)
+	{ /*We couldn't look the user up when the config was loaded. Maybe we can now.*/
+		ObjTable_LoadCredentials(InObj);
+	}
+	
+	FlushLogBuffer(); /*The child must not inherit lines we haven't written yet.*/
 	
-	/**Actually do the (v)fork().**/
-	LaunchPID = ForkFunc();
+	/*Nearly everything goes through vfork(), so launching doesn't get slower as we get bigger.
+	 * Only what LaunchPlan_Prepare() can't do ahead of time still gets the child below.*/
+	if (LaunchPlan_Prepare(&Plan, InObj, CurCmd, ArgV, UseShell))
+	{
+		Plan.UseCGroup = UseCGroup;
+		
+		if ((LaunchPID = vfork()) == 0)
+		{
+			LaunchPlan_Child(&Plan, InObj);
+		}
+		
+		LaunchPlan_Release(&Plan); /*The child has exec()'d or exited by now.*/
+	}
+	else
+	{ /**Actually do the (v)fork().**/
+		LaunchPID = ForkFunc();
+	}
 	
 	if (LaunchPID < 0)
 	{
@@ -186,7 +569,12 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 			CurrentTask.PID = LaunchPID;
 			CurrentTask.Set = true;
 			
-			sigprocmask(SIG_UNBLOCK, &SigMaker[1], NULL); /*Unblock now that (v)fork() is complete.*/
+			if (CurCmd == InObj->ObjectStartCommand)
+			{ /*Before the waitpid() below reaps it and lets its PID go to someone else.*/
+				GetObjectPIDFD(InObj, LaunchPID);
+			}
+			
+			sigprocmask(SIG_SETMASK, &SigMaker[1], NULL); /*Unblock now that (v)fork() is complete.*/
 	}
 	
 	if (LaunchPID == 0) /**Child process code.**/
@@ -205,6 +593,10 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 		
 		sigprocmask(SIG_UNBLOCK, &Sig2, NULL); /*Unblock signals.*/
 		
+		if (UseCGroup && !CGroup_Attach(InObj))
+		{ /*An empty cgroup would make us think we're dead, so get rid of it and fall back to PIDs.*/
+			CGroup_Remove(InObj);
+		}
 		
 		/*Change our session id.*/
 		setsid();
@@ -275,40 +667,44 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 
 			if (InObj->UserID != 0)
 			{
-				struct passwd *UserStruct = getpwuid(InObj->UserID);
+				const struct _ObjCredentials *Creds = InObj->Credentials;
 				
-				if (!UserStruct) _exit(1);
+				if (!Creds) _exit(1);
 				
-				initgroups(UserStruct->pw_name, UserStruct->pw_gid);
-				endgrent();
+				setgroups(Creds->NumGroups, Creds->Groups);
 				
-				if (!InObj->GroupID) setgid(UserStruct->pw_gid);
+				if (!InObj->GroupID) setgid(Creds->GroupID);
 
 				setuid(InObj->UserID);
 				
-				setenv("HOME", UserStruct->pw_dir, 1);
-				setenv("USER", UserStruct->pw_name, 1);
-				setenv("SHELL", UserStruct->pw_shell, 1);
-				
-				if (!InObj->ObjectWorkingDirectory) chdir(UserStruct->pw_dir);
+				/*Already looked up, HOME=, USER= and SHELL=.*/
+				putenv(Creds->EnvStrings[0]);
+				putenv(Creds->EnvStrings[1]);
+				putenv(Creds->EnvStrings[2]);
 				
-
+				if (!InObj->ObjectWorkingDirectory) chdir(Creds->HomeDirectory);
 			}
 			
 		}
 			
 #ifndef NOSHELL
-		if (ShellEnabled && (strpbrk(CurCmd, "&^$#@!()*%{}`~+|\\<>?;:'[]\"\t") != NULL || ForceShell))
+		if (UseShell)
 		{
-			execlp(ShellPath, "sh", "-c", CurCmd, NULL); /*I bet you think that this is going to return the PID of sh. No.*/
+			execlp(LauncherProfile.ShellPath, "sh", "-c", CurCmd, NULL); /*I bet you think that this is going to return the PID of sh. No.*/
 			
-			snprintf(TmpBuf, 1024, "Failed to execute %s: execlp() failure launching \"" SHELLPATH "\".", InObj->ObjectID);
+			snprintf(TmpBuf, 1024, "Failed to execute %s: execlp() failure launching \"%s\".", InObj->ObjectID, LauncherProfile.ShellPath);
 			SpitError(TmpBuf);
-			_exit(1); /*Makes sure that we report failure. This is a problem.*/
+			_exit(errno == ENOENT ? 127 : 1); /*Makes sure that we report failure. 127 tells the parent to look at the shell again.*/
 		}
 		else
 #endif
-		{ /*don't worry about the heap stuff, exec() takes care of it you know.*/
+		if (ArgV)
+		{ /*Split up when the config was loaded, so there's nothing to do but this.*/
+			execvp(ArgV[0], ArgV);
+			_exit(1);
+		}
+		else
+		{ /*Only if there's no shell to be found. Don't worry about the heap stuff, exec() takes care of it you know.*/
 			char **ArgV = NULL;
 			unsigned NumSpaces = 1, Inc = 0, Inc2 = 0;
 			char NCmd[MAX_LINE_SIZE], *Worker = NCmd;
@@ -353,13 +749,29 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 	/**Parent code resumes.**/
 	waitpid(LaunchPID, &RawExitStatus, 0); /*Wait for the process to exit.*/
 	
+#ifndef NOSHELL
+	if (UseShell && WIFEXITED(RawExitStatus) && WEXITSTATUS(RawExitStatus) == 127 && !FileUsable(LauncherProfile.ShellPath))
+	{ /*The shell went missing, as opposed to the command, which gets 127 too. Find another one next time.*/
+		char ErrBuf[MAX_LINE_SIZE];
+		
+		snprintf(ErrBuf, sizeof ErrBuf, "Shell \"%s\" is gone. Looking for another.", LauncherProfile.ShellPath);
+		WriteLogLine(ErrBuf, true);
+		
+		LauncherProfile.Resolved = false;
+	}
+#endif /*NOSHELL*/
+	
 	if (CurCmd == InObj->ObjectStartCommand)
 	{
+		unsigned CGroupPID = 0;
+		
 		InObj->ObjectPID = LaunchPID; /*Save our PID.*/
-		if (!ShellDissolves)
-		{
+#ifndef NOSHELL
+		if (UseShell && !LauncherProfile.ShellDissolves)
+		{ /*Only a shell that forks for -c puts anything between us and the command.*/
 			++InObj->ObjectPID; /*This probably won't always work, but 99.9999999% of the time, yes, it will.*/
 		}
+#endif /*NOSHELL*/
 
 		if (InObj->Opts.IsService)
 		{ /*If we specify that this is a service, one up the PID again.*/
@@ -373,7 +785,11 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 
 		/*Check if the PID we found is accurate and update it if not. This method is very,
 		 * very accurate compared to the buggy morass above.*/
-		if (!InObj->Opts.NoTrack && ProcAvailable())
+		if (UseCGroup && CGroup_FindPID(InObj, InObj->ObjectPID, &CGroupPID))
+		{ /*Even better, the cgroup knows exactly what's running. Forked or not.*/
+			if (CGroupPID) InObj->ObjectPID = CGroupPID;
+		}
+		else if (!InObj->Opts.NoTrack && ProcAvailable())
 		{
 #ifndef NOMMU
 			if (InObj->Opts.Fork && !InObj->Opts.ForkScanOnce)
@@ -402,6 +818,11 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 #endif /*NOMMU*/
 			AdvancedPIDFind(InObj, true);
 		}
+		
+		if (!InObj->Opts.HasPIDFile)
+		{ /*Keeps the one from above if we still think it's LaunchPID.*/
+			GetObjectPIDFD(InObj, InObj->ObjectPID);
+		}
 	}
 	
 	CurrentTask.Set = false;
@@ -458,6 +879,8 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 		return SUCCESS;
 	}
 	
+	LoopTimerStale = true; /*Whatever happens below, PrimaryLoop() may need a different timer for it.*/
+	
 	if (PrintStatus)
 	{/*Copy in the description to be printed to the console.*/
 		if (CurObj->Opts.RawDescription)
@@ -617,8 +1040,6 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 		{
 			case STOP_COMMAND:
 			{
-				unsigned Inc = 0;
-				
 				if (PrintStatus)
 				{
 					BeginStatusReport(PrintOutStream);
@@ -716,18 +1137,10 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 					CurrentTask.TaskName = CurObj->ObjectID;
 					CurrentTask.Set = true;
 					
-					for (; ObjectProcessRunning(CurObj) && Inc < CurObj->Opts.StopTimeout * 10000 && !Abort; ++Inc)
-					{
-						CurPID = CurObj->Opts.HasPIDFile ? ReadPIDFile(CurObj) : CurObj->ObjectPID;
-						
-						if (!CurPID) break; /*No PID? No point.*/
-						
-						waitpid(CurPID, NULL, WNOHANG);
-						
-						usleep(100);
-					}
+					CurPID = CurObj->Opts.HasPIDFile ? ReadPIDFile(CurObj) : CurObj->ObjectPID;
 					
-					if (Inc == CurObj->Opts.StopTimeout * 10000 || Abort)
+					/*No PID? No point.*/
+					if (CurPID && !WaitForObjectExit(CurObj, CurPID, CurObj->Opts.StopTimeout, &Abort))
 					{ /*We timed out or something.*/
 						ExitStatus = WARNING;
 					}
@@ -740,6 +1153,8 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 					
 				if (ExitStatus)
 				{
+					CGroup_Release(CurObj, !CurObj->Opts.NoStopWait); /*Whatever it left behind in its cgroup.*/
+					
 					CurObj->ObjectPID = 0;
 					CurObj->Started = false;
 					CurObj->StartedSince = 0;
@@ -789,7 +1204,6 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 				{ /*Just send SIGTERM.*/
 					if (!CurObj->Opts.NoStopWait)
 					{
-						unsigned TInc = 0;
 						Bool Abort = false;
 						
 						CurrentTask.Node = (void*)&Abort;
@@ -797,18 +1211,10 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 						CurrentTask.TaskName = CurObj->ObjectID;
 						CurrentTask.Set = true;
 								
-						/*Give it ten seconds to terminate on it's own.*/
-						for (; kill(CurObj->ObjectPID, 0) == 0 && TInc < CurObj->Opts.StopTimeout * 20 && !Abort; ++TInc)
-						{
-							
-							waitpid(CurObj->ObjectPID, NULL, WNOHANG); /*We must harvest the PID since we have occupied the primary loop.*/
-							
-							usleep(50000);
-						}
-						
-						if (TInc == CurObj->Opts.StopTimeout * 20)
+						/*Give it StopTimeout seconds to terminate on it's own.*/
+						if (WaitForObjectExit(CurObj, CurObj->ObjectPID, CurObj->Opts.StopTimeout, &Abort))
 						{
-							ExitStatus = FAILURE;
+							ExitStatus = SUCCESS;
 						}
 						else if (Abort)
 						{
@@ -816,7 +1222,7 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 						}
 						else
 						{
-							ExitStatus = SUCCESS;
+							ExitStatus = FAILURE;
 						}
 						
 						CurrentTask.Set = false;
@@ -836,6 +1242,8 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 				
 				if (ExitStatus)
 				{
+					CGroup_Release(CurObj, !CurObj->Opts.NoStopWait);
+					
 					CurObj->ObjectPID = 0;
 					CurObj->StartedSince = 0;
 					CurObj->Started = false;
@@ -872,7 +1280,6 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 				{
 					if (!CurObj->Opts.NoStopWait)
 					{ /*If we're free to wait for a PID to stop, do so.*/
-						unsigned TInc = 0;			
 						Bool Abort = false;
 						
 						CurrentTask.Node = (void*)&Abort;
@@ -880,18 +1287,10 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 						CurrentTask.TaskName = CurObj->ObjectID;
 						CurrentTask.Set = true;
 						
-						/*Give it ten seconds to terminate on it's own.*/
-						for (; kill(TruePID, 0) == 0 && TInc < CurObj->Opts.StopTimeout * 20 && !Abort; ++TInc)
-						{ /*Two hundred is ten seconds here.*/
-							
-							waitpid(TruePID, NULL, WNOHANG); /*We must harvest the PID since we have occupied the primary loop.*/
-							
-							usleep(50000);
-						}
-						
-						if (TInc == CurObj->Opts.StopTimeout * 20)
+						/*Give it StopTimeout seconds to terminate on it's own.*/
+						if (WaitForObjectExit(CurObj, TruePID, CurObj->Opts.StopTimeout, &Abort))
 						{
-							ExitStatus = FAILURE;
+							ExitStatus = SUCCESS;
 						}
 						else if (Abort)
 						{ /*Means we were killed via CTRL-ALT-DEL.*/
@@ -899,7 +1298,7 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 						}
 						else
 						{
-							ExitStatus = SUCCESS;
+							ExitStatus = FAILURE;
 						}
 						
 						CurrentTask.Set = false;
@@ -919,6 +1318,8 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 				
 				if (ExitStatus)
 				{
+					CGroup_Release(CurObj, !CurObj->Opts.NoStopWait);
+					
 					CurObj->Started = false;
 					CurObj->StartedSince = 0;
 					CurObj->ObjectPID = 0;
@@ -949,86 +1350,664 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 }
 
 /*This function does what it sounds like. It's not the entire boot sequence, we gotta display a message and stuff.*/
-ReturnCode RunAllObjects(Bool IsStartingMode)
-{
-	unsigned MaxPriority = GetHighestPriority(IsStartingMode);
-	unsigned Inc = 1; /*One to skip zero.*/
-	ObjTable *CurObj = NULL;
-	ObjTable *LastNode = NULL;
+static Bool ObjectWantedForRun(const ObjTable *CurObj, Bool IsStartingMode)
+{ /*Decides if RunAllObjects() should touch this object at all.*/
 	
-	if (!MaxPriority && IsStartingMode)
+	//Disabled in config but enabled from kernel cli
+	if (!CurObj->Enabled && IsStartingMode && CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(CurObj->ObjectID, true))
 	{
-		SpitError("All objects have a priority of zero!");
-		return FAILURE;
+		goto NextLogic;
 	}
 	
-	CurrentBootMode = (IsStartingMode ? BOOT_BOOTUP : BOOT_SHUTDOWN);
+	if (!CurObj->Enabled && (IsStartingMode || CurObj->Opts.HaltCmdOnly))
+	{ /*Stop even disabled objects, but not disabled HALTONLY objects.*/
+		return false;
+	}
+	
+NextLogic:
+	//Enabled in config but disabled from kernel cli
+	if (IsStartingMode && CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(CurObj->ObjectID, false))
+	{
+		return false;
+	}
+
+	if (IsStartingMode && CurObj->Opts.HaltCmdOnly)
+	{
+		return false;
+	}
+	
+	return (IsStartingMode ? !CurObj->Started : CurObj->Started);
+}
+
+static Bool InteractivePrompt(const ObjTable *CurObj)
+{ //We are being requested to prompt for everything we do on bootup.
+	char Char;
+	
+	printf("\nStart bootup object %s?\n[y/N] ", CurObj->ObjectID);
+	
+	Char = getchar();
 	
-	for (; Inc <= MaxPriority; ++Inc)
+ReGet:
+	switch (tolower(Char))
 	{
-		for (LastNode = NULL;
-			(CurObj = GetObjectByPriority((IsStartingMode ? CurRunlevel : NULL), LastNode, IsStartingMode, Inc));
-			LastNode = CurObj)
-		{ /*Probably set to zero or something, but we don't care if we have a gap in the priority system.*/
+		case 'y':
+			return true;
+		case '\n':
+			Char = getchar();
+			goto ReGet;
+		default:
+			return false;
+	}
+}
+
+static short BootJobReady(const struct _BootJob *Jobs, unsigned NumJobs, unsigned Index)
+{ /*Returns 1 if the job can start now, 0 if it has to wait, and -1 if it never can.*/
+	const ObjTable *const CurObj = Jobs[Index].Obj;
+	unsigned Inc = 0;
+	
+	if (CurObj->ObjectRequires || CurObj->ObjectAfter)
+	{ /*Explicit dependencies replace the priority barrier, so independent branches can overlap.*/
+		const char *Lists[2] = { CurObj->ObjectRequires, CurObj->ObjectAfter };
+		const char *Worker = NULL;
+		char DepID[MAX_DESCRIPT_SIZE];
+		unsigned DInc = 0, TInc = 0;
 		
-			if (CurObj == (void*)-1)
+		for (; DInc < 2; ++DInc)
+		{
+			if (!(Worker = Lists[DInc])) continue;
+			
+			do
 			{
-				return FAILURE;
-			}
+				const ObjTable *DepObj = NULL;
+				
+				for (TInc = 0; Worker[TInc] != ' ' && Worker[TInc] != '\t' &&
+					Worker[TInc] != '\0' && TInc < sizeof DepID - 1; ++TInc)
+				{
+					DepID[TInc] = Worker[TInc];
+				}
+				DepID[TInc] = '\0';
+				
+				if (!*DepID || !strcmp(DepID, CurObj->ObjectID)) continue;
+				
+				DepObj = LookupObjectInTable(DepID);
+				
+				for (Inc = 0; Inc < NumJobs && Jobs[Inc].Obj != DepObj; ++Inc);
+				
+				if (Inc == NumJobs)
+				{ /*Not part of this boot. That's fine for ObjectAfter, and for ObjectRequires if it's already up.*/
+					if (DInc == 0 && (!DepObj || !DepObj->Started)) return -1;
+					continue;
+				}
+				
+				switch (Jobs[Inc].State)
+				{
+					case JOB_PENDING:
+					case JOB_RUNNING:
+						return 0;
+					case JOB_FAILED:
+						if (DInc == 0) return -1;
+						break;
+					default:
+						break;
+				}
+			} while ((Worker = WhitespaceArg(Worker)));
+		}
+		
+		return 1;
+	}
+	
+	/*No dependencies, so everything with a lower priority must be finished first. Same as always.*/
+	for (Inc = 0; Inc < NumJobs && Jobs[Inc].Priority < Jobs[Index].Priority; ++Inc)
+	{
+		if (Jobs[Inc].State == JOB_PENDING || Jobs[Inc].State == JOB_RUNNING) return 0;
+	}
+	
+	return 1;
+}
+
+static void JobReport(const ObjTable *CurObj, Bool IsStartingMode, ReturnCode ExitStatus, char *LogText)
+{ /*Boot workers and grouped stops don't print anything, so we print the whole status line at once when they finish.
+	* Whatever a boot worker logged comes back to us as LogText, already dated, and goes into our log here.*/
+	char PrintOutStream[1024];
+	
+	while (LogText && *LogText)
+	{
+		char *const LineEnd = strchr(LogText, '\n');
+		
+		if (LineEnd) *LineEnd = '\0';
+		
+		WriteLogLine(LogText, false);
+		
+		LogText = LineEnd ? LineEnd + 1 : LogText + strlen(LogText);
+	}
+	
+	if (CurObj->Opts.RawDescription)
+	{
+		snprintf(PrintOutStream, sizeof PrintOutStream, "%s", CurObj->ObjectDescription);
+	}
+	else
+	{
+		snprintf(PrintOutStream, sizeof PrintOutStream, "%s %s", IsStartingMode ? "Starting" : "Stopping", CurObj->ObjectDescription);
+	}
+	
+	BeginStatusReport(PrintOutStream);
+	CompleteStatusReport(PrintOutStream, ExitStatus, true);
+}
+
+static ReturnCode RunBootScheduler(void)
+{ /*Starts objects as soon as whatever they wait on is finished, up to BootWorkers at a time.*/
+	struct _BootJob *Jobs = NULL;
+	unsigned NumJobs = 0, Inc = 0;
+	ObjTable **Schedule = GetObjectSchedule(CurRunlevel, true);
+#ifdef NOMMU /*No fork() for us, so we can only honour the ordering.*/
+	const unsigned MaxWorkers = 1;
+#else
+	const unsigned MaxWorkers = BootWorkers;
+#endif
+
+	if (!Schedule) return FAILURE;
+	
+	for (; Schedule[Inc]; ++Inc);
+	
+	Jobs = malloc(sizeof(struct _BootJob) * (Inc + 1));
+	
+	/*Build the job list. The schedule is already in priority order.*/
+	for (Inc = 0; Schedule[Inc]; ++Inc)
+	{
+		if (!ObjectWantedForRun(Schedule[Inc], true)) continue;
+		
+		Jobs[NumJobs].Obj = Schedule[Inc];
+		Jobs[NumJobs].Priority = Schedule[Inc]->ObjectStartPriority;
+		Jobs[NumJobs].WorkerPID = 0;
+		Jobs[NumJobs].Pipe = -1;
+		Jobs[NumJobs].State = JOB_PENDING;
+		++NumJobs;
+	}
+	
+	while (1)
+	{
+		unsigned Running = 0, Pending = 0;
+		Bool Progress = false;
+		
+		for (Inc = 0; Inc < NumJobs; ++Inc)
+		{
+			if (Jobs[Inc].State == JOB_RUNNING) ++Running;
+			else if (Jobs[Inc].State == JOB_PENDING) ++Pending;
+		}
+		
+		if (!Running && !Pending) break;
+		
+		for (Inc = 0; Inc < NumJobs && Running < MaxWorkers; ++Inc)
+		{
+			ObjTable *const JobObj = Jobs[Inc].Obj;
+			
+			if (Jobs[Inc].State != JOB_PENDING) continue;
 			
-			//Disabled in config but enabled from kernel cli
-			if (!CurObj->Enabled && IsStartingMode && CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(CurObj->ObjectID, true))
+			switch (BootJobReady(Jobs, NumJobs, Inc))
 			{
-				goto NextLogic;
+				case 0:
+					continue;
+				case -1:
+				{
+					char TmpBuf[MAX_LINE_SIZE];
+					
+					snprintf(TmpBuf, sizeof TmpBuf, "Not starting object %s, an object it requires did not start.", JobObj->ObjectID);
+					WriteLogLine(TmpBuf, true);
+					SpitWarning(TmpBuf);
+					
+					Jobs[Inc].State = JOB_FAILED;
+					Progress = true;
+					continue;
+				}
+				default:
+					break;
 			}
 			
-			if (!CurObj->Enabled && (IsStartingMode || CurObj->Opts.HaltCmdOnly))
-			{ /*Stop even disabled objects, but not disabled HALTONLY objects.*/
+			/*Anything that takes over the console or the whole system runs alone, in our own process.*/
+			if (MaxWorkers == 1 || JobObj->Opts.Exec || JobObj->Opts.PivotRoot || JobObj->Opts.StartFailIsCritical ||
+				(InteractiveBoot && JobObj->Opts.Interactive))
+			{
+				if (Running) break; /*Let the workers drain first, and don't start anything else meanwhile.*/
+				
+				if (InteractiveBoot && JobObj->Opts.Interactive && !InteractivePrompt(JobObj))
+				{
+					Jobs[Inc].State = JOB_DONE; /*Skipping it is not a failure.*/
+				}
+				else
+				{
+					Jobs[Inc].State = ProcessConfigObject(JobObj, true, true) ? JOB_DONE : JOB_FAILED;
+				}
+				
+				Progress = true;
 				continue;
 			}
-			
-		NextLogic:
-			//Enabled in config but disabled from kernel cli
-			if (IsStartingMode && CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(CurObj->ObjectID, false))
+#ifndef NOMMU
 			{
-				continue;
+				int Pipes[2];
+				pid_t WorkerPID;
+				
+				if (pipe(Pipes) == -1)
+				{ /*Just do it ourselves.*/
+					Jobs[Inc].State = ProcessConfigObject(JobObj, true, true) ? JOB_DONE : JOB_FAILED;
+					Progress = true;
+					continue;
+				}
+				
+				/*Don't let the objects we launch inherit these.*/
+				fcntl(Pipes[0], F_SETFD, FD_CLOEXEC);
+				fcntl(Pipes[1], F_SETFD, FD_CLOEXEC);
+				
+				if (JobObj->UserID != 0 && !JobObj->Credentials)
+				{ /*ExecuteConfigObject() would retry this in the worker, but then only the worker's copy would get it.*/
+					ObjTable_LoadCredentials(JobObj);
+				}
+				
+				FlushLogBuffer();
+				
+				if ((WorkerPID = fork()) == -1)
+				{
+					close(Pipes[0]);
+					close(Pipes[1]);
+					
+					Jobs[Inc].State = ProcessConfigObject(JobObj, true, true) ? JOB_DONE : JOB_FAILED;
+					Progress = true;
+					continue;
+				}
+				
+				if (WorkerPID == 0)
+				{ /*The worker. Start the object and tell the parent how it went.*/
+					struct _BootJobResult Result;
+					size_t Sent = 0;
+					ssize_t Written = 0;
+					
+					close(Pipes[0]);
+					
+					/*Anything we log would die with us, so keep it all in memory and send it to the parent.
+					 * The parent's copy of MemLogBuffer is its business, we start our own.*/
+					LogInMemory = true;
+					MemLogBuffer = NULL;
+					MemLogLength = 0;
+					
+					memset(&Result, 0, sizeof Result);
+					Result.ExitStatus = ProcessConfigObject(JobObj, true, false);
+					Result.ObjectPID = JobObj->ObjectPID;
+					Result.StartedSince = JobObj->StartedSince;
+					Result.Started = JobObj->Started;
+					Result.Enabled = JobObj->Enabled;
+					Result.LogLength = MemLogBuffer ? MemLogLength : 0;
+					
+					write(Pipes[1], &Result, sizeof Result);
+					
+					for (; Sent < Result.LogLength && (Written = write(Pipes[1], MemLogBuffer + Sent, Result.LogLength - Sent)) > 0; Sent += Written);
+					
+					_exit(0);
+				}
+				
+				close(Pipes[1]);
+				
+				Jobs[Inc].WorkerPID = WorkerPID;
+				Jobs[Inc].Pipe = Pipes[0];
+				Jobs[Inc].State = JOB_RUNNING;
+				
+				++Running;
+				Progress = true;
 			}
+#endif /*NOMMU*/
+		}
 		
-			if (IsStartingMode && CurObj->Opts.HaltCmdOnly)
+		if (Running)
+		{ /*Wait for at least one worker to finish.*/
+			struct pollfd PollSet[MAX_BOOT_WORKERS];
+			unsigned JobMap[MAX_BOOT_WORKERS], NumPolled = 0, PInc = 0;
+			
+			for (Inc = 0; Inc < NumJobs && NumPolled < MAX_BOOT_WORKERS; ++Inc)
 			{
-				continue;
+				if (Jobs[Inc].State != JOB_RUNNING) continue;
+				
+				PollSet[NumPolled].fd = Jobs[Inc].Pipe;
+				PollSet[NumPolled].events = POLLIN;
+				PollSet[NumPolled].revents = 0;
+				JobMap[NumPolled++] = Inc;
 			}
 			
-			if ((IsStartingMode ? !CurObj->Started : CurObj->Started))
+			if (poll(PollSet, NumPolled, -1) <= 0) continue; /*Probably EINTR.*/
+			
+			for (PInc = 0; PInc < NumPolled; ++PInc)
 			{
-				if (InteractiveBoot && CurrentBootMode == BOOT_BOOTUP && CurObj->Opts.Interactive)
-				{ //We are being requested to prompt for everything we do on bootup.
-					printf("\nStart bootup object %s?\n[y/N] ", CurObj->ObjectID);
+				struct _BootJob *const Job = Jobs + JobMap[PInc];
+				struct _BootJobResult Result;
+				char *LogText = NULL;
+				
+				if (!PollSet[PInc].revents) continue;
+				
+				if (read(Job->Pipe, &Result, sizeof Result) != sizeof Result)
+				{ /*Worker died before it could tell us anything.*/
+					memset(&Result, 0, sizeof Result);
+					Result.ExitStatus = FAILURE;
+					Result.Enabled = Job->Obj->Enabled;
+				}
+				
+				if (Result.LogLength && (LogText = malloc(Result.LogLength + 1)))
+				{ /*The worker's log lines. It can't exit until we've read them all.*/
+					size_t Received = 0;
+					ssize_t Got = 0;
 					
+					for (; Received < Result.LogLength && (Got = read(Job->Pipe, LogText + Received, Result.LogLength - Received)) > 0; Received += Got);
+					
+					LogText[Received] = '\0';
+				}
+				
+				close(Job->Pipe);
+				Job->Pipe = -1;
+				waitpid(Job->WorkerPID, NULL, 0);
+				Job->WorkerPID = 0;
+				
+				Job->Obj->Started = Result.Started;
+				Job->Obj->ObjectPID = Result.ObjectPID;
+				Job->Obj->StartedSince = Result.StartedSince;
+				Job->Obj->Enabled = Result.Enabled;
+				
+				if (Job->Obj->Started && !Job->Obj->Opts.HasPIDFile)
+				{ /*The worker's pidfd died with it, get our own.*/
+					GetObjectPIDFD(Job->Obj, Job->Obj->ObjectPID);
+				}
+				
+				JobReport(Job->Obj, true, Result.ExitStatus, LogText);
+				free(LogText);
+				
+				Job->State = Result.ExitStatus ? JOB_DONE : JOB_FAILED;
+			}
+			
+			continue;
+		}
+		
+		if (!Progress)
+		{ /*Nothing running and nothing can start. We have a dependency loop.*/
+			for (Inc = 0; Inc < NumJobs; ++Inc)
+			{
+				char TmpBuf[MAX_LINE_SIZE];
+				
+				if (Jobs[Inc].State != JOB_PENDING) continue;
+				
+				snprintf(TmpBuf, sizeof TmpBuf, "Not starting object %s, it is part of a dependency loop.", Jobs[Inc].Obj->ObjectID);
+				WriteLogLine(TmpBuf, true);
+				SpitError(TmpBuf);
+				
+				Jobs[Inc].State = JOB_FAILED;
+			}
+		}
+	}
+	
+	free(Jobs);
+	
+	return SUCCESS;
+}
 
+static Bool ObjectStopsBySignal(const ObjTable *CurObj)
+{ /*Objects we can stop along with the rest of their stop priority, because all it takes is a signal and a wait.*/
+	return (CurObj->Opts.StopMode == STOP_PID || CurObj->Opts.StopMode == STOP_PIDFILE) && !CurObj->Opts.NoStopWait;
+}
 
-					char Char = getchar();
-					
-				ReGet:
-					switch (tolower(Char))
-					{
-						case 'y':
-							ProcessConfigObject(CurObj, IsStartingMode, true);
-							continue;
-						case '\n':
-							Char = getchar();
-							goto ReGet;
-						default:
-							continue;
-					}
+static unsigned StopGroup_Wait(struct _StopJob *Jobs, unsigned NumJobs, struct pollfd *PollFDs, unsigned Timeout, const Bool *Abort)
+{ /*WaitForObjectExit() for a whole group at once, with one deadline for all of them.
+	* Returns how many are still running.*/
+	struct timespec Now, Deadline;
+	unsigned Inc, NumWaiting = 0;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Deadline);
+	Deadline.tv_sec += Timeout;
+	
+	while (1)
+	{
+		unsigned NumFDs = 0;
+		Bool MustPoll = false; /*Somebody has no pidfd, so we have to go look with kill() every 50 msecs.*/
+		int Remaining;
+		
+		for (Inc = 0, NumWaiting = 0; Inc < NumJobs; ++Inc)
+		{
+			struct _StopJob *const Job = Jobs + Inc;
+			int FD;
+			
+			Job->PollSlot = -1;
+			
+			if (!Job->Waiting) continue;
+			
+			if ((FD = GetObjectPIDFD(Job->Obj, Job->PID)) != -1)
+			{
+				Job->PollSlot = NumFDs;
+				PollFDs[NumFDs].fd = FD;
+				PollFDs[NumFDs].events = POLLIN;
+				PollFDs[NumFDs].revents = 0;
+				++NumFDs;
+			}
+			else if (errno != ESRCH)
+			{ /*No pidfd support, so fall back to polling.*/
+				waitpid(Job->PID, NULL, WNOHANG); /*We must harvest the PID since we have occupied the primary loop.*/
+				
+				if (kill(Job->PID, 0) == 0)
+				{
+					MustPoll = true;
+					++NumWaiting;
+					continue;
 				}
 				
-				//Not interactive, just do it.
-				ProcessConfigObject(CurObj, IsStartingMode, true);
+				Job->Waiting = false;
+				continue;
 			}
+			else
+			{ /*Already gone.*/
+				Job->Waiting = false;
+				continue;
+			}
+			
+			++NumWaiting;
+		}
+		
+		if (!NumWaiting || *Abort) break;
+		
+		clock_gettime(CLOCK_MONOTONIC, &Now);
+		
+		Remaining = (Deadline.tv_sec - Now.tv_sec) * 1000 + (Deadline.tv_nsec - Now.tv_nsec) / 1000000;
+		
+		if (Remaining <= 0) break;
+		
+		if (MustPoll && Remaining > 50) Remaining = 50;
+		
+		if (poll(PollFDs, NumFDs, Remaining) <= 0) continue; /*Timeout, or EINTR, probably CTRL-ALT-DEL setting *Abort. Go around.*/
+		
+		for (Inc = 0; Inc < NumJobs; ++Inc)
+		{
+			if (Jobs[Inc].PollSlot == -1 || !PollFDs[Jobs[Inc].PollSlot].revents) continue;
+			
+			waitpid(Jobs[Inc].PID, NULL, WNOHANG); /*Harvest it if it's ours.*/
+			Jobs[Inc].Waiting = false;
 		}
 	}
 	
+	return NumWaiting;
+}
+
+static void StopPriorityGroup(ObjTable **Group, unsigned NumObjs)
+{ /*Signals every PID and PIDFILE object sharing a stop priority at once and waits on them together,
+	* so shutdown takes as long as the slowest one and not all of them added up.
+	* Whatever outlives the longest StopTimeout in the group gets SIGKILL.*/
+	struct _StopJob *Jobs = malloc(sizeof(struct _StopJob) * NumObjs);
+	struct pollfd *PollFDs = malloc(sizeof(struct pollfd) * NumObjs);
+	char TaskName[MAX_DESCRIPT_SIZE];
+	unsigned Inc = 0, Timeout = 0;
+	Bool Abort = false;
+	
+	if (!Jobs || !PollFDs)
+	{ /*Do it one at a time like we used to.*/
+		free(Jobs);
+		free(PollFDs);
+		
+		for (; Inc < NumObjs; ++Inc) ProcessConfigObject(Group[Inc], false, true);
+		return;
+	}
+	
+	for (; Inc < NumObjs; ++Inc)
+	{
+		ObjTable *const CurObj = Group[Inc];
+		struct _StopJob *const Job = Jobs + Inc;
+		
+		Job->Obj = CurObj;
+		
+		/*We need to do this so objects that are stopped have no chance of restarting themselves.*/
+		Job->LastAutoRestartState = CurObj->Opts.AutoRestart;
+		CurObj->Opts.AutoRestart = false;
+		
+		Job->PID = (CurObj->Opts.StopMode == STOP_PIDFILE ? ReadPIDFile(CurObj) : CurObj->ObjectPID);
+		Job->Waiting = Job->PID && kill(Job->PID, CurObj->TermSignal) == 0;
+		Job->ExitStatus = (Job->Waiting ? SUCCESS : FAILURE);
+		
+		if (Job->Waiting && CurObj->Opts.StopTimeout > Timeout) Timeout = CurObj->Opts.StopTimeout;
+	}
+	
+	snprintf(TaskName, sizeof TaskName, "stop priority %u", Group[0]->ObjectStopPriority);
+	
+	CurrentTask.Node = (void*)&Abort;
+	CurrentTask.PID = 0;
+	CurrentTask.TaskName = TaskName;
+	CurrentTask.Set = true;
+	
+	if (StopGroup_Wait(Jobs, NumObjs, PollFDs, Timeout, &Abort))
+	{ /*Out of time, or CTRL-ALT-DEL told us to quit waiting. Either way, the rest don't get a say anymore.*/
+		for (Inc = 0; Inc < NumObjs; ++Inc)
+		{
+			if (!Jobs[Inc].Waiting) continue;
+			
+			kill(Jobs[Inc].PID, SIGKILL);
+			Jobs[Inc].ExitStatus = WARNING;
+		}
+		
+		Abort = false;
+		
+		if (StopGroup_Wait(Jobs, NumObjs, PollFDs, STOP_KILL_GRACE, &Abort))
+		{
+			for (Inc = 0; Inc < NumObjs; ++Inc)
+			{
+				if (Jobs[Inc].Waiting) Jobs[Inc].ExitStatus = FAILURE;
+			}
+		}
+	}
+	
+	CurrentTask.Set = false;
+	CurrentTask.Node = NULL;
+	CurrentTask.TaskName = NULL;
+	CurrentTask.PID = 0;
+	
+	for (Inc = 0; Inc < NumObjs; ++Inc)
+	{
+		ObjTable *const CurObj = Jobs[Inc].Obj;
+		
+		if (Jobs[Inc].ExitStatus)
+		{
+			CGroup_Release(CurObj, true);
+			
+			CurObj->ObjectPID = 0;
+			CurObj->StartedSince = 0;
+			CurObj->Started = false;
+		}
+		
+		JobReport(CurObj, false, Jobs[Inc].ExitStatus, NULL);
+		
+		if (!Jobs[Inc].ExitStatus && CurObj->Opts.StopFailIsCritical)
+		{
+			fprintf(stderr, "\n" CONSOLE_COLOR_RED "CRITICAL: " CONSOLE_ENDCOLOR
+					"stop of critically important object \"%s\" has failed.", CurObj->ObjectID);
+			EmergencyShell();
+		}
+		
+		CurObj->Opts.AutoRestart = Jobs[Inc].LastAutoRestartState;
+	}
+	
+	free(Jobs);
+	free(PollFDs);
+}
+
+ReturnCode RunAllObjects(Bool IsStartingMode)
+{
+	unsigned MaxPriority = GetHighestPriority(IsStartingMode);
+	ObjTable *CurObj = NULL;
+	ObjTable **Schedule = NULL, **Group = NULL;
+	unsigned GroupPriority = 0; /*Zero never makes it into the schedule.*/
+	
+	if (!MaxPriority && IsStartingMode)
+	{
+		SpitError("All objects have a priority of zero!");
+		return FAILURE;
+	}
+	
+	CurrentBootMode = (IsStartingMode ? BOOT_BOOTUP : BOOT_SHUTDOWN);
+	
+	if (IsStartingMode)
+	{ /*The scheduler handles both parallel boot and ObjectRequires/ObjectAfter ordering.*/
+		Bool UseScheduler = BootWorkers > 1;
+		
+		for (CurObj = ObjectTable; !UseScheduler && CurObj->Next; CurObj = CurObj->Next)
+		{
+			if (CurObj->ObjectRequires || CurObj->ObjectAfter) UseScheduler = true;
+		}
+		
+		if (UseScheduler)
+		{
+			const ReturnCode RetVal = RunBootScheduler();
+			
+			CurrentBootMode = BOOT_NEUTRAL;
+			return RetVal;
+		}
+	}
+	
+	if (!(Schedule = GetObjectSchedule((IsStartingMode ? CurRunlevel : NULL), IsStartingMode)))
+	{
+		CurrentBootMode = BOOT_NEUTRAL;
+		return FAILURE;
+	}
+	
+	if (!IsStartingMode)
+	{ /*Room for the biggest stop priority group there could be. If we don't get it, we just stop them one by one.*/
+		unsigned Inc = 0;
+		
+		for (; Schedule[Inc]; ++Inc);
+		
+		Group = malloc(sizeof(ObjTable*) * (Inc + 1));
+	}
+	
+	for (; (CurObj = *Schedule); ++Schedule)
+	{ /*Priority zero objects aren't in the schedule, and we don't care if we have a gap in the priority system.*/
+		if (!ObjectWantedForRun(CurObj, IsStartingMode)) continue;
+		
+		if (InteractiveBoot && CurrentBootMode == BOOT_BOOTUP && CurObj->Opts.Interactive && !InteractivePrompt(CurObj))
+		{
+			continue;
+		}
+		
+		if (Group && ObjectStopsBySignal(CurObj))
+		{ /*The first one we meet at this stop priority takes everybody else who stops by signal along with it.*/
+			unsigned Inc = 0, NumObjs = 0;
+			
+			if (CurObj->ObjectStopPriority == GroupPriority) continue; /*Already stopped with its group.*/
+			
+			GroupPriority = CurObj->ObjectStopPriority;
+			
+			for (; Schedule[Inc] && Schedule[Inc]->ObjectStopPriority == GroupPriority; ++Inc)
+			{
+				if (ObjectStopsBySignal(Schedule[Inc]) && ObjectWantedForRun(Schedule[Inc], false))
+				{
+					Group[NumObjs++] = Schedule[Inc];
+				}
+			}
+			
+			StopPriorityGroup(Group, NumObjs);
+			continue;
+		}
+		
+		ProcessConfigObject(CurObj, IsStartingMode, true);
+	}
+	
+	free(Group);
+	
 	CurrentBootMode = BOOT_NEUTRAL;
 	
 	return SUCCESS;
@@ -1073,19 +2052,19 @@ ReturnCode ProcessReloadCommand(ObjTable *CurObj, Bool PrintStatus)
 
 ReturnCode SwitchRunlevels(const char *Runlevel)
 {
-	unsigned NumInRunlevel = 0, CurPriority = 1, MaxPriority;
-	ObjTable *TObj = ObjectTable;
-	ObjTable *LastNode = NULL;
+	unsigned NumInRunlevel = 0;
+	ObjTable *TObj = NULL;
+	ObjTable **Schedule = NULL;
+	
 	/*Check the runlevel has objects first.*/
+	if (!(Schedule = GetObjectSchedule(Runlevel, true)))
+	{
+		return FAILURE;
+	}
 	
-	for (; TObj->Next != NULL; TObj = TObj->Next)
-	{ /*I think a while loop would look much better, but if I did that,
-		* I'd get folks asking "why didn't you use a for loop?", so here!*/
-		if (!TObj->Opts.HaltCmdOnly && ObjRL_CheckRunlevel(Runlevel, TObj, true) &&
-			TObj->Enabled && TObj->ObjectStartPriority > 0)
-		{
-			++NumInRunlevel;
-		}
+	for (; (TObj = *Schedule); ++Schedule)
+	{
+		if (!TObj->Opts.HaltCmdOnly && TObj->Enabled) ++NumInRunlevel;
 	}
 	
 	if (NumInRunlevel == 0)
@@ -1094,41 +2073,34 @@ ReturnCode SwitchRunlevels(const char *Runlevel)
 	}
 	
 	/*Stop everything not meant for this runlevel.*/
-	for (MaxPriority = GetHighestPriority(false); CurPriority <= MaxPriority; ++CurPriority)
+	if (!(Schedule = GetObjectSchedule(CurRunlevel, false)))
+	{
+		return FAILURE;
+	}
+	
+	for (; (TObj = *Schedule); ++Schedule)
 	{
-		for (LastNode = NULL; (TObj = GetObjectByPriority(CurRunlevel, LastNode, false, CurPriority)); LastNode = TObj)
+		if (TObj->Started && !TObj->Opts.Persistent && !TObj->Opts.HaltCmdOnly &&
+			!ObjRL_CheckRunlevel(Runlevel, TObj, true))
 		{
-			if (TObj == (void*)-1)
-			{
-				return FAILURE;
-			}
-			
-			if (TObj->Started && !TObj->Opts.Persistent && !TObj->Opts.HaltCmdOnly &&
-				!ObjRL_CheckRunlevel(Runlevel, TObj, true))
-			{
-				ProcessConfigObject(TObj, false, true);
-			}
+			ProcessConfigObject(TObj, false, true);
 		}
 	}
 	
 	/*Good to go, so change us to the new runlevel.*/
 	snprintf(CurRunlevel, MAX_DESCRIPT_SIZE, "%s", Runlevel);
-	MaxPriority = GetHighestPriority(true);
 	
 	/*Now start the things that ARE meant for our runlevel.*/
-	for (CurPriority = 1; CurPriority <= MaxPriority; ++CurPriority)
+	if (!(Schedule = GetObjectSchedule(CurRunlevel, true)))
 	{
-		for (LastNode = NULL; (TObj = GetObjectByPriority(CurRunlevel, LastNode, true, CurPriority)); LastNode = TObj)
+		return FAILURE;
+	}
+	
+	for (; (TObj = *Schedule); ++Schedule)
+	{
+		if (TObj->Enabled && !TObj->Started)
 		{
-			if (TObj == (void*)-1)
-			{
-				return FAILURE;
-			}
-			
-			if (TObj->Enabled && !TObj->Started)
-			{
-				ProcessConfigObject(TObj, true, true);
-			}
+			ProcessConfigObject(TObj, true, true);
 		}
 	}
 	
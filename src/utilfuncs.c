@@ -14,7 +14,15 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
 
 #include "epoch.h"
 
@@ -23,11 +31,27 @@ Bool EnableLogging = true;
 Bool LogInMemory = true; /*This is necessary so long as we have a readonly filesystem.*/
 Bool BlankLogOnBoot = true;
 char *MemLogBuffer;
+size_t MemLogLength; /*Bytes used in MemLogBuffer, not counting the null terminator.*/
+static size_t MemLogCapacity;
 
 /*Days in the month, for time stuff.*/
 static const unsigned char MDays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
 char LogFile[MAX_LINE_SIZE] = LOGFILE;
 
+/*Lines waiting to be written to LogFile. It's a ring, so a flush is one writev() of at most two pieces.*/
+static struct
+{
+	char Data[LOG_BUFFER_SIZE];
+	size_t Head; /*Where the oldest unwritten byte lives.*/
+	size_t Length;
+} LogRing;
+
+static int LogDescriptor = -1;
+static char LogDescriptorPath[MAX_LINE_SIZE]; /*What LogFile was when we opened LogDescriptor.*/
+static Bool LogFailedBefore = false;
+
+char CGroupHierarchy[MAX_LINE_SIZE] = CGROUP_HIERARCHY; /*Empty if the config said NONE.*/
+
 Bool AllNumeric(const char *InStream)
 { /*Is the string all numbers?*/
 	if (!*InStream)
@@ -46,33 +70,140 @@ Bool AllNumeric(const char *InStream)
 	return true;
 }
 
-ReturnCode WriteLogLine(const char *InStream, Bool AddDate)
-{ /*This is pretty much the entire logging system.*/
-	FILE *Descriptor = NULL;
-	char Hr[16], Min[16], Sec[16], Month[16], Day[16], Year[16], OBuf[MAX_LINE_SIZE + 64] = { '\0' };
-	static Bool FailedBefore = false;
+static Bool OpenLogFile(Bool Truncate)
+{ /*Keeps one descriptor open instead of an fopen() for every line. Reopens if LogFile changed under us.*/
+	if (LogDescriptor != -1 && !Truncate && !strcmp(LogDescriptorPath, LogFile))
+	{
+		return true;
+	}
 	
-	if (!EnableLogging)
+	if (LogDescriptor != -1)
 	{
-		return SUCCESS;
+		close(LogDescriptor);
 	}
 	
-	if (!LogInMemory && !(Descriptor = fopen(LogFile, "a")))
+	if ((LogDescriptor = open(LogFile, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC | (Truncate ? O_TRUNC : 0), 0666)) == -1)
+	{ /*We'll try again next time; the filesystem might just not be writable yet.*/
+		return false;
+	}
+	
+	snprintf(LogDescriptorPath, sizeof LogDescriptorPath, "%s", LogFile);
+	
+	return true;
+}
+
+static void LogFailure(void)
+{
+	if (!LogFailedBefore)
 	{
-		if (!FailedBefore)
-		{
-			FailedBefore = true;
-			SpitWarning("Cannot write to log file. Log system is inoperative. Check permissions?");
-		}
+		LogFailedBefore = true;
+		SpitWarning("Cannot write to log file. Log system is inoperative. Check permissions?");
+	}
+}
+
+static const char *LogTimestamp(void)
+{ /*localtime_r() and friends for every line is silly when most lines land in the same second.*/
+	static time_t LastTime = -1;
+	static char Stamp[64];
+	time_t CurrentTime = time(NULL);
+	
+	if (CurrentTime != LastTime)
+	{
+		struct tm TimeStruct;
 		
+		localtime_r(&CurrentTime, &TimeStruct);
+		strftime(Stamp, sizeof Stamp, "%H:%M:%S | %Y-%m-%d", &TimeStruct);
+		LastTime = CurrentTime;
+	}
+	
+	return Stamp;
+}
+
+ReturnCode FlushLogBuffer(void)
+{ /*Write out everything in the ring in one go.*/
+	struct iovec Chunks[2];
+	int NumChunks = 1;
+	ssize_t Written;
+	
+	if (!LogRing.Length)
+	{
+		return SUCCESS;
+	}
+	
+	if (!OpenLogFile(false))
+	{
+		LogFailure();
+		LogRing.Head = LogRing.Length = 0;
 		return FAILURE;
 	}
 	
-	GetCurrentTime(Hr, Min, Sec, Year, Month, Day);
+	Chunks[0].iov_base = LogRing.Data + LogRing.Head;
+	
+	if (LogRing.Head + LogRing.Length > LOG_BUFFER_SIZE)
+	{ /*Wrapped around.*/
+		Chunks[0].iov_len = LOG_BUFFER_SIZE - LogRing.Head;
+		Chunks[1].iov_base = LogRing.Data;
+		Chunks[1].iov_len = LogRing.Length - Chunks[0].iov_len;
+		NumChunks = 2;
+	}
+	else
+	{
+		Chunks[0].iov_len = LogRing.Length;
+	}
+	
+	Written = writev(LogDescriptor, Chunks, NumChunks);
+	
+	LogRing.Head = LogRing.Length = 0;
+	
+	if (Written == -1)
+	{
+		LogFailure();
+		return FAILURE;
+	}
+	
+	return SUCCESS;
+}
+
+ReturnCode WriteLogBuffer(const char *InBuffer, size_t Length, Bool Truncate)
+{ /*Write a block straight to the log, after whatever is already pending.*/
+	if (!FlushLogBuffer() || !OpenLogFile(Truncate))
+	{
+		return FAILURE;
+	}
+	
+	if (Length && write(LogDescriptor, InBuffer, Length) == -1)
+	{
+		return FAILURE;
+	}
+	
+	return SUCCESS;
+}
+
+void ShutdownLogging(void)
+{ /*Flush and close. Use before exec, fork-and-forget, or anything that wants the filesystem unbusy.
+	* The next line logged will just reopen it.*/
+	FlushLogBuffer();
+	
+	if (LogDescriptor != -1)
+	{
+		close(LogDescriptor);
+		LogDescriptor = -1;
+	}
+}
+
+ReturnCode WriteLogLine(const char *InStream, Bool AddDate)
+{ /*This is pretty much the entire logging system.*/
+	char OBuf[MAX_LINE_SIZE + 64] = { '\0' };
+	size_t Length, Tail, FirstPart;
+	
+	if (!EnableLogging)
+	{
+		return SUCCESS;
+	}
 	
 	if (AddDate)
 	{
-		snprintf(OBuf, MAX_LINE_SIZE + 64, "[%s:%s:%s | %s-%s-%s] %s\n", Hr, Min, Sec, Year, Month, Day, InStream);
+		snprintf(OBuf, MAX_LINE_SIZE + 64, "[%s] %s\n", LogTimestamp(), InStream);
 	}
 	else
 	{
@@ -81,36 +212,172 @@ ReturnCode WriteLogLine(const char *InStream, Bool AddDate)
 	
 	if (LogInMemory)
 	{
+		Length = strlen(OBuf);
+		
 		if (MemLogBuffer == NULL)
-		{
-			MemLogBuffer = malloc(1);
-			*MemLogBuffer = '\0';
+		{ /*Someone released it, so start over.*/
+			MemLogLength = MemLogCapacity = 0;
+		}
+		
+		if (MemLogLength + Length + 1 > MemLogCapacity)
+		{ /*Grow geometrically so a long boot log doesn't mean a copy per line.*/
+			if (!MemLogCapacity) MemLogCapacity = MAX_LINE_SIZE * 4;
+			
+			while (MemLogLength + Length + 1 > MemLogCapacity) MemLogCapacity *= 2;
+			
+			MemLogBuffer = realloc(MemLogBuffer, MemLogCapacity);
 		}
 		
-		MemLogBuffer = realloc(MemLogBuffer, strlen(MemLogBuffer) + strlen(OBuf) + 1);
+		memcpy(MemLogBuffer + MemLogLength, OBuf, Length + 1);
+		MemLogLength += Length;
 		
-		strncat(MemLogBuffer, OBuf, strlen(OBuf));
+		return SUCCESS;
 	}
-	else
+	
+	Length = strlen(OBuf);
+	
+	if (LogRing.Length + Length > LOG_BUFFER_SIZE && !FlushLogBuffer())
 	{
-		fwrite(OBuf, 1, strlen(OBuf), Descriptor);
-		
-		fflush(Descriptor);
-		fclose(Descriptor);
+		return FAILURE;
+	}
+	
+	Tail = (LogRing.Head + LogRing.Length) % LOG_BUFFER_SIZE;
+	FirstPart = (Tail + Length > LOG_BUFFER_SIZE ? LOG_BUFFER_SIZE - Tail : Length);
+	
+	memcpy(LogRing.Data + Tail, OBuf, FirstPart);
+	memcpy(LogRing.Data, OBuf + FirstPart, Length - FirstPart);
+	LogRing.Length += Length;
+	
+	if (!AreInit || CurrentBootMode == BOOT_SHUTDOWN)
+	{ /*Nobody will come back around to flush for us, and we don't want to hold the filesystem busy while unmounting.*/
+		ShutdownLogging();
 	}
 	
 	return SUCCESS;
 }
 	
 
-Bool ObjectProcessRunning(const ObjTable *InObj)
+int GetObjectPIDFD(ObjTable *InObj, unsigned PID)
+{ /*Get a pidfd for PID, reusing the one we have if it's for the same process.
+	* Once we hold one, a recycled PID can't fool us anymore.*/
+	if (InObj->PIDFD != -1 && InObj->PIDFDTarget == PID)
+	{
+		return InObj->PIDFD;
+	}
+	
+	CloseObjectPIDFD(InObj);
+	
+	if (!PID) return -1;
+	
+#ifdef SYS_pidfd_open
+	if ((InObj->PIDFD = syscall(SYS_pidfd_open, PID, 0)) == -1)
+	{ /*ESRCH means it's gone, ENOSYS means an old kernel. The caller sorts it out from errno.*/
+		return -1;
+	}
+	
+	InObj->PIDFDTarget = PID;
+	
+	if (ObjectWatchDescriptor != -1)
+	{ /*Let PrimaryLoop() know the moment it exits.*/
+		struct epoll_event Event;
+		
+		memset(&Event, 0, sizeof Event);
+		Event.events = EPOLLIN;
+		Event.data.fd = InObj->PIDFD;
+		epoll_ctl(ObjectWatchDescriptor, EPOLL_CTL_ADD, InObj->PIDFD, &Event);
+	}
+	
+	return InObj->PIDFD;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+void CloseObjectPIDFD(ObjTable *InObj)
+{
+	if (InObj->PIDFD != -1)
+	{
+		close(InObj->PIDFD); /*Also takes it out of PrimaryLoop()'s epoll set.*/
+		InObj->PIDFD = -1;
+	}
+	
+	InObj->PIDFDTarget = 0;
+}
+
+Bool WaitForObjectExit(ObjTable *InObj, unsigned PID, unsigned Timeout, const Bool *Abort)
+{ /*Sleep until PID exits, Timeout seconds pass, or *Abort gets set by a signal handler.
+	* Returns true only if the process is gone.*/
+	struct pollfd PollFD;
+	struct timespec Now, Deadline;
+	int Remaining;
+	
+	if ((PollFD.fd = GetObjectPIDFD(InObj, PID)) == -1)
+	{
+		unsigned Inc = 0;
+		
+		if (errno == ESRCH) return true;
+		
+		/*No pidfd support, so fall back to polling.*/
+		for (; kill(PID, 0) == 0 && Inc < Timeout * 20 && !*Abort; ++Inc)
+		{
+			waitpid(PID, NULL, WNOHANG); /*We must harvest the PID since we have occupied the primary loop.*/
+			usleep(50000);
+		}
+		
+		return kill(PID, 0) != 0;
+	}
+	
+	PollFD.events = POLLIN;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Deadline);
+	Deadline.tv_sec += Timeout;
+	
+	while (!*Abort)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &Now);
+		
+		Remaining = (Deadline.tv_sec - Now.tv_sec) * 1000 + (Deadline.tv_nsec - Now.tv_nsec) / 1000000;
+		
+		if (Remaining < 0) Remaining = 0;
+		
+		switch (poll(&PollFD, 1, Remaining))
+		{
+			case 1:
+				waitpid(PID, NULL, WNOHANG); /*Harvest it if it's ours, since we have occupied the primary loop.*/
+				return true;
+			case 0:
+				return false;
+			default: /*EINTR, probably CTRL-ALT-DEL setting *Abort. Go around.*/
+				break;
+		}
+	}
+	
+	return false;
+}
+
+Bool ObjectProcessRunning(ObjTable *InObj)
 { /*This is so much better than the convoluted /proc method we used before,
 	* but I was scared of using kill() for this purpose. I thought that
 	* some processes would notice it and whine. Lucky me that it turns out
-	* signal 0 is not real.*/
+	* signal 0 is not real. Now we use a pidfd when we can, because kill()
+	* can't tell our process from a new one that got the same PID.*/
+	switch (CGroup_Populated(InObj))
+	{ /*If it has a cgroup, that's the final word. It catches everything the object forked.*/
+		case 1:
+			return true;
+		case 0:
+			return false;
+		default:
+			return ObjectPIDRunning(InObj);
+	}
+}
+
+Bool ObjectPIDRunning(ObjTable *InObj)
+{ /*ObjectProcessRunning() without the cgroup, for callers that have already read cgroup.events.*/
 	pid_t InPID = 0;
+	struct pollfd PollFD;
 	
-
 	if (!InObj->Opts.HasPIDFile || !(InPID = ReadPIDFile(InObj)))
 	{ /*We got a PID file requested and present? Get PID from that, otherwise 
 		* get the PID from memory.*/
@@ -122,6 +389,17 @@ Bool ObjectProcessRunning(const ObjTable *InObj)
 		return false;
 	}
 	
+	if ((PollFD.fd = GetObjectPIDFD(InObj, InPID)) != -1)
+	{ /*A pidfd becomes readable when its process exits.*/
+		PollFD.events = POLLIN;
+		
+		return poll(&PollFD, 1, 0) == 0;
+	}
+	else if (errno == ESRCH)
+	{
+		return false;
+	}
+	
 	if (kill(InPID, 0) == 0)
 	{
 		return true;
@@ -266,21 +544,79 @@ void GetCurrentTime(char *OutHr, char *OutMin, char *OutSec, char *OutYear, char
 	}
 }
 
+static Bool PIDFindCmdLine(const ObjTable *InObj, char *OutBuf, unsigned OutBufSize)
+{ /*What the start command looks like in /proc/N/cmdline, minus the forbidden characters.*/
+	unsigned Countdown = 0;
+	
+	if (InObj->ObjectStartCommand == NULL || !*InObj->ObjectStartCommand)
+	{
+		return false;
+	}
+	
+	snprintf(OutBuf, OutBufSize, "%s", InObj->ObjectStartCommand);
+		
+	for (Countdown = strlen(OutBuf) - 1; Countdown > 0 &&
+		(OutBuf[Countdown] == ' ' || OutBuf[Countdown] == '\t' ||
+		OutBuf[Countdown] == '&' || OutBuf[Countdown] == ';'); --Countdown)
+	{
+		OutBuf[Countdown] = '\0';
+	}
+	
+	return true;
+}
+
+static int ReadProcCmdLine(const char *PIDString, char *OutBuf, unsigned OutBufSize)
+{ /*One read() for the whole thing, with the NUL characters replaced with spaces.
+	* Returns the length, or -1 if the process is gone.*/
+	char FileName[64];
+	int Descriptor, Inc = 0;
+	ssize_t Length;
+	
+	snprintf(FileName, sizeof FileName, "/proc/%s/cmdline", PIDString);
+	
+	if ((Descriptor = open(FileName, O_RDONLY | O_CLOEXEC)) == -1)
+	{
+		return -1;
+	}
+	
+	Length = read(Descriptor, OutBuf, OutBufSize - 1);
+	close(Descriptor);
+	
+	if (Length < 0) Length = 0;
+	
+	OutBuf[Length] = '\0';
+	
+	for (; Inc < Length; ++Inc)
+	{
+		if (OutBuf[Inc] == '\0')
+		{
+			OutBuf[Inc] = ' ';
+		}
+	}
+	
+	return Length;
+}
+
 unsigned AdvancedPIDFind(ObjTable *InObj, Bool UpdatePID)
 { /*Advaaaanced! Ooh, shiney!
 	*Ok, seriously now, it finds PIDs by scanning /proc/somenumber/cmdline.*/
 	DIR *ProcDir = NULL;
 	struct dirent *DirPtr = NULL;
-	char FileName[MAX_LINE_SIZE];
 	char FileBuf[MAX_LINE_SIZE];
 	char CmdLine[MAX_LINE_SIZE];
-	unsigned Inc = 0, Streamsize = 0, Countdown = 0;
-	FILE *Descriptor = NULL;
+	unsigned CmdLength, CGroupPID = 0;
+	
+	if (CGroup_FindPID(InObj, InObj->ObjectPID, &CGroupPID))
+	{ /*No guessing needed.*/
+		if (UpdatePID && CGroupPID) InObj->ObjectPID = CGroupPID;
+		
+		return CGroupPID;
+	}
 	
 	/*No point if there's no /proc you know.*/
 	if (!ProcAvailable()) return 0;
 	
-	if (InObj->ObjectStartCommand == NULL)
+	if (!PIDFindCmdLine(InObj, CmdLine, sizeof CmdLine))
 	{
 		return 0;
 	}	
@@ -290,49 +626,18 @@ unsigned AdvancedPIDFind(ObjTable *InObj, Bool UpdatePID)
 		return 0;
 	}
 	
-	/*Remove forbidden characters.*/
-	snprintf(CmdLine, sizeof CmdLine, "%s", InObj->ObjectStartCommand);
-		
-	for (Countdown = strlen(CmdLine) - 1; Countdown > 0 &&
-		(CmdLine[Countdown] == ' ' || CmdLine[Countdown] == '\t' ||
-		CmdLine[Countdown] == '&' || CmdLine[Countdown] == ';'); --Countdown)
-	{
-		CmdLine[Countdown] = '\0';
-	}
+	CmdLength = strlen(CmdLine);
 	
 	while ((DirPtr = readdir(ProcDir)))
 	{
 		if (AllNumeric(DirPtr->d_name) && atol(DirPtr->d_name) >= InObj->ObjectPID)
 		{
-			int TChar;
-			
-			snprintf(FileName, sizeof FileName, "/proc/%s/cmdline", DirPtr->d_name);
-			
-			if (!(Descriptor = fopen(FileName, "r")))
-			{
-				closedir(ProcDir);
-				return 0;
+			if (ReadProcCmdLine(DirPtr->d_name, FileBuf, sizeof FileBuf) == -1)
+			{ /*It exited while we were looking. Not our problem.*/
+				continue;
 			}
 			
-			for (Inc = 0; (TChar = getc(Descriptor)) != EOF && Inc < MAX_LINE_SIZE - 1; ++Inc)
-			{
-				*(unsigned char*)&FileBuf[Inc] = (unsigned char)TChar;
-			}
-			FileBuf[Inc] = '\0';
-			
-			Streamsize = Inc;
-			
-			fclose(Descriptor);
-			
-			for (Inc = 0; Inc < Streamsize; ++Inc)
-			{ /*We need to replace the NUL characters with spaces.*/
-				if (FileBuf[Inc] == '\0')
-				{
-					FileBuf[Inc] = ' ';
-				}
-			}
-			
-			if (!strncmp(FileBuf, CmdLine, strlen(CmdLine)))
+			if (!strncmp(FileBuf, CmdLine, CmdLength))
 			{
 				unsigned RealPID;
 				
@@ -354,6 +659,340 @@ unsigned AdvancedPIDFind(ObjTable *InObj, Bool UpdatePID)
 	return 0;
 }
 
+struct _ProcEntry
+{
+	unsigned PID;
+	size_t Offset; /*Into the string arena while we're building it.*/
+	const char *CmdLine; /*Set once the arena stops moving.*/
+};
+
+static int ProcEntryCompare(const void *First_, const void *Second_)
+{ /*Sort by command line, then PID, so every process sharing a prefix sits in one run.*/
+	const struct _ProcEntry *First = First_, *Second = Second_;
+	const int Result = strcmp(First->CmdLine, Second->CmdLine);
+	
+	if (Result) return Result;
+	
+	return (First->PID > Second->PID) - (First->PID < Second->PID);
+}
+
+void AdvancedPIDFindAll(void)
+{ /*Same as calling AdvancedPIDFind() on every started object, except we only walk /proc once.
+	* We snapshot every command line, sort them, and then look each object up with a binary search.*/
+	DIR *ProcDir = NULL;
+	struct dirent *DirPtr = NULL;
+	struct _ProcEntry *Entries = NULL;
+	unsigned NumEntries = 0, EntryCapacity = 0, Inc = 0;
+	char *Arena = NULL;
+	size_t ArenaUsed = 0, ArenaCapacity = 0;
+	char FileBuf[MAX_LINE_SIZE], CmdLine[MAX_LINE_SIZE];
+	ObjTable *Worker = NULL;
+	int Length;
+	Bool NeedScan = false;
+	
+	if (!ObjectTable) return;
+	
+	for (Worker = ObjectTable; Worker->Next; Worker = Worker->Next)
+	{ /*Objects in cgroups don't need /proc at all.*/
+		unsigned CGroupPID = 0;
+		
+		if (!Worker->Started || Worker->Opts.HasPIDFile) continue;
+		
+		if (CGroup_FindPID(Worker, Worker->ObjectPID, &CGroupPID))
+		{
+			if (CGroupPID) Worker->ObjectPID = CGroupPID;
+		}
+		else
+		{
+			NeedScan = true;
+		}
+	}
+	
+	if (!NeedScan || !ProcAvailable() || !(ProcDir = opendir("/proc/")))
+	{
+		return;
+	}
+	
+	while ((DirPtr = readdir(ProcDir)))
+	{
+		if (!AllNumeric(DirPtr->d_name) ||
+			(Length = ReadProcCmdLine(DirPtr->d_name, FileBuf, sizeof FileBuf)) == -1)
+		{
+			continue;
+		}
+		
+		if (NumEntries == EntryCapacity)
+		{
+			EntryCapacity = EntryCapacity ? EntryCapacity * 2 : 256;
+			Entries = realloc(Entries, EntryCapacity * sizeof *Entries);
+		}
+		
+		if (ArenaUsed + Length + 1 > ArenaCapacity)
+		{
+			for (ArenaCapacity = ArenaCapacity ? ArenaCapacity : 16384;
+				ArenaUsed + Length + 1 > ArenaCapacity; ArenaCapacity *= 2);
+			
+			Arena = realloc(Arena, ArenaCapacity);
+		}
+		
+		memcpy(Arena + ArenaUsed, FileBuf, Length + 1);
+		
+		Entries[NumEntries].PID = atol(DirPtr->d_name);
+		Entries[NumEntries].Offset = ArenaUsed;
+		++NumEntries;
+		
+		ArenaUsed += Length + 1;
+	}
+	closedir(ProcDir);
+	
+	if (!NumEntries) return;
+	
+	for (Inc = 0; Inc < NumEntries; ++Inc)
+	{
+		Entries[Inc].CmdLine = Arena + Entries[Inc].Offset;
+	}
+	
+	qsort(Entries, NumEntries, sizeof *Entries, ProcEntryCompare);
+	
+	for (Worker = ObjectTable; Worker->Next; Worker = Worker->Next)
+	{
+		unsigned Lower = 0, Upper = NumEntries, CmdLength, FoundPID = 0;
+		
+		if (!Worker->Started || Worker->Opts.HasPIDFile || CGroup_Populated(Worker) != -1 ||
+			!PIDFindCmdLine(Worker, CmdLine, sizeof CmdLine))
+		{
+			continue;
+		}
+		
+		CmdLength = strlen(CmdLine);
+		
+		while (Lower < Upper)
+		{ /*Find the first entry not less than CmdLine. Everything it prefixes follows it.*/
+			const unsigned Middle = Lower + (Upper - Lower) / 2;
+			
+			if (strcmp(Entries[Middle].CmdLine, CmdLine) < 0) Lower = Middle + 1;
+			else Upper = Middle;
+		}
+		
+		for (Inc = Lower; Inc < NumEntries && !strncmp(Entries[Inc].CmdLine, CmdLine, CmdLength); ++Inc)
+		{ /*Lowest PID at or above the one we have, like AdvancedPIDFind() would find.*/
+			if (Entries[Inc].PID >= Worker->ObjectPID && (!FoundPID || Entries[Inc].PID < FoundPID))
+			{
+				FoundPID = Entries[Inc].PID;
+			}
+		}
+		
+		if (FoundPID) Worker->ObjectPID = FoundPID;
+	}
+	
+	free(Entries);
+	free(Arena);
+}
+
+/**cgroup v2 tracking. When cgroup2 is mounted above CGroupHierarchy, each object's start command
+ * runs in CGroupHierarchy/ObjectID, and everything it ever forks stays there. If an object has no
+ * cgroup directory, these all say so and the caller falls back to PIDs.**/
+static Bool CGroup_Path(const ObjTable *InObj, const char *File, char *OutBuf, unsigned OutBufSize)
+{
+	char *Worker = NULL;
+	int Length;
+	
+	if (!*CGroupHierarchy) return false;
+	
+	Length = snprintf(OutBuf, OutBufSize, "%s/", CGroupHierarchy);
+	
+	if (Length < 0 || Length >= OutBufSize) return false;
+	
+	snprintf(OutBuf + Length, OutBufSize - Length, "%s", InObj->ObjectID);
+	
+	for (Worker = OutBuf + Length; *Worker != '\0'; ++Worker)
+	{ /*An ObjectID can't be allowed to wander off into some other directory.*/
+		if (*Worker == '/') *Worker = '_';
+	}
+	
+	if (File)
+	{
+		Length = strlen(OutBuf);
+		snprintf(OutBuf + Length, OutBufSize - Length, "/%s", File);
+	}
+	
+	return true;
+}
+
+static int CGroup_ReadFile(const ObjTable *InObj, const char *File, char *OutBuf, unsigned OutBufSize)
+{ /*Returns the number of bytes read, or -1 if there's no such cgroup.*/
+	char Path[MAX_LINE_SIZE];
+	int Descriptor;
+	ssize_t Length;
+	
+	if (!CGroup_Path(InObj, File, Path, sizeof Path) || (Descriptor = open(Path, O_RDONLY | O_CLOEXEC)) == -1)
+	{
+		return -1;
+	}
+	
+	Length = read(Descriptor, OutBuf, OutBufSize - 1);
+	close(Descriptor);
+	
+	if (Length < 0) Length = 0;
+	OutBuf[Length] = '\0';
+	
+	return Length;
+}
+
+static Bool CGroup_WriteFile(const ObjTable *InObj, const char *File, const char *Data)
+{
+	char Path[MAX_LINE_SIZE];
+	int Descriptor;
+	Bool RetVal;
+	
+	if (!CGroup_Path(InObj, File, Path, sizeof Path) || (Descriptor = open(Path, O_WRONLY | O_CLOEXEC)) == -1)
+	{
+		return false;
+	}
+	
+	RetVal = write(Descriptor, Data, strlen(Data)) == (ssize_t)strlen(Data);
+	close(Descriptor);
+	
+	return RetVal;
+}
+
+Bool CGroup_Create(const ObjTable *InObj)
+{ /*Make the object's cgroup, if cgroup2 is where we were told it would be.*/
+	char Path[MAX_LINE_SIZE], *Worker = NULL;
+	struct statfs FSInfo;
+	
+	if (!*CGroupHierarchy) return false;
+	
+	/*Check the parent first, so we don't go making plain directories in some tmpfs.*/
+	snprintf(Path, sizeof Path, "%s", CGroupHierarchy);
+	
+	if ((Worker = strrchr(Path, '/')) && Worker != Path) *Worker = '\0';
+	else snprintf(Path, sizeof Path, "/");
+	
+	if (statfs(Path, &FSInfo) != 0 || FSInfo.f_type != CGROUP2_SUPER_MAGIC)
+	{
+		return false;
+	}
+	
+	if (mkdir(CGroupHierarchy, 0755) != 0 && errno != EEXIST)
+	{
+		return false;
+	}
+	
+	CGroup_Path(InObj, NULL, Path, sizeof Path);
+	
+	return mkdir(Path, 0755) == 0 || errno == EEXIST;
+}
+
+Bool CGroup_Attach(const ObjTable *InObj)
+{ /*Called in the child, before it does anything else. Writing 0 means "me".*/
+	return CGroup_WriteFile(InObj, "cgroup.procs", "0");
+}
+
+void CGroup_Remove(const ObjTable *InObj)
+{ /*Only works if it's empty, which is the only time we'd want it to.*/
+	char Path[MAX_LINE_SIZE];
+	
+	if (CGroup_Path(InObj, NULL, Path, sizeof Path)) rmdir(Path);
+}
+
+void CGroup_Release(const ObjTable *InObj, Bool Kill)
+{ /*For when an object stops. Kill what it left behind if asked, give that a moment to die, and remove the cgroup.
+	* Anything still in there keeps the directory, and CGroup_Create() just uses it again next start.*/
+	unsigned Inc = 0;
+	
+	if (Kill && CGroup_Kill(InObj))
+	{ /*A second at most. SIGKILL doesn't usually take that long.*/
+		for (; Inc < 100 && CGroup_Populated(InObj) == 1; ++Inc) usleep(10000);
+	}
+	
+	CGroup_Remove(InObj);
+}
+
+short CGroup_Populated(const ObjTable *InObj)
+{ /*1 if anything is running in the object's cgroup, 0 if not, -1 if it doesn't have one.*/
+	char Buffer[256], *Worker = NULL;
+	
+	if (CGroup_ReadFile(InObj, "cgroup.events", Buffer, sizeof Buffer) == -1)
+	{
+		return -1;
+	}
+	
+	if (!(Worker = strstr(Buffer, "populated ")))
+	{
+		return -1;
+	}
+	
+	return Worker[sizeof "populated " - 1] == '1';
+}
+
+Bool CGroup_FindPID(const ObjTable *InObj, unsigned Hint, unsigned *OutPID)
+{ /*Gives Hint back if it's still in the cgroup, otherwise the lowest PID in there, or 0 if it's empty.
+	* Returns false if the object has no cgroup.*/
+	char Buffer[MAX_LINE_SIZE * 2], *Worker = Buffer;
+	unsigned Lowest = 0, CurPID;
+	
+	if (CGroup_ReadFile(InObj, "cgroup.procs", Buffer, sizeof Buffer) == -1)
+	{
+		return false;
+	}
+	
+	while (*Worker != '\0')
+	{
+		if (!isdigit(*Worker))
+		{
+			++Worker;
+			continue;
+		}
+		
+		CurPID = strtoul(Worker, &Worker, 10);
+		
+		if (Hint && CurPID == Hint)
+		{
+			*OutPID = Hint;
+			return true;
+		}
+		
+		if (!Lowest || CurPID < Lowest) Lowest = CurPID;
+	}
+	
+	*OutPID = Lowest;
+	return true;
+}
+
+Bool CGroup_Kill(const ObjTable *InObj)
+{ /*SIGKILL everything in the object's cgroup. cgroup.kill is 5.14+, so do it by hand otherwise.*/
+	char Buffer[MAX_LINE_SIZE * 2], *Worker = Buffer;
+	
+	if (CGroup_Populated(InObj) != 1)
+	{
+		return false;
+	}
+	
+	if (CGroup_WriteFile(InObj, "cgroup.kill", "1"))
+	{
+		return true;
+	}
+	
+	if (CGroup_ReadFile(InObj, "cgroup.procs", Buffer, sizeof Buffer) == -1)
+	{
+		return false;
+	}
+	
+	while (*Worker != '\0')
+	{
+		if (!isdigit(*Worker))
+		{
+			++Worker;
+			continue;
+		}
+		
+		kill(strtoul(Worker, &Worker, 10), SIGKILL);
+	}
+	
+	return true;
+}
+
 unsigned ReadPIDFile(const ObjTable *InObj)
 {
 	FILE *PIDFileDescriptor = fopen(InObj->ObjectPIDFile, "r");